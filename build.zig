@@ -87,6 +87,15 @@ pub fn build(b: *std.Build) void {
 
     if (target.result.os.tag == .linux) {
         unit_tests.linkSystemLibrary("uring");
+        // The worker loop's splice and ring helpers live in the C wrapper
+        unit_tests.addCSourceFile(.{
+            .file = b.path("src/core/bind_wrapper.c"),
+            .flags = &[_][]const u8{
+                "-std=c99",
+                "-D_GNU_SOURCE",
+                "-fno-sanitize=undefined",
+            },
+        });
     }
 
     const run_unit_tests = b.addRunArtifact(unit_tests);
@@ -247,9 +256,85 @@ pub fn build(b: *std.Build) void {
     const ebpf_benchmark_test_step = b.step("test-ebpf-benchmark", "Run eBPF benchmark tests");
     ebpf_benchmark_test_step.dependOn(&run_ebpf_benchmark_tests.step);
 
+    // BufferPool acquire/release benchmark tests
+    const buffer_pool_benchmark_module = b.addModule("buffer_pool_benchmark_root", .{
+        .root_source_file = b.path("tests/unit/allocator/buffer_pool_benchmark_test.zig"),
+        .target = target,
+        .optimize = .ReleaseFast,
+    });
+    buffer_pool_benchmark_module.addImport("allocator", b.createModule(.{
+        .root_source_file = b.path("src/core/allocator.zig"),
+        .target = target,
+        .optimize = .ReleaseFast,
+    }));
+    const buffer_pool_benchmark_tests = b.addTest(.{
+        .root_module = buffer_pool_benchmark_module,
+    });
+
+    const run_buffer_pool_benchmark_tests = b.addRunArtifact(buffer_pool_benchmark_tests);
+    const buffer_pool_benchmark_test_step = b.step("test-buffer-pool-benchmark", "Run BufferPool acquire/release benchmark tests");
+    buffer_pool_benchmark_test_step.dependOn(&run_buffer_pool_benchmark_tests.step);
+
+    // HTTP/1.1 parser benchmark (SIMD scanner vs scalar path)
+    const parser_benchmark_module = b.addModule("parser_benchmark_root", .{
+        .root_source_file = b.path("tests/unit/http/parser_benchmark_test.zig"),
+        .target = target,
+        .optimize = .ReleaseFast,
+    });
+    parser_benchmark_module.addImport("parser", b.createModule(.{
+        .root_source_file = b.path("src/http/parser.zig"),
+        .target = target,
+        .optimize = .ReleaseFast,
+    }));
+    const parser_benchmark_tests = b.addTest(.{
+        .root_module = parser_benchmark_module,
+    });
+
+    const run_parser_benchmark_tests = b.addRunArtifact(parser_benchmark_tests);
+    const parser_benchmark_step = b.step("bench-parser", "Benchmark the SIMD HTTP/1.1 parser against the scalar path");
+    parser_benchmark_step.dependOn(&run_parser_benchmark_tests.step);
+
+    // QUIC packet protection benchmark (AES-128-GCM + header protection, 1200-byte packets)
+    const quic_crypto_module = b.createModule(.{
+        .root_source_file = b.path("src/quic/crypto.zig"),
+        .target = target,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    quic_crypto_module.linkSystemLibrary("crypto", .{});
+    const quic_crypto_benchmark_module = b.addModule("quic_crypto_benchmark_root", .{
+        .root_source_file = b.path("tests/unit/quic/crypto_benchmark_test.zig"),
+        .target = target,
+        .optimize = .ReleaseFast,
+    });
+    quic_crypto_benchmark_module.addImport("quic_crypto", quic_crypto_module);
+    const quic_crypto_benchmark_tests = b.addTest(.{
+        .root_module = quic_crypto_benchmark_module,
+    });
+    quic_crypto_benchmark_tests.linkLibC();
+
+    const run_quic_crypto_benchmark_tests = b.addRunArtifact(quic_crypto_benchmark_tests);
+    const quic_crypto_benchmark_step = b.step("bench-quic-crypto", "Benchmark QUIC packet protection (packets/sec per core)");
+    quic_crypto_benchmark_step.dependOn(&run_quic_crypto_benchmark_tests.step);
+
     // Bench step - run benchmark tests
     const bench_step = b.step("bench", "Run benchmark tests");
     bench_step.dependOn(ebpf_benchmark_test_step);
+    bench_step.dependOn(buffer_pool_benchmark_test_step);
+    bench_step.dependOn(parser_benchmark_step);
+    bench_step.dependOn(quic_crypto_benchmark_step);
+
+    // Registered I/O before/after benchmark (loopback, requires wrk)
+    const bench_registered_io_cmd = b.addSystemCommand(&[_][]const u8{ "bash", "scripts/bench/registered-io.sh" });
+    bench_registered_io_cmd.step.dependOn(b.getInstallStep());
+    const bench_registered_io_step = b.step("bench-registered-io", "Benchmark echo server with and without registered files/buffers");
+    bench_registered_io_step.dependOn(&bench_registered_io_cmd.step);
+
+    // QUIC datagram path before/after batching (loopback, requires python3)
+    const bench_quic_udp_cmd = b.addSystemCommand(&[_][]const u8{ "bash", "scripts/bench/quic-udp-batching.sh" });
+    bench_quic_udp_cmd.step.dependOn(b.getInstallStep());
+    const bench_quic_udp_step = b.step("bench-quic-udp", "Benchmark the QUIC server's UDP path with and without recvmsg/GRO batching");
+    bench_quic_udp_step.dependOn(&bench_quic_udp_cmd.step);
 
     // Graceful reload tests
     const graceful_reload_tests = b.addTest(.{
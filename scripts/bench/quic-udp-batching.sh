@@ -0,0 +1,129 @@
+#!/bin/bash
+# Blitz Gateway QUIC UDP Batching Benchmark
+# Compares the QUIC server's datagram path with one recv per datagram (before,
+# --no-udp-batching) against multishot recvmsg with GRO (after) over loopback.
+# Senders blast 1200-byte datagrams (sent with UDP GSO so the load generator
+# isn't the bottleneck); the server logs datagrams/s every 5 seconds.
+
+set -euo pipefail
+
+# Configuration
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "$(dirname "$SCRIPT_DIR")")"
+RESULTS_DIR="$PROJECT_ROOT/benches/results/quic-udp-batching-$(date +%Y%m%d_%H%M%S)"
+BLITZ_BIN="$PROJECT_ROOT/zig-out/bin/blitz"
+
+# Default values
+PORT="${PORT:-8443}"
+DURATION="${DURATION:-16}"
+SENDERS="${SENDERS:-4}"
+DATAGRAM_SIZE="${DATAGRAM_SIZE:-1200}"
+
+# Colors for output
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+log_info() {
+    echo -e "${BLUE}[INFO]${NC} $1"
+}
+
+log_success() {
+    echo -e "${GREEN}[SUCCESS]${NC} $1"
+}
+
+log_error() {
+    echo -e "${RED}[ERROR]${NC} $1"
+}
+
+SERVER_PID=""
+
+stop_server() {
+    if [ -n "$SERVER_PID" ] && kill -0 "$SERVER_PID" 2>/dev/null; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    SERVER_PID=""
+}
+
+trap stop_server EXIT INT TERM
+
+# Short-header datagrams for one connection ID; the server parses and drops them
+blast() {
+    python3 - "$PORT" "$DURATION" "$DATAGRAM_SIZE" <<'PY'
+import socket, sys, time
+port, duration, size = int(sys.argv[1]), float(sys.argv[2]), int(sys.argv[3])
+sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+per_send = max(1, 65000 // size)
+try:
+    sock.setsockopt(socket.SOL_UDP, 103, size)  # UDP_SEGMENT
+    payload = (b"\x40" + b"\x01" * 8 + b"\x00" * (size - 9)) * per_send
+except OSError:
+    payload = b"\x40" + b"\x01" * 8 + b"\x00" * (size - 9)
+end = time.monotonic() + duration
+while time.monotonic() < end:
+    try:
+        sock.sendto(payload, ("127.0.0.1", port))
+    except (BlockingIOError, OSError):
+        pass
+PY
+}
+
+# run_one <label> [extra server args...]
+run_one() {
+    local label="$1"
+    shift
+    local log="$RESULTS_DIR/server-${label}.log"
+
+    "$BLITZ_BIN" --mode quic --port "$PORT" "$@" > "$log" 2>&1 &
+    SERVER_PID=$!
+
+    local retries=0
+    while ! grep -q "listening on UDP port" "$log" 2>/dev/null; do
+        if [ $retries -ge 20 ]; then
+            log_error "Server ($label) failed to start"
+            cat "$log"
+            exit 1
+        fi
+        sleep 0.5
+        retries=$((retries + 1))
+    done
+
+    local pids=()
+    for _ in $(seq "$SENDERS"); do
+        blast &
+        pids+=($!)
+    done
+    wait "${pids[@]}"
+    stop_server
+
+    # Skip the first (warm-up) window, average the rest
+    local rate per_recv
+    rate=$(grep "QUIC UDP (" "$log" | tail -n +2 | sed -E 's/.*: ([0-9]+) datagrams\/s in.*/\1/' | awk '{ s += $1; n++ } END { if (n) printf "%.0f", s / n; else print "n/a" }')
+    per_recv=$(grep "QUIC UDP (" "$log" | tail -n 1 | sed -E 's/.*\(([0-9.]+) per recv completion\).*/\1/')
+    printf "%-12s %-16s %-10s\n" "$label" "$rate" "${per_recv:-n/a}" | tee -a "$RESULTS_DIR/summary.txt"
+}
+
+main() {
+    if ! command -v python3 &> /dev/null; then
+        log_error "python3 is required for the datagram generator"
+        exit 1
+    fi
+
+    if [ ! -f "$BLITZ_BIN" ]; then
+        log_error "blitz binary not found at $BLITZ_BIN (run: zig build -Doptimize=ReleaseFast)"
+        exit 1
+    fi
+
+    mkdir -p "$RESULTS_DIR"
+    log_info "QUIC UDP batching: $SENDERS sender(s), ${DATAGRAM_SIZE}-byte datagrams, ${DURATION}s per run"
+
+    printf "%-12s %-16s %-10s\n" "mode" "datagrams/s" "per-recv" | tee "$RESULTS_DIR/summary.txt"
+    run_one "before" --no-udp-batching
+    run_one "after"
+
+    log_success "Results: $RESULTS_DIR"
+}
+
+main "$@"
@@ -0,0 +1,102 @@
+#!/bin/bash
+# Blitz Gateway Registered I/O Benchmark
+# Compares the echo server with plain fds/buffers (before) against
+# direct accept + fixed write buffers (after, --registered-io) over loopback
+
+set -euo pipefail
+
+# Configuration
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "$(dirname "$SCRIPT_DIR")")"
+RESULTS_DIR="$PROJECT_ROOT/benches/results/registered-io-$(date +%Y%m%d_%H%M%S)"
+BLITZ_BIN="$PROJECT_ROOT/zig-out/bin/blitz"
+
+# Default values
+PORT="${PORT:-8080}"
+DURATION="${DURATION:-15}"
+CONNECTIONS="${CONNECTIONS:-512}"
+WORKERS="${WORKERS:-1}"
+WRK_THREADS="${WRK_THREADS:-$(( $(nproc) / 2 > 0 ? $(nproc) / 2 : 1 ))}"
+
+# Colors for output
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+log_info() {
+    echo -e "${BLUE}[INFO]${NC} $1"
+}
+
+log_success() {
+    echo -e "${GREEN}[SUCCESS]${NC} $1"
+}
+
+log_error() {
+    echo -e "${RED}[ERROR]${NC} $1"
+}
+
+SERVER_PID=""
+
+stop_server() {
+    if [ -n "$SERVER_PID" ] && kill -0 "$SERVER_PID" 2>/dev/null; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    SERVER_PID=""
+}
+
+trap stop_server EXIT INT TERM
+
+# run_one <label> [extra server args...]
+run_one() {
+    local label="$1"
+    shift
+    local out="$RESULTS_DIR/wrk-${label}.txt"
+
+    "$BLITZ_BIN" --mode echo --port "$PORT" --workers "$WORKERS" "$@" > "$RESULTS_DIR/server-${label}.log" 2>&1 &
+    SERVER_PID=$!
+
+    local retries=0
+    while ! curl -fs "http://127.0.0.1:$PORT/hello" > /dev/null 2>&1; do
+        if [ $retries -ge 20 ]; then
+            log_error "Server ($label) failed to start"
+            cat "$RESULTS_DIR/server-${label}.log"
+            exit 1
+        fi
+        sleep 0.5
+        retries=$((retries + 1))
+    done
+
+    wrk -t"$WRK_THREADS" -c"$CONNECTIONS" -d"${DURATION}s" --latency "http://127.0.0.1:$PORT/hello" > "$out"
+    stop_server
+
+    local rps p99
+    rps=$(grep "Requests/sec" "$out" | awk '{print $2}')
+    p99=$(grep -E "^\s+99%" "$out" | awk '{print $2}')
+    printf "%-12s %-14s %-10s\n" "$label" "$rps" "$p99" | tee -a "$RESULTS_DIR/summary.txt"
+}
+
+main() {
+    if ! command -v wrk &> /dev/null; then
+        log_error "wrk is required (sudo apt-get install wrk)"
+        exit 1
+    fi
+
+    if [ ! -f "$BLITZ_BIN" ]; then
+        log_error "blitz binary not found at $BLITZ_BIN (run: zig build -Doptimize=ReleaseFast)"
+        exit 1
+    fi
+
+    mkdir -p "$RESULTS_DIR"
+    log_info "Registered I/O: $WORKERS worker(s), $CONNECTIONS connections, ${DURATION}s per run"
+    log_info "Fixed buffers pin the write pool; raise 'ulimit -l' if the server log shows register_buffers failing"
+
+    printf "%-12s %-14s %-10s\n" "mode" "rps" "p99" | tee "$RESULTS_DIR/summary.txt"
+    run_one "before"
+    run_one "after" --registered-io
+
+    log_success "Results: $RESULTS_DIR"
+}
+
+main "$@"
@@ -0,0 +1,132 @@
+#!/bin/bash
+# Blitz Gateway Worker Scaling Benchmark
+# Runs the io_uring echo server over loopback with 1..N workers and reports RPS per worker count
+
+set -euo pipefail
+
+# Configuration
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+PROJECT_ROOT="$(dirname "$(dirname "$SCRIPT_DIR")")"
+RESULTS_DIR="$PROJECT_ROOT/benches/results/worker-scaling-$(date +%Y%m%d_%H%M%S)"
+BLITZ_BIN="$PROJECT_ROOT/zig-out/bin/blitz"
+
+# Default values
+PORT="${PORT:-8080}"
+DURATION="${DURATION:-15}"
+CONNECTIONS="${CONNECTIONS:-512}"
+# The server is pinned to the lower half of the CPUs and wrk to the upper half,
+# so load generation doesn't compete with the workers being measured
+CPUS=$(nproc)
+SERVER_CPUS=$(( CPUS / 2 > 0 ? CPUS / 2 : 1 ))
+SERVER_CPU_LIST="0-$((SERVER_CPUS - 1))"
+# A single CPU can't be split: both share it
+if [ "$CPUS" -gt 1 ]; then
+    WRK_CPU_LIST="$SERVER_CPUS-$((CPUS - 1))"
+else
+    WRK_CPU_LIST="0"
+fi
+MAX_WORKERS="${MAX_WORKERS:-$SERVER_CPUS}"
+WRK_THREADS="${WRK_THREADS:-$(( CPUS - SERVER_CPUS > 0 ? CPUS - SERVER_CPUS : 1 ))}"
+
+# Colors for output
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+log_info() {
+    echo -e "${BLUE}[INFO]${NC} $1"
+}
+
+log_success() {
+    echo -e "${GREEN}[SUCCESS]${NC} $1"
+}
+
+log_error() {
+    echo -e "${RED}[ERROR]${NC} $1"
+}
+
+SERVER_PID=""
+
+stop_server() {
+    if [ -n "$SERVER_PID" ] && kill -0 "$SERVER_PID" 2>/dev/null; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    SERVER_PID=""
+}
+
+trap stop_server EXIT INT TERM
+
+# Worker counts to test: 1, 2, 4, ... up to MAX_WORKERS (always including MAX_WORKERS)
+worker_counts() {
+    local n=1
+    while [ "$n" -lt "$MAX_WORKERS" ]; do
+        echo "$n"
+        n=$((n * 2))
+    done
+    echo "$MAX_WORKERS"
+}
+
+run_one() {
+    local workers="$1"
+    local out="$RESULTS_DIR/wrk-${workers}w.txt"
+
+    # Workers pin themselves to CPU (id % allowed CPUs), which stays inside this set
+    taskset -c "$SERVER_CPU_LIST" "$BLITZ_BIN" --mode echo --port "$PORT" --workers "$workers" > "$RESULTS_DIR/server-${workers}w.log" 2>&1 &
+    SERVER_PID=$!
+
+    local retries=0
+    while ! curl -fs "http://127.0.0.1:$PORT/hello" > /dev/null 2>&1; do
+        if [ $retries -ge 20 ]; then
+            log_error "Server with $workers worker(s) failed to start"
+            cat "$RESULTS_DIR/server-${workers}w.log"
+            exit 1
+        fi
+        sleep 0.5
+        retries=$((retries + 1))
+    done
+
+    taskset -c "$WRK_CPU_LIST" wrk -t"$WRK_THREADS" -c"$CONNECTIONS" -d"${DURATION}s" "http://127.0.0.1:$PORT/hello" > "$out"
+    stop_server
+
+    grep "Requests/sec" "$out" | awk '{print $2}'
+}
+
+main() {
+    if ! command -v wrk &> /dev/null; then
+        log_error "wrk is required (sudo apt-get install wrk)"
+        exit 1
+    fi
+    if ! command -v taskset &> /dev/null; then
+        log_error "taskset is required (sudo apt-get install util-linux)"
+        exit 1
+    fi
+
+    cd "$PROJECT_ROOT"
+    if [ ! -f "$BLITZ_BIN" ]; then
+        log_info "Building optimized binary..."
+        zig build -Doptimize=ReleaseFast
+    fi
+
+    mkdir -p "$RESULTS_DIR"
+    log_info "Loopback scaling: 1..$MAX_WORKERS workers, $CONNECTIONS connections, ${DURATION}s each"
+    log_info "Server CPUs: $SERVER_CPU_LIST, wrk CPUs: $WRK_CPU_LIST ($WRK_THREADS threads)"
+
+    local base_rps=""
+    printf "%-8s %-14s %-8s\n" "workers" "rps" "speedup" | tee "$RESULTS_DIR/summary.txt"
+    for workers in $(worker_counts); do
+        local rps
+        rps=$(run_one "$workers")
+        if [ -z "$base_rps" ]; then
+            base_rps="$rps"
+        fi
+        local speedup
+        speedup=$(awk -v r="$rps" -v b="$base_rps" 'BEGIN { if (b > 0) printf "%.2fx", r / b; else print "n/a" }')
+        printf "%-8s %-14s %-8s\n" "$workers" "$rps" "$speedup" | tee -a "$RESULTS_DIR/summary.txt"
+    done
+
+    log_success "Results: $RESULTS_DIR"
+}
+
+main "$@"
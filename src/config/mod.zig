@@ -26,6 +26,149 @@ pub const Backend = struct {
     }
 };
 
+/// io_uring ring setup configuration
+pub const RingConfig = struct {
+    /// Setup mode; falls back towards .default if the kernel rejects it
+    mode: Mode = .default,
+
+    /// Submission queue entries
+    sq_entries: u32 = 4096,
+
+    /// Completion queue entries (0 = kernel default of twice the SQ size)
+    cq_entries: u32 = 0,
+
+    /// CPU for the SQPOLL kernel thread; worker N uses sqpoll_cpu + N (null = unpinned)
+    sqpoll_cpu: ?u32 = null,
+
+    /// Idle time before the SQPOLL kernel thread sleeps (milliseconds)
+    sqpoll_idle_ms: u32 = 1000,
+
+    pub const Mode = enum {
+        /// No setup flags
+        default,
+        /// Kernel thread polls the SQ, so submission needs no syscall
+        sqpoll,
+        /// Run task work at the next kernel transition instead of via IPI
+        coop_taskrun,
+        /// SINGLE_ISSUER + DEFER_TASKRUN: task work runs only when the worker waits
+        defer_taskrun,
+
+        pub fn parse(value: []const u8) ?Mode {
+            if (std.mem.eql(u8, value, "coop")) return .coop_taskrun;
+            if (std.mem.eql(u8, value, "defer")) return .defer_taskrun;
+            return std.meta.stringToEnum(Mode, value);
+        }
+    };
+};
+
+/// Buffer arena memory placement
+pub const ArenaConfig = struct {
+    /// Huge page backing for each worker's buffer arena
+    huge_pages: HugePages = .off,
+
+    /// Bind each worker's arena to the NUMA node of the CPU it runs on
+    numa_local: bool = false,
+
+    pub const HugePages = enum {
+        off,
+        /// Transparent huge pages via madvise
+        transparent,
+        /// Reserved hugetlbfs pages (MAP_HUGETLB), falls back to transparent
+        explicit,
+    };
+};
+
+/// HTTPS on the TCP listener
+pub const TlsConfig = struct {
+    /// PEM certificate chain; TLS is off unless both files are set
+    cert_file: ?[:0]const u8 = null,
+    key_file: ?[:0]const u8 = null,
+
+    /// Hand record encryption to the kernel (kTLS) after each handshake
+    ktls: bool = true,
+
+    /// Threads for handshake signing, off the io_uring workers (0 = inline)
+    handshake_threads: u32 = 0,
+
+    /// How returning clients skip the full handshake
+    session_tickets: SessionTickets = .stateless,
+
+    /// Sessions kept in the shared cache when session_tickets = stateful
+    session_cache_size: usize = 16384,
+
+    /// 80-byte ticket key records shared across instances; random keys if unset
+    ticket_key_file: ?[:0]const u8 = null,
+
+    /// Seconds between random ticket key rotations
+    ticket_key_rotation_s: u32 = 3600,
+
+    pub const SessionTickets = enum {
+        /// Encrypted tickets, nothing kept on the server
+        stateless,
+        /// Session IDs into a cache shared by every worker
+        stateful,
+        off,
+    };
+
+    pub fn enabled(self: TlsConfig) bool {
+        return self.cert_file != null and self.key_file != null;
+    }
+};
+
+/// Route table entry, from the [routes] section as `pattern = handler`
+pub const Route = struct {
+    /// Literal segments, `:param` segments, and a final `*wildcard` or `prefix*` segment
+    pattern: []const u8,
+    handler: Handler,
+
+    pub const Handler = union(enum) {
+        /// Fixed response: `static <status> [body]`
+        static: Static,
+        /// Forward to the backend pool: `proxy`
+        proxy,
+        /// Hand the request to a WASM plugin: `plugin <name>`
+        plugin: []const u8,
+        /// Serve files from a directory: `files <dir>`; the pattern's wildcard is the path below it
+        files: []const u8,
+
+        pub const Static = struct {
+            status: u16,
+            body: []const u8,
+        };
+
+        /// Parse a handler spec; strings are duplicated with allocator
+        pub fn parse(allocator: std.mem.Allocator, spec: []const u8) !Handler {
+            var words = std.mem.tokenizeAny(u8, spec, " \t");
+            const kind = words.next() orelse return error.InvalidRoute;
+            if (std.mem.eql(u8, kind, "static")) {
+                const status_str = words.next() orelse return error.InvalidRoute;
+                const status = std.fmt.parseInt(u16, status_str, 10) catch return error.InvalidRoute;
+                if (status < 100 or status > 599) return error.InvalidRoute;
+                const body = std.mem.trim(u8, words.rest(), " \t");
+                return .{ .static = .{ .status = status, .body = try allocator.dupe(u8, body) } };
+            } else if (std.mem.eql(u8, kind, "proxy")) {
+                return .proxy;
+            } else if (std.mem.eql(u8, kind, "plugin")) {
+                const name = words.next() orelse return error.InvalidRoute;
+                return .{ .plugin = try allocator.dupe(u8, name) };
+            } else if (std.mem.eql(u8, kind, "files")) {
+                const root = words.next() orelse return error.InvalidRoute;
+                return .{ .files = try allocator.dupe(u8, root) };
+            }
+            return error.InvalidRoute;
+        }
+
+        pub fn deinit(self: Handler, allocator: std.mem.Allocator) void {
+            switch (self) {
+                .static => |static| allocator.free(static.body),
+                .proxy => {},
+                .plugin => |name| allocator.free(name),
+                .files => |root| allocator.free(root),
+            }
+        }
+    };
+};
+
 /// Rate limiting configuration
 pub const RateLimitConfig = struct {
     /// Global rate limit (requests per second across all clients)
@@ -136,9 +279,27 @@ pub const Config = struct {
     /// Listen port for server/load balancer
     listen_port: u16 = 4433,
 
+    /// io_uring worker threads (0 = one per CPU)
+    workers: u32 = 1,
+
+    /// Use registered files (direct accept) and fixed write buffers
+    registered_io: bool = false,
+
+    /// io_uring ring setup
+    ring: RingConfig = .{},
+
+    /// Buffer arena placement
+    arena: ArenaConfig = .{},
+
+    /// HTTPS certificate and record offload
+    tls: TlsConfig = .{},
+
     /// Backend servers (for load balancer mode)
     backends: std.ArrayList(Backend),
 
+    /// Route table, compiled into a trie by the server
+    routes: std.ArrayList(Route),
+
     /// Rate limiting configuration
     rate_limit: RateLimitConfig = .{},
 
@@ -159,6 +320,7 @@ pub const Config = struct {
     pub fn init(allocator: std.mem.Allocator) Config {
         return Config{
             .backends = std.ArrayList(Backend).initCapacity(allocator, 0) catch @panic("Failed to init backends list"),
+            .routes = std.ArrayList(Route).initCapacity(allocator, 0) catch @panic("Failed to init routes list"),
             .jwt = JwtConfig.init(allocator),
             .allocator = allocator,
         };
@@ -172,6 +334,14 @@ pub const Config = struct {
             }
         }
         self.backends.deinit(self.allocator);
+        for (self.routes.items) |route| {
+            self.allocator.free(route.pattern);
+            route.handler.deinit(self.allocator);
+        }
+        self.routes.deinit(self.allocator);
+        if (self.tls.cert_file) |path| self.allocator.free(path);
+        if (self.tls.key_file) |path| self.allocator.free(path);
+        if (self.tls.ticket_key_file) |path| self.allocator.free(path);
         self.jwt.deinit(self.allocator);
     }
 
@@ -214,6 +384,9 @@ pub const Config = struct {
                 }
             }
         }
+        if ((self.tls.cert_file == null) != (self.tls.key_file == null)) {
+            return error.IncompleteTlsConfig;
+        }
     }
 };
 
@@ -272,6 +445,43 @@ fn parseKeyValue(config: *Config, section: ?[]const u8, key: []const u8, value:
             } else {
                 return error.InvalidMode;
             }
+        } else if (std.mem.eql(u8, key, "workers")) {
+            config.workers = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, key, "registered_io")) {
+            config.registered_io = std.mem.eql(u8, value, "true");
+        } else if (std.mem.eql(u8, key, "ring_mode")) {
+            config.ring.mode = RingConfig.Mode.parse(value) orelse return error.InvalidRingMode;
+        } else if (std.mem.eql(u8, key, "ring_sq_entries")) {
+            config.ring.sq_entries = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, key, "ring_cq_entries")) {
+            config.ring.cq_entries = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, key, "sqpoll_cpu")) {
+            config.ring.sqpoll_cpu = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, key, "sqpoll_idle_ms")) {
+            config.ring.sqpoll_idle_ms = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, key, "huge_pages")) {
+            config.arena.huge_pages = std.meta.stringToEnum(ArenaConfig.HugePages, value) orelse return error.InvalidHugePagesMode;
+        } else if (std.mem.eql(u8, key, "numa_local")) {
+            config.arena.numa_local = std.mem.eql(u8, value, "true");
+        } else if (std.mem.eql(u8, key, "tls_cert_path")) {
+            if (config.tls.cert_file) |old| config.allocator.free(old);
+            config.tls.cert_file = try config.allocator.dupeZ(u8, value);
+        } else if (std.mem.eql(u8, key, "tls_key_path")) {
+            if (config.tls.key_file) |old| config.allocator.free(old);
+            config.tls.key_file = try config.allocator.dupeZ(u8, value);
+        } else if (std.mem.eql(u8, key, "ktls")) {
+            config.tls.ktls = std.mem.eql(u8, value, "true");
+        } else if (std.mem.eql(u8, key, "tls_handshake_threads")) {
+            config.tls.handshake_threads = try std.fmt.parseInt(u32, value, 10);
+        } else if (std.mem.eql(u8, key, "tls_session_tickets")) {
+            config.tls.session_tickets = std.meta.stringToEnum(TlsConfig.SessionTickets, value) orelse return error.InvalidSessionTicketMode;
+        } else if (std.mem.eql(u8, key, "tls_session_cache_size")) {
+            config.tls.session_cache_size = try std.fmt.parseInt(usize, value, 10);
+        } else if (std.mem.eql(u8, key, "tls_ticket_key_file")) {
+            if (config.tls.ticket_key_file) |old| config.allocator.free(old);
+            config.tls.ticket_key_file = try config.allocator.dupeZ(u8, value);
+        } else if (std.mem.eql(u8, key, "tls_ticket_key_rotation")) {
+            config.tls.ticket_key_rotation_s = try std.fmt.parseInt(u32, value, 10);
         } else if (std.mem.eql(u8, key, "rate_limit")) {
             // Parse rate limit as "1000 req/s" format
             if (std.mem.indexOf(u8, value, "req/s")) |pos| {
@@ -303,6 +513,15 @@ fn parseKeyValue(config: *Config, section: ?[]const u8, key: []const u8, value:
         } else if (std.mem.eql(u8, key, "metrics_prometheus_enabled")) {
             config.metrics.prometheus_enabled = std.mem.eql(u8, value, "true");
         }
+    } else if (std.mem.eql(u8, section.?, "routes")) {
+        // /api/:version/*rest = "proxy" (the pattern may be quoted too)
+        const route_pattern = std.mem.trim(u8, key, "\"'");
+        if (route_pattern.len == 0 or route_pattern[0] != '/') return error.InvalidRoute;
+        const handler = try Route.Handler.parse(config.allocator, value);
+        errdefer handler.deinit(config.allocator);
+        const pattern = try config.allocator.dupe(u8, route_pattern);
+        errdefer config.allocator.free(pattern);
+        try config.routes.append(config.allocator, .{ .pattern = pattern, .handler = handler });
     } else if (std.mem.startsWith(u8, section.?, "backends.")) {
         // Backend configuration
         // For simplicity, we'll just add all backends in order
@@ -348,6 +567,11 @@ pub const ConfigError = error{
     InvalidBackendPort,
     InvalidBackendWeight,
     InvalidRateLimitFormat,
+    InvalidRingMode,
+    InvalidHugePagesMode,
+    InvalidRoute,
+    IncompleteTlsConfig,
+    InvalidSessionTicketMode,
     FileNotFound,
     ParseError,
 };
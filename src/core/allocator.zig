@@ -1,192 +1,401 @@
 const std = @import("std");
+const builtin = @import("builtin");
 
-// Slab allocator for fixed-size allocations (connection buffers)
-// This ensures zero allocations after startup for connection handling
+// Slab allocator for small per-connection objects (HTTP/2 connections and streams,
+// HPACK tables, QUIC connections). Requests are rounded up to a power-of-two size
+// class; each class keeps an intrusive freelist threaded through its free slots, so
+// once a class has warmed up, alloc and free are a pointer pop/push with no calls
+// into the backing allocator. Slots are carved from CHUNK_SIZE chunks that are only
+// returned on deinit. Anything larger than the biggest class goes to the backing
+// allocator directly.
+//
+// Not thread-safe: each worker owns its own instance.
 pub const SlabAllocator = struct {
-    const Node = struct {
-        data: []u8,
-        next: ?*Node,
+    pub const MIN_CLASS_SIZE: usize = 16;
+    pub const MAX_CLASS_SIZE: usize = 4096;
+    pub const CHUNK_SIZE: usize = 64 * 1024;
+    const CLASS_COUNT = std.math.log2_int(usize, MAX_CLASS_SIZE) - std.math.log2_int(usize, MIN_CLASS_SIZE) + 1;
+    const chunk_alignment = std.mem.Alignment.fromByteUnits(MAX_CLASS_SIZE);
+
+    // Stored in the first bytes of every free slot
+    const FreeSlot = struct {
+        next: ?*FreeSlot,
     };
 
-    arena: std.heap.ArenaAllocator,
-    free_list: ?*Node,
-    slot_size: usize,
-    slots_per_chunk: usize,
+    backing_allocator: std.mem.Allocator,
+    free_lists: [CLASS_COUNT]?*FreeSlot = [_]?*FreeSlot{null} ** CLASS_COUNT,
+    chunks: std.ArrayListUnmanaged([]align(MAX_CLASS_SIZE) u8) = .{},
 
-    pub fn init(backing_allocator: std.mem.Allocator, slot_size: usize, slots_per_chunk: usize) !SlabAllocator {
-        var arena = std.heap.ArenaAllocator.init(backing_allocator);
-        errdefer arena.deinit();
+    pub fn init(backing_allocator: std.mem.Allocator) SlabAllocator {
+        return SlabAllocator{ .backing_allocator = backing_allocator };
+    }
 
-        // Pre-allocate initial chunk
-        const chunk = try arena.allocator().alloc(u8, slot_size * slots_per_chunk);
-        var free_list: ?*Node = null;
-
-        // Build free list from back to front to maintain order
-        var i: usize = slots_per_chunk;
-        while (i > 0) {
-            i -= 1;
-            const node = try arena.allocator().create(Node);
-            node.data = chunk[i * slot_size ..][0..slot_size];
-            node.next = free_list;
-            free_list = node;
+    pub fn deinit(self: *SlabAllocator) void {
+        for (self.chunks.items) |chunk| {
+            self.backing_allocator.free(chunk);
         }
+        self.chunks.deinit(self.backing_allocator);
+    }
 
-        return SlabAllocator{
-            .arena = arena,
-            .free_list = free_list,
-            .slot_size = slot_size,
-            .slots_per_chunk = slots_per_chunk,
+    /// Allocator interface; the SlabAllocator must not move while it is in use
+    pub fn allocator(self: *SlabAllocator) std.mem.Allocator {
+        return .{
+            .ptr = self,
+            .vtable = &.{
+                .alloc = alloc,
+                .resize = resize,
+                .remap = remap,
+                .free = free,
+            },
         };
     }
 
-    pub fn deinit(self: *SlabAllocator) void {
-        self.arena.deinit();
+    // Size class for a request, or null if it is too large for the slabs.
+    // Slots of class size n are n-aligned, so alignment only ever bumps the class.
+    fn classIndex(len: usize, alignment: std.mem.Alignment) ?usize {
+        const size = @max(len, alignment.toByteUnits(), MIN_CLASS_SIZE);
+        if (size > MAX_CLASS_SIZE) return null;
+        return std.math.log2_int_ceil(usize, size) - std.math.log2_int(usize, MIN_CLASS_SIZE);
+    }
+
+    fn classSize(index: usize) usize {
+        return MIN_CLASS_SIZE << @intCast(index);
     }
 
-    pub fn alloc(self: *SlabAllocator) ?[]u8 {
-        if (self.free_list) |node| {
-            self.free_list = node.next;
-            return node.data;
+    // Carve a new chunk into slots of one class
+    fn refill(self: *SlabAllocator, index: usize) bool {
+        const chunk = self.backing_allocator.alignedAlloc(u8, chunk_alignment, CHUNK_SIZE) catch return false;
+        self.chunks.append(self.backing_allocator, chunk) catch {
+            self.backing_allocator.free(chunk);
+            return false;
+        };
+
+        const slot_size = classSize(index);
+        var offset: usize = CHUNK_SIZE;
+        while (offset >= slot_size) {
+            offset -= slot_size;
+            const slot: *FreeSlot = @ptrCast(@alignCast(chunk.ptr + offset));
+            slot.next = self.free_lists[index];
+            self.free_lists[index] = slot;
         }
-        return null;
+        return true;
     }
 
-    pub fn free(self: *SlabAllocator, buf: []u8) void {
-        // Create a new node and add to free list
-        // Note: This requires allocation, but we'll use the arena
-        const node = self.arena.allocator().create(Node) catch return;
-        node.data = buf;
-        node.next = self.free_list;
-        self.free_list = node;
+    fn alloc(ctx: *anyopaque, len: usize, alignment: std.mem.Alignment, ret_addr: usize) ?[*]u8 {
+        const self: *SlabAllocator = @ptrCast(@alignCast(ctx));
+        const index = classIndex(len, alignment) orelse
+            return self.backing_allocator.rawAlloc(len, alignment, ret_addr);
+
+        if (self.free_lists[index] == null and !self.refill(index)) return null;
+        const slot = self.free_lists[index].?;
+        self.free_lists[index] = slot.next;
+        return @ptrCast(slot);
     }
 
-    pub fn allocator(self: *SlabAllocator) std.mem.Allocator {
-        return self.arena.allocator();
+    fn resize(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) bool {
+        const self: *SlabAllocator = @ptrCast(@alignCast(ctx));
+        const old_index = classIndex(memory.len, alignment);
+        const new_index = classIndex(new_len, alignment);
+        if (old_index == null and new_index == null) {
+            return self.backing_allocator.rawResize(memory, alignment, new_len, ret_addr);
+        }
+        // In place only within the same class, so free() later finds the right freelist
+        const old = old_index orelse return false;
+        const new = new_index orelse return false;
+        return old == new;
+    }
+
+    fn remap(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, new_len: usize, ret_addr: usize) ?[*]u8 {
+        const self: *SlabAllocator = @ptrCast(@alignCast(ctx));
+        if (classIndex(memory.len, alignment) == null and classIndex(new_len, alignment) == null) {
+            return self.backing_allocator.rawRemap(memory, alignment, new_len, ret_addr);
+        }
+        return if (resize(ctx, memory, alignment, new_len, ret_addr)) memory.ptr else null;
+    }
+
+    fn free(ctx: *anyopaque, memory: []u8, alignment: std.mem.Alignment, ret_addr: usize) void {
+        const self: *SlabAllocator = @ptrCast(@alignCast(ctx));
+        const index = classIndex(memory.len, alignment) orelse
+            return self.backing_allocator.rawFree(memory, alignment, ret_addr);
+
+        const slot: *FreeSlot = @ptrCast(@alignCast(memory.ptr));
+        slot.next = self.free_lists[index];
+        self.free_lists[index] = slot;
+    }
+};
+
+// Reserved address space for buffer pools. The kernel only commits a page when it is
+// first touched, so the pool size is a ceiling rather than an upfront cost, and pages
+// are faulted in by the (pinned) worker that uses them. Optionally backed by explicit
+// hugetlbfs pages or THP, and bound to the NUMA node of the creating thread.
+pub const BufferArena = struct {
+    region: []align(std.heap.page_size_min) u8,
+    // Mode actually in effect after falling back
+    huge_pages: HugePages,
+    // NUMA node the arena is bound to, if numa_local was requested and succeeded
+    numa_node: ?u32,
+
+    pub const HUGE_PAGE_SIZE: usize = 2 * 1024 * 1024;
+
+    pub const HugePages = enum {
+        off,
+        /// madvise(MADV_HUGEPAGE): THP when the kernel can assemble them
+        transparent,
+        /// MAP_HUGETLB from the reserved hugetlbfs pool, falls back to transparent
+        explicit,
+    };
+
+    pub const Options = struct {
+        huge_pages: HugePages = .off,
+        numa_local: bool = false,
+    };
+
+    pub fn init(size: usize, options: Options) !BufferArena {
+        const len = std.mem.alignForward(usize, size, HUGE_PAGE_SIZE);
+        const prot = std.posix.PROT.READ | std.posix.PROT.WRITE;
+        var huge_pages = options.huge_pages;
+
+        const region = blk: {
+            if (builtin.os.tag == .linux and huge_pages == .explicit) {
+                // No NORESERVE here: hugetlb pages are reserved at mmap time so a
+                // later fault can't SIGBUS when the hugepage pool runs dry
+                if (std.posix.mmap(null, len, prot, .{ .TYPE = .PRIVATE, .ANONYMOUS = true, .HUGETLB = true }, -1, 0)) |mem| {
+                    break :blk mem;
+                } else |err| {
+                    std.log.warn("MAP_HUGETLB arena of {} MiB failed ({}), falling back to transparent huge pages", .{ len >> 20, err });
+                    huge_pages = .transparent;
+                }
+            }
+            break :blk try std.posix.mmap(null, len, prot, .{ .TYPE = .PRIVATE, .ANONYMOUS = true, .NORESERVE = true }, -1, 0);
+        };
+        errdefer std.posix.munmap(region);
+
+        if (builtin.os.tag == .linux and huge_pages == .transparent) {
+            std.posix.madvise(region.ptr, region.len, std.posix.MADV.HUGEPAGE) catch |err| {
+                std.log.warn("MADV_HUGEPAGE failed ({}), using regular pages", .{err});
+                huge_pages = .off;
+            };
+        }
+
+        const numa_node = if (options.numa_local) bindToLocalNode(region) else null;
+
+        return BufferArena{
+            .region = region,
+            .huge_pages = huge_pages,
+            .numa_node = numa_node,
+        };
+    }
+
+    pub fn deinit(self: *BufferArena) void {
+        std.posix.munmap(self.region);
+    }
+
+    // Prefer the NUMA node of the CPU we're running on (workers are pinned before
+    // creating their pools). MPOL_PREFERRED still falls back when the node is full.
+    fn bindToLocalNode(region: []align(std.heap.page_size_min) u8) ?u32 {
+        if (builtin.os.tag != .linux) return null;
+        const linux = std.os.linux;
+        const MPOL_PREFERRED: usize = 1;
+
+        var cpu: u32 = 0;
+        var node: u32 = 0;
+        if (std.posix.errno(linux.syscall3(.getcpu, @intFromPtr(&cpu), @intFromPtr(&node), 0)) != .SUCCESS) return null;
+        if (node >= @bitSizeOf(usize)) return null;
+
+        const mask: usize = @as(usize, 1) << @intCast(node);
+        // maxnode counts one past the last bit the kernel reads
+        const rc = linux.syscall6(.mbind, @intFromPtr(region.ptr), region.len, MPOL_PREFERRED, @intFromPtr(&mask), @bitSizeOf(usize) + 1, 0);
+        if (std.posix.errno(rc) != .SUCCESS) {
+            std.log.warn("mbind to NUMA node {} failed ({}), using default placement", .{ node, std.posix.errno(rc) });
+            return null;
+        }
+        return node;
     }
 };
 
 // Fixed buffer pool for read/write operations
-// Pre-allocates all buffers at startup, zero allocations during runtime
-// Note: Single-threaded for now (io_uring event loop), mutex can be removed later
+// Both pools are carved out of one BufferArena; nothing is allocated at runtime
+// and nothing is committed until a buffer is first used. Free lists are LIFO, so
+// the set of pages in use stays as small as the live connection count allows.
+//
+// Each pool is one contiguous slab, so a buffer's index is computed from its address
+// and release is O(1). Free buffers sit on a lock-free (Treiber) stack of indices; the
+// thread that created the pool (its io_uring worker) additionally keeps a small local
+// cache that it refills from and spills to the shared stack in batches, so its
+// acquire/release usually touches no atomics at all. Other threads may acquire and
+// release too - they go straight to the shared stack.
 pub const BufferPool = struct {
+    const EMPTY: u32 = std.math.maxInt(u32);
+    const CACHE_SIZE: usize = 64;
+    const CACHE_BATCH: usize = CACHE_SIZE / 2;
+
     const Pool = struct {
-        buffers: [][]u8,
-        free_indices: std.ArrayList(usize),
-        mutex: std.Thread.Mutex,
+        // One contiguous allocation so the pool can be registered with io_uring as a single region
+        slab: []u8,
+        buffer_size: usize,
+        // Free-stack links: next[i] is the index below buffer i on the stack
+        next: []std.atomic.Value(u32),
+        // Top of the free stack: ABA tag in the upper 32 bits, buffer index in the lower 32
+        head: std.atomic.Value(u64),
+        // Owner-thread cache of free indices
+        cache: [CACHE_SIZE]u32 = undefined,
+        cache_len: usize = 0,
+
+        fn init(backing_allocator: std.mem.Allocator, slab: []u8, buffer_size: usize, pool_size: usize) !Pool {
+            std.debug.assert(pool_size < EMPTY);
+            const next = try backing_allocator.alloc(std.atomic.Value(u32), pool_size);
+
+            // Chain every buffer onto the free stack, lowest index on top
+            for (next, 0..) |*link, i| {
+                link.* = std.atomic.Value(u32).init(if (i + 1 < pool_size) @intCast(i + 1) else EMPTY);
+            }
+            return Pool{
+                .slab = slab,
+                .buffer_size = buffer_size,
+                .next = next,
+                .head = std.atomic.Value(u64).init(if (pool_size > 0) 0 else EMPTY),
+            };
+        }
+
+        fn deinit(self: *Pool, backing_allocator: std.mem.Allocator) void {
+            backing_allocator.free(self.next);
+        }
+
+        fn buffer(self: *const Pool, idx: u32) []u8 {
+            return self.slab[@as(usize, idx) * self.buffer_size ..][0..self.buffer_size];
+        }
+
+        // Index of a buffer handed out by this pool, or null for foreign memory
+        fn indexOf(self: *const Pool, buf: []u8) ?u32 {
+            const addr = @intFromPtr(buf.ptr);
+            const base = @intFromPtr(self.slab.ptr);
+            if (addr < base or addr >= base + self.slab.len) return null;
+            return @intCast((addr - base) / self.buffer_size);
+        }
+
+        fn pop(self: *Pool) ?u32 {
+            var old = self.head.load(.acquire);
+            while (true) {
+                const idx: u32 = @truncate(old);
+                if (idx == EMPTY) return null;
+                // May read a link that a racing pop/push is rewriting; the tag makes that CAS fail
+                const next_idx = self.next[idx].load(.monotonic);
+                const new = (((old >> 32) +% 1) << 32) | next_idx;
+                old = self.head.cmpxchgWeak(old, new, .acq_rel, .acquire) orelse return idx;
+            }
+        }
+
+        // Push first..last, already linked through next[], with a single CAS
+        fn pushChain(self: *Pool, first: u32, last: u32) void {
+            var old = self.head.load(.monotonic);
+            while (true) {
+                self.next[last].store(@truncate(old), .monotonic);
+                const new = (((old >> 32) +% 1) << 32) | first;
+                old = self.head.cmpxchgWeak(old, new, .release, .monotonic) orelse return;
+            }
+        }
+
+        fn acquireCached(self: *Pool) ?u32 {
+            if (self.cache_len == 0) {
+                // Refill half the cache from the shared stack
+                while (self.cache_len < CACHE_BATCH) {
+                    self.cache[self.cache_len] = self.pop() orelse break;
+                    self.cache_len += 1;
+                }
+                if (self.cache_len == 0) return null;
+            }
+            self.cache_len -= 1;
+            return self.cache[self.cache_len];
+        }
+
+        fn releaseCached(self: *Pool, idx: u32) void {
+            if (self.cache_len == CACHE_SIZE) {
+                // Spill the older half of the cache back to the shared stack in one CAS
+                const spill = self.cache[0..CACHE_BATCH];
+                for (spill[0 .. spill.len - 1], spill[1..]) |from, to| {
+                    self.next[from].store(to, .monotonic);
+                }
+                self.pushChain(spill[0], spill[spill.len - 1]);
+                std.mem.copyForwards(u32, self.cache[0 .. CACHE_SIZE - CACHE_BATCH], self.cache[CACHE_BATCH..]);
+                self.cache_len -= CACHE_BATCH;
+            }
+            self.cache[self.cache_len] = idx;
+            self.cache_len += 1;
+        }
     };
 
+    arena: BufferArena,
     read_pool: Pool,
     write_pool: Pool,
     buffer_size: usize,
     pool_size: usize,
     backing_allocator: std.mem.Allocator,
+    // Thread allowed to use the pools' local caches
+    owner: std.Thread.Id,
 
-    pub fn init(backing_allocator: std.mem.Allocator, buffer_size: usize, pool_size: usize) !BufferPool {
-        // Pre-allocate all read buffers
-        const read_buffers = try backing_allocator.alloc([]u8, pool_size);
-        errdefer backing_allocator.free(read_buffers);
-
-        var read_free = std.ArrayList(usize).initCapacity(backing_allocator, pool_size) catch @panic("Failed to init read_free list");
-        errdefer read_free.deinit(backing_allocator);
-
-        for (0..pool_size) |i| {
-            const buf = try backing_allocator.alloc(u8, buffer_size);
-            read_buffers[i] = buf;
-            try read_free.append(backing_allocator, i);
-        }
-
-        // Pre-allocate all write buffers
-        const write_buffers = try backing_allocator.alloc([]u8, pool_size);
-        errdefer backing_allocator.free(write_buffers);
+    pub fn init(backing_allocator: std.mem.Allocator, buffer_size: usize, pool_size: usize, arena_options: BufferArena.Options) !BufferPool {
+        // Read pool first, write pool on the next huge page boundary
+        const pool_bytes = buffer_size * pool_size;
+        const write_offset = std.mem.alignForward(usize, pool_bytes, BufferArena.HUGE_PAGE_SIZE);
+        var arena = try BufferArena.init(write_offset + pool_bytes, arena_options);
+        errdefer arena.deinit();
 
-        var write_free = std.ArrayList(usize).initCapacity(backing_allocator, pool_size) catch @panic("Failed to init write_free list");
-        errdefer write_free.deinit(backing_allocator);
+        var read_pool = try Pool.init(backing_allocator, arena.region[0..pool_bytes], buffer_size, pool_size);
+        errdefer read_pool.deinit(backing_allocator);
 
-        for (0..pool_size) |i| {
-            const buf = try backing_allocator.alloc(u8, buffer_size);
-            write_buffers[i] = buf;
-            try write_free.append(backing_allocator, i);
-        }
+        const write_pool = try Pool.init(backing_allocator, arena.region[write_offset..][0..pool_bytes], buffer_size, pool_size);
 
         return BufferPool{
-            .read_pool = Pool{
-                .buffers = read_buffers,
-                .free_indices = read_free,
-                .mutex = std.Thread.Mutex{},
-            },
-            .write_pool = Pool{
-                .buffers = write_buffers,
-                .free_indices = write_free,
-                .mutex = std.Thread.Mutex{},
-            },
+            .arena = arena,
+            .read_pool = read_pool,
+            .write_pool = write_pool,
             .buffer_size = buffer_size,
             .pool_size = pool_size,
             .backing_allocator = backing_allocator,
+            .owner = std.Thread.getCurrentId(),
         };
     }
 
     pub fn deinit(self: *BufferPool) void {
         // Free all buffers
-        for (self.read_pool.buffers) |buf| {
-            self.backing_allocator.free(buf);
-        }
-        self.backing_allocator.free(self.read_pool.buffers);
-        self.read_pool.free_indices.deinit(self.backing_allocator);
+        self.read_pool.deinit(self.backing_allocator);
+        self.write_pool.deinit(self.backing_allocator);
+        self.arena.deinit();
+    }
 
-        for (self.write_pool.buffers) |buf| {
-            self.backing_allocator.free(buf);
-        }
-        self.backing_allocator.free(self.write_pool.buffers);
-        self.write_pool.free_indices.deinit(self.backing_allocator);
+    /// Memory backing every write buffer (for io_uring_register_buffers)
+    pub fn writeRegion(self: *const BufferPool) []u8 {
+        return self.write_pool.slab;
     }
 
     pub fn acquireRead(self: *BufferPool) ?[]u8 {
-        self.read_pool.mutex.lock();
-        defer self.read_pool.mutex.unlock();
-
-        // Check if list is empty before popping to avoid panic
-        if (self.read_pool.free_indices.items.len == 0) {
-            return null;
-        }
-        const idx = self.read_pool.free_indices.pop();
-        return self.read_pool.buffers[idx.?];
+        return self.acquire(&self.read_pool);
     }
 
     pub fn releaseRead(self: *BufferPool, buf: []u8) void {
-        self.read_pool.mutex.lock();
-        defer self.read_pool.mutex.unlock();
-
-        // Find the buffer index
-        for (self.read_pool.buffers, 0..) |pool_buf, idx| {
-            if (pool_buf.ptr == buf.ptr) {
-                self.read_pool.free_indices.append(self.backing_allocator, idx) catch return;
-                return;
-            }
-        }
+        self.release(&self.read_pool, buf);
     }
 
     pub fn acquireWrite(self: *BufferPool) ?[]u8 {
-        self.write_pool.mutex.lock();
-        defer self.write_pool.mutex.unlock();
-
-        // Check if list is empty before popping to avoid panic
-        if (self.write_pool.free_indices.items.len == 0) {
-            return null;
-        }
-        const idx = self.write_pool.free_indices.pop();
-        return self.write_pool.buffers[idx.?];
+        return self.acquire(&self.write_pool);
     }
 
     pub fn releaseWrite(self: *BufferPool, buf: []u8) void {
-        self.write_pool.mutex.lock();
-        defer self.write_pool.mutex.unlock();
-
-        // Find the buffer index
-        for (self.write_pool.buffers, 0..) |pool_buf, idx| {
-            if (pool_buf.ptr == buf.ptr) {
-                self.write_pool.free_indices.append(self.backing_allocator, idx) catch return;
-                return;
-            }
+        self.release(&self.write_pool, buf);
+    }
+
+    fn acquire(self: *BufferPool, pool: *Pool) ?[]u8 {
+        const idx = if (std.Thread.getCurrentId() == self.owner) pool.acquireCached() else pool.pop();
+        return pool.buffer(idx orelse return null);
+    }
+
+    fn release(self: *BufferPool, pool: *Pool, buf: []u8) void {
+        // Foreign buffers are ignored, as before
+        const idx = pool.indexOf(buf) orelse return;
+        if (std.Thread.getCurrentId() == self.owner) {
+            pool.releaseCached(idx);
+        } else {
+            pool.pushChain(idx, idx);
         }
     }
 };
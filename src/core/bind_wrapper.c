@@ -3,6 +3,8 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <fcntl.h>  // For AT_FDCWD
+#include <sched.h>  // For sched_setaffinity
+#include <stdint.h>
 #include <liburing.h>
 
 int blitz_bind(int sockfd, const struct sockaddr_in *addr) {
@@ -25,3 +27,61 @@ struct io_uring_sqe *blitz_io_uring_get_sqe(struct io_uring *ring) {
     return io_uring_get_sqe(ring);
 }
 
+
+// Pin the calling thread to one CPU (CPU_SET/CPU_ZERO are macros Zig can't call)
+int blitz_pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+// Multishot recv with buffer selection (buf_group lives in an anonymous union Zig can't reach)
+void blitz_prep_recv_multishot(struct io_uring_sqe *sqe, int fd, int bgid) {
+    io_uring_prep_recv_multishot(sqe, fd, NULL, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid;
+}
+
+// Multishot recvmsg with buffer selection: each CQE's buffer starts with a
+// struct io_uring_recvmsg_out, then the source address, cmsgs and payload
+void blitz_prep_recvmsg_multishot(struct io_uring_sqe *sqe, int fd, struct msghdr *msg, int bgid) {
+    io_uring_prep_recvmsg_multishot(sqe, fd, msg, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid;
+}
+
+// Provided buffer ring helpers (advance uses io_uring_smp_store_release)
+void blitz_buf_ring_add(struct io_uring_buf_ring *br, void *addr, unsigned int len,
+                        unsigned short bid, int mask, int buf_offset) {
+    io_uring_buf_ring_add(br, addr, len, bid, mask, buf_offset);
+}
+
+void blitz_buf_ring_advance(struct io_uring_buf_ring *br, int count) {
+    io_uring_buf_ring_advance(br, count);
+}
+
+// Mark an SQE's fd as a slot in the registered file table
+void blitz_sqe_set_fixed_file(struct io_uring_sqe *sqe) {
+    sqe->flags |= IOSQE_FIXED_FILE;
+}
+
+// Batch CQE reaping: peek up to count ready CQEs, then mark them all seen at once
+unsigned blitz_io_uring_peek_batch_cqe(struct io_uring *ring, struct io_uring_cqe **cqes, unsigned count) {
+    return io_uring_peek_batch_cqe(ring, cqes, count);
+}
+
+void blitz_io_uring_cq_advance(struct io_uring *ring, unsigned nr) {
+    io_uring_cq_advance(ring, nr);
+}
+
+// Splice between two fds; off_in of -1 uses (and advances) the current position, as for pipes
+void blitz_prep_splice(struct io_uring_sqe *sqe, int fd_in, int64_t off_in, int fd_out,
+                       unsigned int nbytes, unsigned int splice_flags) {
+    io_uring_prep_splice(sqe, fd_in, off_in, fd_out, -1, nbytes, splice_flags);
+}
+
+// Chain the next SQE behind this one: it only starts once this one has completed successfully
+void blitz_sqe_set_link(struct io_uring_sqe *sqe) {
+    sqe->flags |= IOSQE_IO_LINK;
+}
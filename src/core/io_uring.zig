@@ -2,7 +2,13 @@ const std = @import("std");
 const builtin = @import("builtin");
 const allocator = @import("allocator.zig");
 const http = @import("../http/parser.zig");
-const protocol = @import("protocol.zig");
+const router = @import("../http/router.zig");
+const http_response = @import("../http/response.zig");
+const static_files = @import("../http/static_files.zig");
+const config = @import("../config/mod.zig");
+const TimerWheel = @import("timer_wheel.zig").TimerWheel;
+const tls = @import("../tls/tls.zig");
+const handshake_pool = @import("../tls/handshake_pool.zig");
 
 // Use liburing for io_uring support
 // Define AT_FDCWD if not already defined (needed for liburing.h on some systems)
@@ -24,11 +30,28 @@ pub extern fn blitz_bind(sockfd: c_int, addr: [*c]const c.struct_sockaddr_in) c_
 extern fn blitz_io_uring_cqe_seen(ring: *c.struct_io_uring, cqe: ?*c.struct_io_uring_cqe) void;
 extern fn blitz_io_uring_wait_cqe(ring: *c.struct_io_uring, cqe_ptr: *?*c.struct_io_uring_cqe) c_int;
 extern fn blitz_io_uring_get_sqe(ring: *c.struct_io_uring) ?*c.struct_io_uring_sqe;
-
-const SQ_RING_SIZE: u32 = 4096;
+pub extern fn blitz_pin_to_cpu(cpu: c_int) c_int;
+extern fn blitz_prep_recv_multishot(sqe: *c.struct_io_uring_sqe, fd: c_int, bgid: c_int) void;
+pub extern fn blitz_prep_recvmsg_multishot(sqe: *c.struct_io_uring_sqe, fd: c_int, msg: *c.struct_msghdr, bgid: c_int) void;
+pub extern fn blitz_buf_ring_add(br: *c.struct_io_uring_buf_ring, addr: ?*anyopaque, len: c_uint, bid: c_ushort, mask: c_int, buf_offset: c_int) void;
+pub extern fn blitz_buf_ring_advance(br: *c.struct_io_uring_buf_ring, count: c_int) void;
+extern fn blitz_sqe_set_fixed_file(sqe: *c.struct_io_uring_sqe) void;
+pub extern fn blitz_io_uring_peek_batch_cqe(ring: *c.struct_io_uring, cqes: [*]?*c.struct_io_uring_cqe, count: c_uint) c_uint;
+pub extern fn blitz_io_uring_cq_advance(ring: *c.struct_io_uring, nr: c_uint) void;
+extern fn blitz_prep_splice(sqe: *c.struct_io_uring_sqe, fd_in: c_int, off_in: i64, fd_out: c_int, nbytes: c_uint, splice_flags: c_uint) void;
+extern fn blitz_sqe_set_link(sqe: *c.struct_io_uring_sqe) void;
+
+const CQE_BATCH_SIZE: usize = 256; // CQEs reaped per loop iteration
 const BUFFER_SIZE: usize = 4096;
 const BUFFER_POOL_SIZE: usize = 200000; // Pre-allocated buffers
-// Note: MAX_CONNECTIONS removed - using HashMap for dynamic connection storage
+const RECV_BUFFER_RING_SIZE: usize = 4096; // Provided buffers per worker (power of two, kernel max 32768)
+const RECV_BUFFER_GROUP: c_int = 0; // Buffer group ID for multishot recv
+const REGISTERED_FILE_TABLE_SIZE: c_uint = 65536; // Sparse fixed-file slots per worker (registered I/O mode)
+const WRITE_BUFFER_INDEX: c_int = 0; // Registered buffer slot holding the write pool
+const TIMER_TICK_NS: i64 = 100 * std.time.ns_per_ms; // Timer wheel resolution
+const MAX_CONNECTION_SLOTS: usize = 1 << 20; // Connection table cap when RLIMIT_NOFILE is larger
+const SPLICE_CHUNK: u64 = 64 * 1024; // Bytes moved per splice pair (default pipe capacity)
+const INOTIFY_BUFFER_SIZE: usize = 4096; // inotify events read per completion
 
 // TLS constants
 const TLS_RECORD_TYPE_HANDSHAKE: u8 = 0x16; // TLS handshake record type
@@ -36,98 +59,195 @@ const TLS_RECORD_TYPE_HANDSHAKE: u8 = 0x16; // TLS handshake record type
 // Pre-allocated HTTP response (no allocation needed) - kept for fallback
 const HTTP_RESPONSE = http.CommonResponses.OK;
 
-// Import TLS and HTTP/2 modules
-// const tls = @import("tls/tls.zig"); // Temporarily disabled for picotls migration
-const http2 = @import("../http2/connection.zig");
-
-// TLS Connection stub type (for when TLS is re-enabled)
-// This defines the structure that tls_conn should have, including the protocol field
-const TlsConnectionStub = struct {
-    pub const State = enum { handshake, connected, tls_error, closed };
+// Connection state, one cache-line-aligned slot per fd in ConnectionTable
+const Connection = struct {
+    fd: c_int align(std.atomic.cache_line),
+    read_buffer: ?[]u8 = null,
+    write_buffer: ?[]u8 = null,
+    in_use: bool = false,
+    // Bumped each time the slot is released; carried in user_data to spot stale completions
+    generation: u24 = 0,
+    // Connection tracking for limits/timeouts
+    created_at: i64 = 0,
+    last_active: i64 = 0,
+    request_count: u32 = 0,
+    // Multishot recv state: while armed, the fd is only closed on the final recv CQE
+    // so the kernel can't hand the same fd number to a new connection too early
+    recv_armed: bool = false,
+    closing: bool = false,
+    // Responses produced while a write is in flight, flushed when it completes
+    queued_write: ?[]u8 = null,
+    queued_len: usize = 0,
+    // Bytes of a partial (or not yet answered pipelined) request held in read_buffer
+    pending_len: usize = 0,
+    // Framing of the request being received; bodies stream through it unbuffered
+    request_parser: http.RequestParser = .{},
+    // When the current request started arriving, 0 once its headers are complete (slowloris guard)
+    request_started_at: i64 = 0,
+    // Next idle/age/request deadline check on the worker's timer wheel
+    timer: TimerWheel.Node = .{},
+    // Static file body to splice once the queued head has been written
+    file_send: ?FileSend = null,
+    // file -> pipe -> socket; created on the first file response
+    splice_pipe: [2]c_int = .{ -1, -1 },
+    // TLS listener: handshake and record state, with kTLS once the keys are in the kernel
+    tls_session: ?*tls.TlsConnection = null,
+    // Handshake step running on the offload pool; tls_session is off limits until it's back
+    handshake_job: ?*HandshakeJob = null,
 
-    protocol: protocol.Protocol = .http1_1,
-    state: State = .handshake,
-    // Other fields would be added when TLS is re-implemented
-    // read_bio: ?*anyopaque,
-    // write_bio: ?*anyopaque,
-    // etc.
+    // Connection limits
+    const MAX_REQUESTS_PER_CONN: u32 = 1000;
+    const IDLE_TIMEOUT_NS: i64 = 30 * std.time.ns_per_s; // 30 seconds
+    const MAX_CONNECTION_AGE_NS: i64 = 300 * std.time.ns_per_s; // 5 minutes
+    const REQUEST_TIMEOUT_NS: i64 = 10 * std.time.ns_per_s; // Headers must complete within 10 seconds
 
-    pub fn deinit(self: *TlsConnectionStub) void {
-        _ = self; // TLS is disabled, no cleanup needed
+    // Earliest point at which one of the time limits is exceeded
+    fn deadline(self: *const Connection) i64 {
+        var earliest = @min(self.last_active + IDLE_TIMEOUT_NS, self.created_at + MAX_CONNECTION_AGE_NS);
+        if (self.request_started_at != 0) {
+            earliest = @min(earliest, self.request_started_at + REQUEST_TIMEOUT_NS);
+        }
+        return earliest;
     }
 
-    pub fn clearReadBio(self: *TlsConnectionStub) void {
-        _ = self; // TLS is disabled
+    fn timeoutReason(self: *const Connection, now: i64) []const u8 {
+        if (self.request_started_at != 0 and now >= self.request_started_at + REQUEST_TIMEOUT_NS) return "request timeout";
+        if (now >= self.created_at + MAX_CONNECTION_AGE_NS) return "max age";
+        return "idle timeout";
     }
+};
 
-    pub fn clearEncryptedOutput(self: *TlsConnectionStub) void {
-        _ = self; // TLS is disabled
+// Remaining range of a static file response. in_pipe counts bytes already
+// spliced into the pipe that have not reached the socket yet.
+const FileSend = struct {
+    entry: *static_files.Entry,
+    offset: u64,
+    end: u64,
+    in_pipe: u64 = 0,
+    // Whether the pipe -> socket splice was linked behind the file -> pipe one
+    linked: bool = false,
+};
+
+// Connections indexed directly by fd, or by fixed-file slot with registered I/O.
+// The slot array is reserved up front with mmap and pages are only committed once
+// an fd in their range is used, so a lookup is a bounds check plus an index and a
+// close never rehashes. A slot's generation is bumped when it is released and is
+// carried in user_data, so completions still in flight for an fd's previous owner
+// are dropped instead of being applied to the new connection.
+const ConnectionTable = struct {
+    region: []align(std.heap.page_size_min) u8,
+    slots: []Connection,
+    // One past the highest slot ever opened; bounds the idle sweep
+    high_water: usize = 0,
+    // Slots in use, for the stats line
+    live: u64 = 0,
+
+    fn init(capacity: usize) !ConnectionTable {
+        // Anonymous mappings are zero-filled, i.e. every slot starts free at generation 0
+        const region = try std.posix.mmap(
+            null,
+            capacity * @sizeOf(Connection),
+            std.posix.PROT.READ | std.posix.PROT.WRITE,
+            .{ .TYPE = .PRIVATE, .ANONYMOUS = true, .NORESERVE = true },
+            -1,
+            0,
+        );
+        const slots: [*]Connection = @ptrCast(@alignCast(region.ptr));
+        return .{ .region = region, .slots = slots[0..capacity] };
     }
 
-    pub fn feedData(self: *TlsConnectionStub, data: []const u8) !void {
-        _ = self;
-        _ = data;
-        return {}; // TLS is disabled
+    fn deinit(self: *ConnectionTable) void {
+        std.posix.munmap(self.region);
     }
 
-    pub fn doHandshake(self: *TlsConnectionStub) !void {
-        _ = self;
-        return {}; // TLS is disabled
+    // Claim the slot for a newly accepted fd; null if the fd doesn't fit in the table
+    fn open(self: *ConnectionTable, fd: c_int, now: i64) ?*Connection {
+        if (fd < 0 or @as(usize, @intCast(fd)) >= self.slots.len) return null;
+        const index: usize = @intCast(fd);
+        const slot = &self.slots[index];
+        const generation = slot.generation;
+        slot.* = Connection{
+            .fd = fd,
+            .generation = generation,
+            .in_use = true,
+            .created_at = now,
+            .last_active = now,
+        };
+        self.high_water = @max(self.high_water, index + 1);
+        self.live += 1;
+        return slot;
     }
 
-    pub fn hasEncryptedOutput(self: *TlsConnectionStub) bool {
-        _ = self;
-        return false; // TLS is disabled
+    // Live connection on fd, whatever its generation
+    fn getPtr(self: *ConnectionTable, fd: c_int) ?*Connection {
+        if (fd < 0 or @as(usize, @intCast(fd)) >= self.slots.len) return null;
+        const conn = &self.slots[@as(usize, @intCast(fd))];
+        return if (conn.in_use) conn else null;
     }
 
-    pub fn getAllEncryptedOutput(self: *TlsConnectionStub, buf: []u8) !usize {
-        _ = self;
-        _ = buf;
-        return 0; // TLS is disabled
+    // Live connection on fd, or null if the completion belongs to a previous owner of the fd
+    fn get(self: *ConnectionTable, fd: c_int, generation: u24) ?*Connection {
+        const conn = self.getPtr(fd) orelse return null;
+        return if (conn.generation == generation) conn else null;
     }
 
-    pub fn read(self: *TlsConnectionStub, buf: []u8) !usize {
-        _ = self;
-        _ = buf;
-        return 0; // TLS is disabled
+    fn release(self: *ConnectionTable, fd: c_int) void {
+        const conn = self.getPtr(fd) orelse return;
+        // Unlink from the timer wheel before open() can overwrite the node
+        conn.timer.cancel();
+        conn.in_use = false;
+        conn.generation +%= 1;
+        self.live -= 1;
     }
 
-    pub fn write(self: *TlsConnectionStub, buf: []const u8) !void {
-        _ = self;
-        _ = buf;
-        return {}; // TLS is disabled
+    // Every slot that has ever been opened (check in_use)
+    fn opened(self: *ConnectionTable) []Connection {
+        return self.slots[0..self.high_water];
     }
 };
 
-// Connection state
-const Connection = struct {
-    fd: c_int,
-    read_buffer: ?[]u8 = null,
-    write_buffer: ?[]u8 = null,
-    in_use: bool = false,
-    // TLS support (disabled for PicoTLS migration)
-    tls_conn: ?*anyopaque = null, // Placeholder
-    is_tls: bool = false,
-    // HTTP/2 support
-    http2_conn: ?*http2.Http2Connection = null,
-    protocol: protocol.Protocol = .http1_1,
-    // Connection tracking for limits/timeouts
-    created_at: i64 = 0,
-    last_active: i64 = 0,
-    request_count: u32 = 0,
+// Plain fds are process-wide, so every worker's table has to cover the whole fd range
+fn connectionTableCapacity(fixed_files: bool) usize {
+    if (fixed_files) return REGISTERED_FILE_TABLE_SIZE;
+    const limit = std.posix.getrlimit(.NOFILE) catch return 65536;
+    return @intCast(@min(limit.cur, MAX_CONNECTION_SLOTS));
+}
 
-    // Connection limits
-    const MAX_REQUESTS_PER_CONN: u32 = 1000;
-    const IDLE_TIMEOUT_NS: i64 = 30 * std.time.ns_per_s; // 30 seconds
-    const MAX_CONNECTION_AGE_NS: i64 = 300 * std.time.ns_per_s; // 5 minutes
+// Per-worker ring plus the registered-I/O features that were successfully enabled.
+// With fixed_files, connection "fds" are slots in the ring's sparse file table and
+// must be shut down/closed through the ring. The legacy one-shot TLS read path
+// still assumes raw fds.
+//
+// SQEs are only queued here; the event loop submits them all with one
+// io_uring_submit_and_wait per iteration.
+const WorkerIo = struct {
+    ring: *c.struct_io_uring,
+    fixed_files: bool = false,
+    fixed_buffers: bool = false,
+    // Syscalls issued by this worker (io_uring_enter plus direct socket calls)
+    syscalls: u64 = 0,
+    // TLS connections by the record mode they ended up with
+    tls_modes: std.EnumArray(tls.RecordMode, u64) = .initFill(0),
+    // Completed TLS handshakes, by whether they resumed a session
+    tls_full_handshakes: u64 = 0,
+    tls_resumed_handshakes: u64 = 0,
+
+    // Next free SQE; if the SQ ring is full, flush what's queued and retry
+    fn getSqe(self: *WorkerIo) ?*c.struct_io_uring_sqe {
+        if (blitz_io_uring_get_sqe(self.ring)) |sqe| return sqe;
+        _ = c.io_uring_submit(self.ring);
+        self.syscalls += 1;
+        return blitz_io_uring_get_sqe(self.ring);
+    }
 };
 
 // Helper function for explicit connection cleanup
 fn closeConnection(
+    io: *WorkerIo,
     fd: c_int,
-    connections: *std.AutoHashMap(c_int, Connection),
+    connections: *ConnectionTable,
     buffer_pool: *allocator.BufferPool,
-    backing_allocator: std.mem.Allocator,
+    conn_allocator: std.mem.Allocator,
     reason: []const u8,
 ) void {
     if (connections.getPtr(fd)) |conn| {
@@ -135,64 +255,85 @@ fn closeConnection(
         if (conn.read_buffer) |buf| {
             buffer_pool.releaseRead(buf);
             conn.read_buffer = null;
+            conn.pending_len = 0;
         }
         if (conn.write_buffer) |buf| {
             buffer_pool.releaseWrite(buf);
             conn.write_buffer = null;
         }
+        if (conn.queued_write) |buf| {
+            buffer_pool.releaseWrite(buf);
+            conn.queued_write = null;
+            conn.queued_len = 0;
+        }
 
-        // Clean up TLS connection if present
-        if (conn.tls_conn) |tls_conn_opaque| {
-            // Cast opaque pointer to TlsConnectionStub for cleanup
-            const tls_conn = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque)));
-            tls_conn.deinit();
-            conn.tls_conn = null;
+        if (conn.tls_session) |session| {
+            // An offloaded handshake step still uses the session: its completion frees it
+            if (conn.handshake_job == null) {
+                session.deinit();
+                conn_allocator.destroy(session);
+            }
+            conn.handshake_job = null;
+            conn.tls_session = null;
         }
 
-        // Clean up HTTP/2 connection if present
-        if (conn.http2_conn) |http2_conn| {
-            http2_conn.deinit();
-            backing_allocator.destroy(http2_conn);
-            conn.http2_conn = null;
+        // Splices still in flight hold their own references to the file and pipe
+        if (conn.file_send) |send| {
+            worker_files.?.release(send.entry);
+            conn.file_send = null;
+        }
+        if (conn.splice_pipe[0] >= 0) {
+            _ = c.close(conn.splice_pipe[0]);
+            _ = c.close(conn.splice_pipe[1]);
+            conn.splice_pipe = .{ -1, -1 };
         }
 
-        // Explicitly reset all fields
-        conn.fd = -1;
-        conn.in_use = false;
-        conn.is_tls = false;
-        conn.protocol = .http1_1;
-        conn.created_at = 0;
-        conn.last_active = 0;
-        conn.request_count = 0;
-
-        // Remove from HashMap
-        _ = connections.remove(fd);
+        // A multishot recv still references the socket: shut it down so the recv
+        // terminates, and finish the close when its final CQE arrives
+        if (conn.recv_armed) {
+            if (!conn.closing) {
+                conn.closing = true;
+                shutdownSocket(io, fd);
+                std.log.debug("Closing connection {}: {s}", .{ fd, reason });
+            }
+            return;
+        }
+
+        // Free the slot before the fd can be reused; later CQEs for it are now stale
+        connections.release(fd);
     }
 
     // Close socket
-    _ = c.close(fd);
+    closeSocket(io, fd);
     std.log.debug("Closed connection {}: {s}", .{ fd, reason });
 }
 
 // Connection state stored in user_data
-// We encode: fd in lower 32 bits, operation type in upper bits
-const OpType = enum(u32) {
+// We encode: fd in bits 0-31, connection generation in bits 32-55, operation type in bits 56-63
+const OpType = enum(u8) {
     accept = 0,
-    read = 1,
     write = 2,
-    // tls_handshake = 3, // TLS handshake in progress (disabled for now)
+    recv = 3, // Multishot recv into a provided buffer
+    close = 4, // Shutdown/close of a fixed-file slot (completion ignored)
+    timer = 5, // Timer wheel tick
+    splice_in = 6, // Static file -> connection pipe
+    splice_out = 7, // Connection pipe -> socket
+    inotify = 8, // Read of the worker's static file cache invalidations
+    tls_handshake = 9, // Read of the worker's handshake offload eventfd
 };
 
-fn encodeUserData(fd: c_int, op: OpType) u64 {
-    const op_val: u64 = @intCast(@intFromEnum(op));
+fn encodeUserData(fd: c_int, generation: u24, op: OpType) u64 {
+    const op_val: u64 = @intFromEnum(op);
+    const gen_val: u64 = generation;
     const fd_val: u64 = @intCast(@as(u32, @bitCast(@as(c_int, fd))));
-    return (op_val << 32) | fd_val;
+    return (op_val << 56) | (gen_val << 32) | fd_val;
 }
 
-fn decodeUserData(user_data: u64) struct { fd: c_int, op: OpType } {
+fn decodeUserData(user_data: u64) struct { fd: c_int, generation: u24, op: OpType } {
     const fd = @as(c_int, @bitCast(@as(u32, @truncate(user_data))));
-    const op = @as(OpType, @enumFromInt(@as(u32, @truncate(user_data >> 32))));
-    return .{ .fd = fd, .op = op };
+    const generation: u24 = @truncate(user_data >> 32);
+    const op = @as(OpType, @enumFromInt(@as(u8, @truncate(user_data >> 56))));
+    return .{ .fd = fd, .generation = generation, .op = op };
 }
 
 // Zig 0.12.0 compatibility: io_uring_sqe_set_data expects ?*anyopaque
@@ -200,22 +341,694 @@ fn setSqeData(sqe: *c.struct_io_uring_sqe, user_data: u64) void {
     c.io_uring_sqe_set_data(sqe, @as(?*anyopaque, @ptrFromInt(user_data)));
 }
 
+fn timerTick(ns: i64) u64 {
+    return @intCast(@divFloor(ns, TIMER_TICK_NS));
+}
+
+// The worker's only timeout: fires every tick to advance the timer wheel
+fn armTimer(io: *WorkerIo, ts: *c.struct___kernel_timespec) bool {
+    const sqe = io.getSqe() orelse return false;
+    c.io_uring_prep_timeout(sqe, ts, 0, 0);
+    setSqeData(sqe, encodeUserData(0, 0, .timer));
+    return true;
+}
+
+// Multishot accept: one SQE keeps producing a CQE per new connection.
+// With fixed files the socket goes straight into a free slot of the sparse file table.
+fn armAccept(io: *WorkerIo, server_fd: c_int) bool {
+    const sqe = io.getSqe() orelse return false;
+    if (io.fixed_files) {
+        c.io_uring_prep_multishot_accept_direct(sqe, server_fd, null, null, c.SOCK_NONBLOCK);
+    } else {
+        c.io_uring_prep_multishot_accept(sqe, server_fd, null, null, c.SOCK_NONBLOCK);
+    }
+    setSqeData(sqe, encodeUserData(server_fd, 0, .accept));
+    return true;
+}
+
+// Multishot recv: the kernel picks a provided buffer only when data arrives
+fn armRecv(io: *WorkerIo, conn: *const Connection) bool {
+    const sqe = io.getSqe() orelse return false;
+    blitz_prep_recv_multishot(sqe, conn.fd, RECV_BUFFER_GROUP);
+    if (io.fixed_files) blitz_sqe_set_fixed_file(sqe);
+    setSqeData(sqe, encodeUserData(conn.fd, conn.generation, .recv));
+    return true;
+}
+
+// Write a response held in a write-pool buffer (registered as WRITE_BUFFER_INDEX in fixed mode)
+fn submitWrite(io: *WorkerIo, conn: *const Connection, data: []const u8) bool {
+    const sqe = io.getSqe() orelse return false;
+    if (io.fixed_buffers) {
+        c.io_uring_prep_write_fixed(sqe, conn.fd, data.ptr, @as(c_uint, @intCast(data.len)), 0, WRITE_BUFFER_INDEX);
+    } else {
+        c.io_uring_prep_write(sqe, conn.fd, data.ptr, @as(c_uint, @intCast(data.len)), 0);
+    }
+    if (io.fixed_files) blitz_sqe_set_fixed_file(sqe);
+    setSqeData(sqe, encodeUserData(conn.fd, conn.generation, .write));
+    return true;
+}
+
+// Fixed-file slots can't be touched with shutdown(2)/close(2); go through the ring instead
+fn shutdownSocket(io: *WorkerIo, fd: c_int) void {
+    if (!io.fixed_files) {
+        _ = c.shutdown(fd, c.SHUT_RDWR);
+        io.syscalls += 1;
+        return;
+    }
+    const sqe = io.getSqe() orelse return;
+    c.io_uring_prep_shutdown(sqe, fd, c.SHUT_RDWR);
+    blitz_sqe_set_fixed_file(sqe);
+    setSqeData(sqe, encodeUserData(fd, 0, .close));
+}
+
+fn closeSocket(io: *WorkerIo, fd: c_int) void {
+    if (!io.fixed_files) {
+        _ = c.close(fd);
+        io.syscalls += 1;
+        return;
+    }
+    const sqe = io.getSqe() orelse return;
+    c.io_uring_prep_close_direct(sqe, @intCast(fd));
+    setSqeData(sqe, encodeUserData(fd, 0, .close));
+}
+
+// Move the next part of conn.file_send to the socket. With the pipe empty, a
+// file -> pipe splice is linked to a pipe -> socket one so a chunk costs one
+// round trip; otherwise only the pipe is drained. io_uring has no sendfile op,
+// so this is what sendfile(2) does internally.
+fn submitSplice(io: *WorkerIo, conn: *Connection) bool {
+    const send = &conn.file_send.?;
+    if (send.in_pipe > 0) {
+        const out_sqe = io.getSqe() orelse return false;
+        blitz_prep_splice(out_sqe, conn.splice_pipe[0], -1, conn.fd, @intCast(send.in_pipe), 0);
+        if (io.fixed_files) blitz_sqe_set_fixed_file(out_sqe);
+        setSqeData(out_sqe, encodeUserData(conn.fd, conn.generation, .splice_out));
+        return true;
+    }
+
+    if (conn.splice_pipe[0] < 0) {
+        const fds = std.posix.pipe2(.{ .CLOEXEC = true }) catch return false;
+        conn.splice_pipe = fds;
+    }
+    const chunk: c_uint = @intCast(@min(send.end - send.offset, SPLICE_CHUNK));
+    const in_sqe = io.getSqe() orelse return false;
+    blitz_prep_splice(in_sqe, send.entry.fd, @intCast(send.offset), conn.splice_pipe[1], chunk, 0);
+    setSqeData(in_sqe, encodeUserData(conn.fd, conn.generation, .splice_in));
+
+    // Only link if the second SQE doesn't force a submit that would split the chain
+    send.linked = false;
+    const out_sqe = blitz_io_uring_get_sqe(io.ring) orelse return true;
+    blitz_sqe_set_link(in_sqe);
+    blitz_prep_splice(out_sqe, conn.splice_pipe[0], -1, conn.fd, chunk, 0);
+    if (io.fixed_files) blitz_sqe_set_fixed_file(out_sqe);
+    setSqeData(out_sqe, encodeUserData(conn.fd, conn.generation, .splice_out));
+    send.linked = true;
+    return true;
+}
+
+// What a splice completion leaves the event loop to do
+const SpliceProgress = union(enum) {
+    in_flight,
+    // The whole body has reached the socket
+    complete,
+    // Close the connection, with this reason
+    failed: []const u8,
+};
+
+fn spliceInDone(io: *WorkerIo, conn: *Connection, res: i32) SpliceProgress {
+    const send = &conn.file_send.?;
+    // The file shrank under us: the promised Content-Length can't be met
+    if (res == 0) return .{ .failed = "static file truncated" };
+    send.offset += @intCast(res);
+    send.in_pipe += @intCast(res);
+    // A linked pipe -> socket splice is already on its way
+    if (send.linked) return .in_flight;
+    return if (submitSplice(io, conn)) .in_flight else .{ .failed = "no SQE for splice" };
+}
+
+fn spliceOutDone(io: *WorkerIo, conn: *Connection, res: i32) SpliceProgress {
+    const send = &conn.file_send.?;
+    if (res == -c.ECANCELED) {
+        // The linked file -> pipe splice came up short: an unaligned offset needs
+        // one pipe page more than a full chunk has, or the read hit EOF. Its
+        // completion has been counted already; drain what it moved and go on.
+        send.linked = false;
+        return if (submitSplice(io, conn)) .in_flight else .{ .failed = "no SQE for splice" };
+    }
+    if (res < 0) return .{ .failed = "I/O error" };
+    if (res == 0) return .{ .failed = "splice made no progress" };
+    send.in_pipe -= @intCast(res);
+    conn.last_active = @intCast(std.time.nanoTimestamp());
+
+    if (send.in_pipe > 0 or send.offset < send.end) {
+        return if (submitSplice(io, conn)) .in_flight else .{ .failed = "no SQE for splice" };
+    }
+    return .complete;
+}
+
+// Wait for the offload pool to post finished handshake steps
+fn armHandshakeEvents(io: *WorkerIo, offload: *HandshakeOffload) bool {
+    const sqe = io.getSqe() orelse return false;
+    c.io_uring_prep_read(sqe, offload.completions.event_fd, &offload.event_count, @sizeOf(u64), 0);
+    setSqeData(sqe, encodeUserData(0, 0, .tls_handshake));
+    return true;
+}
+
+fn armInotify(io: *WorkerIo, inotify_fd: c_int, buf: []u8) bool {
+    const sqe = io.getSqe() orelse return false;
+    c.io_uring_prep_read(sqe, inotify_fd, buf.ptr, @intCast(buf.len), 0);
+    setSqeData(sqe, encodeUserData(0, 0, .inotify));
+    return true;
+}
+
+// Opt-in registered I/O: a sparse fixed-file table for direct accept, and the write
+// pool registered as one fixed buffer. Each feature falls back on its own if the
+// kernel refuses it (old kernel, RLIMIT_MEMLOCK too low for the buffer pin).
+// Pinning faults in the whole write region, so it gives up the arena's lazy commit.
+fn enableRegisteredIo(io: *WorkerIo, buffer_pool: *allocator.BufferPool, worker_id: u32) void {
+    const files_ret = c.io_uring_register_files_sparse(io.ring, REGISTERED_FILE_TABLE_SIZE);
+    if (files_ret < 0) {
+        std.log.warn("Worker {}: io_uring_register_files_sparse failed ({d}), using plain fds", .{ worker_id, files_ret });
+    } else {
+        io.fixed_files = true;
+    }
+
+    const region = buffer_pool.writeRegion();
+    var iov = c.struct_iovec{ .iov_base = region.ptr, .iov_len = region.len };
+    const bufs_ret = c.io_uring_register_buffers(io.ring, &iov, 1);
+    if (bufs_ret < 0) {
+        std.log.warn("Worker {}: io_uring_register_buffers failed ({d}), using unregistered writes (check RLIMIT_MEMLOCK)", .{ worker_id, bufs_ret });
+    } else {
+        io.fixed_buffers = true;
+    }
+
+    std.log.info("Worker {}: registered I/O files={} buffers={}", .{ worker_id, io.fixed_files, io.fixed_buffers });
+}
+
+// Buffer ID the kernel selected for a recv CQE
+fn cqeBufferId(cqe_flags: c_uint) u16 {
+    return @intCast(cqe_flags >> @intCast(c.IORING_CQE_BUFFER_SHIFT));
+}
+
+// Provided-buffer ring registered with the kernel for multishot recv.
+// Buffers come from the read pool at startup; each one goes back to the ring
+// as soon as its recv CQE has been handled.
+const RecvBufferRing = struct {
+    br: *c.struct_io_uring_buf_ring,
+    buffers: [][]u8,
+    mask: c_int,
+
+    fn init(
+        ring_ptr: *c.struct_io_uring,
+        buffer_pool: *allocator.BufferPool,
+        backing_allocator: std.mem.Allocator,
+        entries: usize,
+    ) !RecvBufferRing {
+        const buffers = try backing_allocator.alloc([]u8, entries);
+        errdefer backing_allocator.free(buffers);
+
+        var acquired: usize = 0;
+        errdefer {
+            for (buffers[0..acquired]) |buf| buffer_pool.releaseRead(buf);
+        }
+        while (acquired < entries) : (acquired += 1) {
+            buffers[acquired] = buffer_pool.acquireRead() orelse return error.BufferPoolExhausted;
+        }
+
+        var ret: c_int = 0;
+        const br_opt: ?*c.struct_io_uring_buf_ring = c.io_uring_setup_buf_ring(ring_ptr, @intCast(entries), RECV_BUFFER_GROUP, 0, &ret);
+        const br = br_opt orelse {
+            std.log.err("io_uring_setup_buf_ring failed: {d}", .{ret});
+            return error.BufferRingSetupFailed;
+        };
+
+        const mask: c_int = @intCast(entries - 1);
+        for (buffers, 0..) |buf, bid| {
+            blitz_buf_ring_add(br, buf.ptr, @intCast(buf.len), @intCast(bid), mask, @intCast(bid));
+        }
+        blitz_buf_ring_advance(br, @intCast(entries));
+
+        return RecvBufferRing{
+            .br = br,
+            .buffers = buffers,
+            .mask = mask,
+        };
+    }
+
+    fn deinit(self: *RecvBufferRing, ring_ptr: *c.struct_io_uring, buffer_pool: *allocator.BufferPool, backing_allocator: std.mem.Allocator) void {
+        _ = c.io_uring_free_buf_ring(ring_ptr, self.br, @intCast(self.buffers.len), RECV_BUFFER_GROUP);
+        for (self.buffers) |buf| buffer_pool.releaseRead(buf);
+        backing_allocator.free(self.buffers);
+    }
+
+    fn get(self: *const RecvBufferRing, bid: u16) []u8 {
+        return self.buffers[bid];
+    }
+
+    // Hand a buffer back to the kernel
+    fn recycle(self: *RecvBufferRing, bid: u16) void {
+        const buf = self.buffers[bid];
+        blitz_buf_ring_add(self.br, buf.ptr, @intCast(buf.len), bid, self.mask, 0);
+        blitz_buf_ring_advance(self.br, 1);
+    }
+};
+
+fn copyResponse(write_buf: []u8, response: []const u8) ?usize {
+    if (write_buf.len < response.len) return null;
+    @memcpy(write_buf[0..response.len], response);
+    return response.len;
+}
+
+// What a matched route answers with
+const Http1Handler = union(enum) {
+    // Complete pre-rendered response
+    static: []const u8,
+    // Echo the request path back as text/plain
+    echo,
+    // Files below this directory; the route's wildcard capture is the relative path
+    files: []const u8,
+    // Proxy and plugin routes have no upstream or plugin host in echo mode
+    unavailable,
+};
+const Http1Router = router.Router(Http1Handler);
+
+// /hello is optimized for benchmarking (fastest path)
+const builtin_routes = Http1Router.comptimeTrie(&.{
+    .{ .pattern = "/hello", .handler = .{ .static = http.CommonResponses.HELLO } },
+    .{ .pattern = "/", .handler = .{ .static = http.CommonResponses.OK } },
+    .{ .pattern = "/health", .handler = .{ .static = http.CommonResponses.OK } },
+    .{ .pattern = "/echo*", .handler = .echo },
+});
+
+// Trie for EchoServerOptions.routes, compiled once in runEchoServer and only read by workers
+var configured_routes: ?Http1Router = null;
+
+// Open-file cache of the worker running on this thread, set up in runWorker
+threadlocal var worker_files: ?*static_files.FileCache = null;
+
+// Shared handshake offload pool, started in runEchoServer when handshake threads are configured
+var tls_handshake_pool: ?*handshake_pool.HandshakePool = null;
+
+// A handshake step running on the offload pool. If the connection closes before
+// it comes back, the job keeps the session and the worker frees it on completion.
+const HandshakeJob = struct {
+    job: handshake_pool.Job,
+    session: *tls.TlsConnection,
+    fd: c_int,
+    generation: u24,
+    result: tls.TlsError!tls.TlsState = .handshake,
+
+    fn run(job: *handshake_pool.Job) void {
+        const self: *HandshakeJob = @fieldParentPtr("job", job);
+        self.result = self.session.handshake();
+    }
+};
+
+// The worker's end of the offload pool
+const HandshakeOffload = struct {
+    pool: *handshake_pool.HandshakePool,
+    completions: handshake_pool.Completions,
+    // The worker's connection slabs: jobs are only created and freed on the worker
+    allocator: std.mem.Allocator,
+    // eventfd counter, read through the ring
+    event_count: u64 = 0,
+};
+
+threadlocal var worker_handshakes: ?*HandshakeOffload = null;
+
+const SERVICE_UNAVAILABLE = "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
+
+fn compileRoutes(route_allocator: std.mem.Allocator, routes: []const config.Route) !Http1Router {
+    const table = try route_allocator.alloc(Http1Router.Route, routes.len);
+    for (routes, table) |route, *entry| {
+        entry.* = .{
+            .pattern = route.pattern,
+            .handler = switch (route.handler) {
+                .static => |static| .{ .static = try std.fmt.allocPrint(
+                    route_allocator,
+                    "HTTP/1.1 {d} {s}\r\nContent-Type: text/plain\r\nContent-Length: {d}\r\nConnection: keep-alive\r\n\r\n{s}",
+                    .{ static.status, http.reasonPhrase(static.status), static.body.len, static.body },
+                ) },
+                .files => |root| .{ .files = root },
+                .proxy, .plugin => .unavailable,
+            },
+        };
+    }
+    return Http1Router.compile(route_allocator, table);
+}
+
+const Http1Error = error{ MalformedRequest, RequestTooLarge, ResponseTooLarge, WriteQueueFull, NoReadBuffer, NoWriteBuffer, MaxRequests };
+
+fn http1ErrorReason(err: Http1Error) []const u8 {
+    return switch (err) {
+        error.MalformedRequest => "malformed request",
+        error.RequestTooLarge => "request too large",
+        error.ResponseTooLarge => "response too large",
+        error.WriteQueueFull => "write queue full",
+        error.NoReadBuffer => "no read buffer",
+        error.NoWriteBuffer => "no write buffer",
+        error.MaxRequests => "max requests",
+    };
+}
+
+const Http1Progress = struct {
+    consumed: usize,
+    // Stopped because the queued write buffer is full, not because input ran out
+    blocked: bool,
+};
+
+// Answer each request head at the front of input, appending the responses to
+// conn.queued_write. Stops at an incomplete head or when a response doesn't fit.
+fn appendHttp1Responses(conn: *Connection, buffer_pool: *allocator.BufferPool, input: []const u8, served: *u32) Http1Error!Http1Progress {
+    // Later responses have to wait until the file body before them has been spliced
+    if (conn.file_send != null) return .{ .consumed = 0, .blocked = true };
+    // Filled in place by each head; Request is too large to copy around per request
+    var request: http.Request = undefined;
+    var pos: usize = 0;
+    while (true) {
+        const step = conn.request_parser.feed(input[pos..], &request) catch |err| return switch (err) {
+            error.RequestTooLarge => error.RequestTooLarge,
+            else => error.MalformedRequest,
+        };
+        switch (step.event) {
+            .need_more => return .{ .consumed = pos + step.consumed, .blocked = false },
+            .head => {
+                // Past the limit nothing more is answered. Responses already queued or
+                // being written go out first; the write completion that drains them
+                // comes back here and closes the connection.
+                if (conn.request_count >= Connection.MAX_REQUESTS_PER_CONN) {
+                    if (conn.queued_len == 0 and conn.write_buffer == null) return error.MaxRequests;
+                    conn.request_parser.reset();
+                    return .{ .consumed = pos, .blocked = true };
+                }
+                const queued = conn.queued_write orelse blk: {
+                    const buf = buffer_pool.acquireWrite() orelse return error.NoWriteBuffer;
+                    conn.queued_write = buf;
+                    conn.queued_len = 0;
+                    break :blk buf;
+                };
+                const response_len = buildHttp1Response(conn, &request, queued[conn.queued_len..]) orelse {
+                    // A response that doesn't fit in an empty buffer never will
+                    if (conn.queued_len == 0) return error.ResponseTooLarge;
+                    // Leave the head unconsumed and parse it again once the queue drains
+                    conn.request_parser.reset();
+                    return .{ .consumed = pos, .blocked = true };
+                };
+                conn.queued_len += response_len;
+                conn.request_count += 1;
+            },
+            // None of the local routes read a body: let it stream past without buffering
+            .body => {},
+            .done => {
+                served.* += 1;
+                if (conn.file_send != null) return .{ .consumed = pos + step.consumed, .blocked = true };
+            },
+        }
+        pos += step.consumed;
+    }
+}
+
+// Serve the connection's pending bytes followed by data. Pipelined requests are
+// answered back to back into one queued buffer, so they go out in a single write;
+// bytes the request parser couldn't consume yet (part of a head or chunk-size line,
+// or heads still waiting for queue space) are kept in conn.read_buffer and resumed
+// on the next recv or write completion. Bodies are never held back.
+// Returns the number of requests answered.
+fn serveHttp1(conn: *Connection, buffer_pool: *allocator.BufferPool, data: []const u8) Http1Error!u32 {
+    var served: u32 = 0;
+    var input = data;
+
+    // Common case: nothing carried over, parse straight out of the recv buffer
+    if (conn.pending_len == 0) {
+        const progress = try appendHttp1Responses(conn, buffer_pool, input, &served);
+        input = input[progress.consumed..];
+        if (input.len == 0) return served;
+    }
+
+    const pending = conn.read_buffer orelse blk: {
+        const buf = buffer_pool.acquireRead() orelse return error.NoReadBuffer;
+        conn.read_buffer = buf;
+        break :blk buf;
+    };
+    while (true) {
+        const n = @min(pending.len - conn.pending_len, input.len);
+        @memcpy(pending[conn.pending_len..][0..n], input[0..n]);
+        conn.pending_len += n;
+        input = input[n..];
+
+        const progress = try appendHttp1Responses(conn, buffer_pool, pending[0..conn.pending_len], &served);
+        if (progress.consumed > 0) {
+            std.mem.copyForwards(u8, pending, pending[progress.consumed..conn.pending_len]);
+            conn.pending_len -= progress.consumed;
+        }
+        if (input.len == 0) break;
+        // Buffer full and nothing could be consumed
+        if (progress.consumed == 0) return if (progress.blocked) error.WriteQueueFull else error.RequestTooLarge;
+    }
+
+    if (conn.pending_len == 0) {
+        buffer_pool.releaseRead(pending);
+        conn.read_buffer = null;
+    }
+    return served;
+}
+
+// Start writing the queued responses unless a write is already in flight (its completion flushes them)
+fn flushQueuedWrite(io: *WorkerIo, conn: *Connection, buffer_pool: *allocator.BufferPool) bool {
+    if (conn.write_buffer != null) return true;
+    if (conn.tls_session) |session| {
+        // The offload pool has the session; the step's completion flushes
+        if (conn.handshake_job != null) return true;
+        if (!session.kernelTx()) return flushTlsRecords(io, conn, session, buffer_pool);
+    }
+    const queued = conn.queued_write orelse return true;
+    if (!submitWrite(io, conn, queued[0..conn.queued_len])) return false;
+    conn.write_buffer = queued;
+    conn.queued_write = null;
+    conn.queued_len = 0;
+    return true;
+}
+
+const TlsServeError = Http1Error || tls.TlsError;
+
+fn tlsErrorReason(err: TlsServeError) []const u8 {
+    return switch (err) {
+        error.HandshakeFailed => "TLS handshake failed",
+        error.ProtocolError => "TLS protocol error",
+        error.ConnectionClosed => "TLS close_notify",
+        error.ContextInitFailed, error.ConnectionInitFailed => "TLS setup failed",
+        else => |http1_err| http1ErrorReason(@errorCast(http1_err)),
+    };
+}
+
+// Shared TLS context for the listener, set up in runEchoServer when a certificate is configured
+var tls_context: ?tls.TlsContext = null;
+
+// Decrypt what a recv delivered and serve the requests in it. Handshake records
+// are answered through the same queued write path as responses.
+fn serveTls(io: *WorkerIo, conn: *Connection, session: *tls.TlsConnection, buffer_pool: *allocator.BufferPool, data: []const u8) TlsServeError!u32 {
+    // With kTLS RX the kernel has already decrypted it
+    if (session.kernelRx()) return serveHttp1(conn, buffer_pool, data);
+    if (conn.handshake_job != null) return stashHandshakeInput(conn, buffer_pool, data);
+
+    try session.feed(data);
+    return advanceTls(io, conn, session, buffer_pool);
+}
+
+// Ciphertext that arrives while a handshake step is offloaded waits in the read
+// buffer, which holds no plaintext before the handshake is done
+fn stashHandshakeInput(conn: *Connection, buffer_pool: *allocator.BufferPool, data: []const u8) Http1Error!u32 {
+    if (data.len == 0) return 0;
+    if (conn.read_buffer == null) conn.read_buffer = buffer_pool.acquireRead() orelse return error.NoReadBuffer;
+    const buf = conn.read_buffer.?;
+    if (buf.len - conn.pending_len < data.len) return error.RequestTooLarge;
+    @memcpy(buf[conn.pending_len..][0..data.len], data);
+    conn.pending_len += data.len;
+    return 0;
+}
+
+// A handshake step came back from the offload pool: feed what arrived meanwhile and carry on
+fn resumeHandshake(io: *WorkerIo, conn: *Connection, session: *tls.TlsConnection, buffer_pool: *allocator.BufferPool, result: tls.TlsError!tls.TlsState) TlsServeError!u32 {
+    const state = try result;
+    if (state == .established) handshakeDone(io, conn, session);
+    const stashed = conn.read_buffer orelse {
+        if (state == .handshake) return 0;
+        return advanceTls(io, conn, session, buffer_pool);
+    };
+    const stashed_len = conn.pending_len;
+    conn.read_buffer = null;
+    conn.pending_len = 0;
+    defer buffer_pool.releaseRead(stashed);
+    try session.feed(stashed[0..stashed_len]);
+    return advanceTls(io, conn, session, buffer_pool);
+}
+
+// Run the handshake with what has been fed, or hand the step to the offload
+// pool; once established, serve every complete record
+fn advanceTls(io: *WorkerIo, conn: *Connection, session: *tls.TlsConnection, buffer_pool: *allocator.BufferPool) TlsServeError!u32 {
+    if (session.state == .handshake) {
+        if (worker_handshakes) |offload| {
+            const job = offload.allocator.create(HandshakeJob) catch return error.HandshakeFailed;
+            job.* = .{
+                .job = .{ .run = HandshakeJob.run, .completions = &offload.completions },
+                .session = session,
+                .fd = conn.fd,
+                .generation = conn.generation,
+            };
+            conn.handshake_job = job;
+            offload.pool.submit(&job.job);
+            return 0;
+        }
+        if (try session.handshake() == .handshake) return 0;
+        handshakeDone(io, conn, session);
+    }
+
+    var served: u32 = 0;
+    var plaintext: [BUFFER_SIZE]u8 = undefined;
+    while (true) {
+        const n = try session.read(&plaintext);
+        if (n == 0) break;
+        served += try serveHttp1(conn, buffer_pool, plaintext[0..n]);
+    }
+    return served;
+}
+
+// Userspace records: encrypt as much queued plaintext as fits in one write
+// buffer once framed, behind any handshake records OpenSSL still has to send.
+// The rest stays queued for the next write completion.
+fn flushTlsRecords(io: *WorkerIo, conn: *Connection, session: *tls.TlsConnection, buffer_pool: *allocator.BufferPool) bool {
+    if (conn.queued_write) |plaintext| {
+        const budget = BUFFER_SIZE -| (session.pendingOutput() + tls.RECORD_OVERHEAD);
+        const n = @min(conn.queued_len, budget);
+        session.write(plaintext[0..n]) catch return false;
+        std.mem.copyForwards(u8, plaintext, plaintext[n..conn.queued_len]);
+        conn.queued_len -= n;
+        if (conn.queued_len == 0) {
+            buffer_pool.releaseWrite(plaintext);
+            conn.queued_write = null;
+        }
+    }
+    if (session.pendingOutput() == 0) return true;
+
+    const records = buffer_pool.acquireWrite() orelse return false;
+    const len = session.takeOutput(records);
+    if (!submitWrite(io, conn, records[0..len])) {
+        buffer_pool.releaseWrite(records);
+        return false;
+    }
+    conn.write_buffer = records;
+    return true;
+}
+
+// Called whenever the connection has no write in flight
+fn ktlsReady(conn: *const Connection, session: *tls.TlsConnection) bool {
+    return conn.handshake_job == null and session.ktls_wanted and session.state == .established and
+        conn.write_buffer == null and session.pendingOutput() == 0;
+}
+
+// Every record OpenSSL produced is on the wire: move TX into the kernel, then stop
+// the recv so RX can follow once the bytes already received have been decrypted.
+// Returns why the connection has to close, or null.
+fn startKtls(io: *WorkerIo, conn: *Connection, session: *tls.TlsConnection) ?[]const u8 {
+    session.ktls_wanted = false;
+    const installed = session.installTx(conn.fd) catch return "kTLS TX install failed";
+    if (!installed) {
+        settleTlsMode(io, conn, session);
+        return null;
+    }
+
+    const sqe = io.getSqe() orelse return "no SQE for recv cancel";
+    c.io_uring_prep_cancel64(sqe, encodeUserData(conn.fd, conn.generation, .recv), 0);
+    setSqeData(sqe, encodeUserData(conn.fd, 0, .close));
+    session.rx_install_pending = true;
+    return null;
+}
+
+// The recv stopped for a kTLS RX install and its data has been decrypted:
+// install RX if nothing is left buffered in userspace, then receive again.
+// Returns why the connection has to close, or null.
+fn resumeRecvAfterRxInstall(io: *WorkerIo, conn: *Connection, session: *tls.TlsConnection) ?[]const u8 {
+    _ = session.installRx(conn.fd) catch return "kTLS RX install failed";
+    settleTlsMode(io, conn, session);
+    if (!armRecv(io, conn)) return "no SQE for recv";
+    conn.recv_armed = true;
+    return null;
+}
+
+// Without kTLS the record mode is settled now; otherwise once the handshake records are out
+fn handshakeDone(io: *WorkerIo, conn: *const Connection, session: *tls.TlsConnection) void {
+    if (session.resumed()) io.tls_resumed_handshakes += 1 else io.tls_full_handshakes += 1;
+    if (!session.ktls_wanted) settleTlsMode(io, conn, session);
+}
+
+fn settleTlsMode(io: *WorkerIo, conn: *const Connection, session: *const tls.TlsConnection) void {
+    io.tls_modes.getPtr(session.mode).* += 1;
+    std.log.debug("Connection {}: TLS records in {s}", .{ conn.fd, session.mode.label() });
+}
+
+// Route a plaintext HTTP/1.1 request and write the response into write_buf.
+// Returns null if the response doesn't fit. A file response only writes its
+// head; the body range is left in conn.file_send for the splice path.
+fn buildHttp1Response(conn: *Connection, parsed_request: *const http.Request, write_buf: []u8) ?usize {
+    // Configured routes first, then the built-in ones; matching never allocates
+    const matched = (if (configured_routes) |*routes| routes.match(parsed_request.path) else null) orelse
+        builtin_routes.match(parsed_request.path) orelse
+        return copyResponse(write_buf, http.CommonResponses.NOT_FOUND);
+
+    switch (matched.handler) {
+        .static => |response| return copyResponse(write_buf, response),
+        .unavailable => return copyResponse(write_buf, SERVICE_UNAVAILABLE),
+        .files => |root| {
+            // Splicing needs the kernel to encrypt; userspace records would need the body in memory
+            if (conn.tls_session) |session| {
+                if (!session.kernelTx()) return copyResponse(write_buf, SERVICE_UNAVAILABLE);
+            }
+            const files = worker_files orelse return copyResponse(write_buf, SERVICE_UNAVAILABLE);
+            const rel_path = if (matched.param_count > 0) matched.params[matched.param_count - 1].value else "";
+            var builder = http_response.ResponseBuilder.init(write_buf);
+            const body = static_files.buildResponse(files, root, rel_path, parsed_request, &builder) catch |err| switch (err) {
+                error.BufferTooSmall => return null,
+                else => return copyResponse(write_buf, SERVICE_UNAVAILABLE),
+            };
+            if (body.entry) |entry| {
+                conn.file_send = .{ .entry = entry, .offset = body.offset, .end = body.offset + body.length };
+            }
+            return builder.len;
+        },
+        .echo => {
+            // Echo endpoint - return the path as plain text. The path lives in a recv
+            // buffer that is recycled after this CQE, so it is copied rather than scattered.
+            const echo_body = parsed_request.path;
+            var builder = http_response.ResponseBuilder.init(write_buf);
+            builder.status(200) catch return null;
+            builder.header("Content-Type", "text/plain") catch return null;
+            builder.contentLength(echo_body.len) catch return null;
+            builder.header("Connection", "keep-alive") catch return null;
+            builder.date() catch return null;
+            builder.end() catch return null;
+            builder.body(echo_body) catch return null;
+            return builder.len;
+        },
+    }
+}
+
 pub var ring: c.struct_io_uring = undefined;
+/// Setup mode the global ring ended up with after any fallback
+pub var ring_mode: config.RingConfig.Mode = .default;
+
+// Smallest per-worker buffer pool when BUFFER_POOL_SIZE is split across workers
+const MIN_WORKER_POOL_SIZE: usize = 1024;
 
-pub fn init() !void {
+pub fn init(options: config.RingConfig) !void {
     if (builtin.os.tag != .linux) {
         return error.UnsupportedPlatform;
     }
 
-    const ret = c.io_uring_queue_init(SQ_RING_SIZE, &ring, 0);
-    if (ret < 0) {
-        std.log.err("io_uring_queue_init failed: {d}", .{ret});
-        return error.IoUringInitFailed;
-    }
+    ring_mode = try initRing(&ring, options, 0);
 
     // Use std.debug.print for immediate unbuffered output
-    std.debug.print("io_uring initialized with {} SQ entries\n", .{SQ_RING_SIZE});
-    std.log.info("io_uring initialized with {} SQ entries", .{SQ_RING_SIZE});
+    std.debug.print("io_uring initialized with {} SQ entries ({s})\n", .{ options.sq_entries, @tagName(ring_mode) });
+    std.log.info("io_uring initialized with {} SQ entries ({s})", .{ options.sq_entries, @tagName(ring_mode) });
 }
 
 pub fn deinit() void {
@@ -224,7 +1037,51 @@ pub fn deinit() void {
     }
 }
 
-fn createServerSocket(port: u16) !c_int {
+// Set up a ring for the global instance or for a worker thread. Older kernels
+// reject newer setup flags (EINVAL) and unprivileged SQPOLL (EPERM), so each
+// failure steps down to a simpler mode. Returns the mode actually in use.
+pub fn initRing(r: *c.struct_io_uring, options: config.RingConfig, worker_id: u32) !config.RingConfig.Mode {
+    var mode = options.mode;
+    while (true) {
+        var params = std.mem.zeroes(c.struct_io_uring_params);
+        switch (mode) {
+            .default => {},
+            .sqpoll => {
+                params.flags |= c.IORING_SETUP_SQPOLL;
+                params.sq_thread_idle = options.sqpoll_idle_ms;
+                if (options.sqpoll_cpu) |base_cpu| {
+                    const cpu_count: usize = std.Thread.getCpuCount() catch 1;
+                    params.flags |= c.IORING_SETUP_SQ_AFF;
+                    params.sq_thread_cpu = @intCast((base_cpu + worker_id) % cpu_count);
+                }
+            },
+            .coop_taskrun => params.flags |= c.IORING_SETUP_COOP_TASKRUN,
+            // The ring must only be touched by the thread that creates it
+            .defer_taskrun => params.flags |= c.IORING_SETUP_SINGLE_ISSUER | c.IORING_SETUP_DEFER_TASKRUN,
+        }
+        if (options.cq_entries != 0) {
+            // CLAMP caps an oversized CQ at the kernel limit instead of failing
+            params.flags |= c.IORING_SETUP_CQSIZE | c.IORING_SETUP_CLAMP;
+            params.cq_entries = options.cq_entries;
+        }
+
+        const ret = c.io_uring_queue_init_params(options.sq_entries, r, &params);
+        if (ret == 0) return mode;
+
+        const fallback: config.RingConfig.Mode = switch (mode) {
+            .default => {
+                std.log.err("io_uring_queue_init failed: {d}", .{ret});
+                return error.IoUringInitFailed;
+            },
+            .defer_taskrun => .coop_taskrun,
+            .sqpoll, .coop_taskrun => .default,
+        };
+        std.log.warn("Worker {}: kernel rejected {s} ring ({d}), falling back to {s}", .{ worker_id, @tagName(mode), ret, @tagName(fallback) });
+        mode = fallback;
+    }
+}
+
+fn createServerSocket(port: u16, reuse_port: bool) !c_int {
     const sockfd = c.socket(c.AF_INET, c.SOCK_STREAM | c.SOCK_NONBLOCK, 0);
     if (sockfd < 0) {
         return error.SocketCreationFailed;
@@ -233,6 +1090,15 @@ fn createServerSocket(port: u16) !c_int {
     const opt: c_int = 1;
     _ = c.setsockopt(sockfd, c.SOL_SOCKET, c.SO_REUSEADDR, &opt, @sizeOf(c_int));
 
+    // SO_REUSEPORT lets every worker own a listener; the kernel spreads new connections across them
+    if (reuse_port) {
+        if (c.setsockopt(sockfd, c.SOL_SOCKET, c.SO_REUSEPORT, &opt, @sizeOf(c_int)) < 0) {
+            std.log.err("setsockopt(SO_REUSEPORT) failed on port {}", .{port});
+            _ = c.close(sockfd);
+            return error.ReusePortFailed;
+        }
+    }
+
     var addr: c.struct_sockaddr_in = std.mem.zeroes(c.struct_sockaddr_in);
     addr.sin_family = c.AF_INET;
     addr.sin_addr.s_addr = c.INADDR_ANY;
@@ -254,1058 +1120,680 @@ fn createServerSocket(port: u16) !c_int {
     return sockfd;
 }
 
-pub fn runEchoServer(port: u16) !void {
-    const server_fd = try createServerSocket(port);
-    defer _ = c.close(server_fd);
+/// Echo server settings (from CLI flags and config file)
+pub const EchoServerOptions = struct {
+    port: u16 = 8080,
+    /// Worker threads, each with its own ring, listener, buffer pool and connection table.
+    /// 0 = one worker per CPU.
+    workers: u32 = 1,
+    /// Direct-accept sockets into a registered file table and write from registered buffers
+    registered_io: bool = false,
+    /// Ring setup flags and sizes, applied to every worker ring
+    ring: config.RingConfig = .{},
+    /// Huge page and NUMA placement of each worker's buffer arena
+    arena: config.ArenaConfig = .{},
+    /// Configured routes, matched before the built-in ones
+    routes: []const config.Route = &.{},
+    /// Serve HTTPS instead of plaintext HTTP/1.1
+    tls: ?tls.TlsOptions = null,
+};
+
+pub fn runEchoServer(options: EchoServerOptions) !void {
+    const cpu_count: usize = std.Thread.getCpuCount() catch 1;
+    const worker_count: usize = if (options.workers == 0) cpu_count else options.workers;
 
     // Use std.debug.print for immediate unbuffered output
-    std.debug.print("Echo server listening on port {}\n", .{port});
+    std.debug.print("Echo server listening on port {} ({} worker(s))\n", .{ options.port, worker_count });
     std.debug.print("Target: 3M+ RPS\n", .{});
 
-    std.log.info("Echo server listening on port {}", .{port});
+    std.log.info("Echo server listening on port {} ({} worker(s))", .{ options.port, worker_count });
     std.log.info("Target: 3M+ RPS", .{});
 
+    // Compile configured routes before any worker starts; workers share the trie read-only
+    var route_arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer route_arena.deinit();
+    if (options.routes.len > 0) {
+        configured_routes = try compileRoutes(route_arena.allocator(), options.routes);
+        std.log.info("Compiled {} configured route(s)", .{options.routes.len});
+    }
+    defer configured_routes = null;
+
+    if (options.tls) |tls_options| {
+        tls_context = try tls.TlsContext.init(std.heap.page_allocator, tls_options);
+        if (tls_options.ktls and options.registered_io) {
+            std.log.warn("kTLS needs plain socket fds; with registered I/O every TLS record stays in userspace", .{});
+        }
+        std.log.info("TLS enabled with {s} (kTLS {s})", .{ tls_options.cert_file, if (tls_options.ktls) "on" else "off" });
+        if (tls_options.handshake_threads > 0) {
+            tls_handshake_pool = try handshake_pool.HandshakePool.init(std.heap.page_allocator, tls_options.handshake_threads);
+            std.log.info("TLS handshakes offloaded to {} thread(s)", .{tls_options.handshake_threads});
+        }
+    }
+    defer if (tls_handshake_pool) |pool| {
+        pool.deinit();
+        tls_handshake_pool = null;
+    };
+    defer if (tls_context) |*tls_ctx| {
+        tls_ctx.deinit();
+        tls_context = null;
+    };
+
+    if (worker_count == 1) {
+        // Single worker runs on the calling thread
+        const server_fd = try createServerSocket(options.port, false);
+        defer _ = c.close(server_fd);
+        return serveWorker(server_fd, 0, BUFFER_POOL_SIZE, options);
+    }
+
+    // Thread-per-core: split the buffer budget so total memory matches the single-worker setup
+    const pool_per_worker = @max(BUFFER_POOL_SIZE / worker_count, MIN_WORKER_POOL_SIZE);
+
+    const worker_allocator = std.heap.page_allocator;
+    const server_fds = try worker_allocator.alloc(c_int, worker_count);
+    defer worker_allocator.free(server_fds);
+    const threads = try worker_allocator.alloc(std.Thread, worker_count);
+    defer worker_allocator.free(threads);
+
+    // Bind every listener up front so a port conflict fails startup instead of one worker
+    var bound: usize = 0;
+    defer {
+        for (server_fds[0..bound]) |fd| {
+            _ = c.close(fd);
+        }
+    }
+    while (bound < worker_count) : (bound += 1) {
+        server_fds[bound] = try createServerSocket(options.port, true);
+    }
+
+    var spawned: usize = 0;
+    defer {
+        for (threads[0..spawned]) |thread| thread.join();
+    }
+    while (spawned < worker_count) : (spawned += 1) {
+        threads[spawned] = try std.Thread.spawn(.{}, workerMain, .{
+            server_fds[spawned],
+            @as(u32, @intCast(spawned)),
+            spawned % cpu_count,
+            pool_per_worker,
+            options,
+        });
+    }
+}
+
+fn workerMain(server_fd: c_int, worker_id: u32, cpu: usize, pool_size: usize, options: EchoServerOptions) void {
+    if (blitz_pin_to_cpu(@intCast(cpu)) != 0) {
+        std.log.warn("Worker {}: failed to pin to CPU {}", .{ worker_id, cpu });
+    }
+
+    serveWorker(server_fd, worker_id, pool_size, options) catch |err| {
+        std.log.err("Worker {} stopped: {}", .{ worker_id, err });
+    };
+}
+
+// Create the worker's ring on the calling thread (required for SINGLE_ISSUER) and run its loop
+fn serveWorker(server_fd: c_int, worker_id: u32, pool_size: usize, options: EchoServerOptions) !void {
+    var worker_ring: c.struct_io_uring = undefined;
+    const mode = try initRing(&worker_ring, options.ring, worker_id);
+    defer c.io_uring_queue_exit(&worker_ring);
+
+    std.log.info("Worker {}: {s} ring, {} SQ entries", .{ worker_id, @tagName(mode), options.ring.sq_entries });
+    try runWorker(&worker_ring, server_fd, worker_id, mode, pool_size, options);
+}
+
+// Event loop for one worker. Everything it touches is owned by this worker,
+// so no state is shared between rings.
+fn runWorker(ring_ptr: *c.struct_io_uring, server_fd: c_int, worker_id: u32, mode: config.RingConfig.Mode, pool_size: usize, options: EchoServerOptions) !void {
     // Initialize allocators at startup - zero allocations after this
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
     const backing_allocator = gpa.allocator();
 
-    // TLS context disabled for PicoTLS migration
-    // TLS will be handled by PicoTLS in QUIC implementation
-
-    // Pre-allocate buffer pool (all buffers allocated at startup)
-    var buffer_pool = try allocator.BufferPool.init(backing_allocator, BUFFER_SIZE, BUFFER_POOL_SIZE);
+    // Reserve the buffer arena (pages are committed on first use by this pinned thread)
+    var buffer_pool = try allocator.BufferPool.init(backing_allocator, BUFFER_SIZE, pool_size, .{
+        .huge_pages = switch (options.arena.huge_pages) {
+            .off => .off,
+            .transparent => .transparent,
+            .explicit => .explicit,
+        },
+        .numa_local = options.arena.numa_local,
+    });
     defer buffer_pool.deinit();
+    std.log.info("Worker {}: buffer arena {} MiB reserved, huge pages: {s}, NUMA node: {?d}", .{
+        worker_id,
+        buffer_pool.arena.region.len >> 20,
+        @tagName(buffer_pool.arena.huge_pages),
+        buffer_pool.arena.numa_node,
+    });
+
+    // Provided buffers for multishot recv, carved out of the read pool
+    const recv_ring_entries = @min(RECV_BUFFER_RING_SIZE, std.math.floorPowerOfTwo(usize, pool_size / 2));
+    var recv_buffers = try RecvBufferRing.init(ring_ptr, &buffer_pool, backing_allocator, recv_ring_entries);
+    defer recv_buffers.deinit(ring_ptr, &buffer_pool, backing_allocator);
+
+    // Per-connection protocol state (TLS sessions, handshake jobs) comes
+    // from size-class slabs so the request path never reaches the GPA
+    var conn_slab = allocator.SlabAllocator.init(backing_allocator);
+    defer conn_slab.deinit();
+    const conn_allocator = conn_slab.allocator();
+
+    var io = WorkerIo{ .ring = ring_ptr };
+    if (options.registered_io) {
+        enableRegisteredIo(&io, &buffer_pool, worker_id);
+    }
 
-    // Use HashMap for connection storage (handles any fd value safely)
-    var connections = std.AutoHashMap(c_int, Connection).init(backing_allocator);
+    // Flat slot array indexed by fd (or fixed-file slot)
+    var connections = try ConnectionTable.init(connectionTableCapacity(io.fixed_files));
     defer connections.deinit();
 
-    // Submit initial accept
-    const sqe_opt = blitz_io_uring_get_sqe(&ring);
-    if (sqe_opt == null) {
+    // Open fds and stat results for static file routes, kept fresh by inotify read through the ring
+    var file_cache = static_files.FileCache.init(backing_allocator);
+    defer file_cache.deinit();
+    worker_files = &file_cache;
+    defer worker_files = null;
+    var inotify_buf: [INOTIFY_BUFFER_SIZE]u8 align(@alignOf(std.os.linux.inotify_event)) = undefined;
+    if (file_cache.inotify_fd >= 0 and !armInotify(&io, file_cache.inotify_fd, &inotify_buf)) {
         return error.GetSqeFailed;
     }
-    var sqe = sqe_opt.?;
 
-    c.io_uring_prep_accept(sqe, server_fd, null, null, 0);
-    setSqeData(sqe, encodeUserData(server_fd, .accept));
-    _ = c.io_uring_submit(&ring);
+    // Handshake steps go to the shared offload pool and come back through this worker's eventfd
+    var handshake_offload: HandshakeOffload = undefined;
+    if (tls_handshake_pool) |pool| {
+        handshake_offload = .{ .pool = pool, .completions = try handshake_pool.Completions.init(), .allocator = conn_allocator };
+        worker_handshakes = &handshake_offload;
+        if (!armHandshakeEvents(&io, &handshake_offload)) {
+            return error.GetSqeFailed;
+        }
+    }
+    defer if (worker_handshakes) |offload| {
+        offload.completions.deinit();
+        worker_handshakes = null;
+    };
 
-    var connection_count: u64 = 0;
+    // Submit initial accept
+    if (!armAccept(&io, server_fd)) {
+        return error.GetSqeFailed;
+    }
+
+    // Connection deadlines; checked lazily, so activity only updates timestamps
+    var timers = TimerWheel.init(timerTick(@intCast(std.time.nanoTimestamp())));
+    var timer_ts = c.struct___kernel_timespec{ .tv_sec = 0, .tv_nsec = TIMER_TICK_NS };
+    if (!armTimer(&io, &timer_ts)) {
+        return error.GetSqeFailed;
+    }
     var total_requests: u64 = 0;
     var requests_this_second: u64 = 0;
+    var syscalls_at_last_stats: u64 = 0;
     var last_stats_time = std.time.nanoTimestamp();
 
+    var cqes: [CQE_BATCH_SIZE]?*c.struct_io_uring_cqe = undefined;
+
     // Main event loop - this is where the magic happens
     while (true) {
-        var cqe: ?*c.struct_io_uring_cqe = null;
-        _ = blitz_io_uring_wait_cqe(&ring, &cqe);
-
-        if (cqe == null) {
-            continue;
+        // One syscall per iteration: submit every SQE queued while handling the
+        // previous batch and wait for at least one completion
+        const submit_ret = c.io_uring_submit_and_wait(ring_ptr, 1);
+        io.syscalls += 1;
+        if (submit_ret < 0 and submit_ret != -c.EINTR) {
+            std.log.warn("Worker {}: io_uring_submit_and_wait failed: {d}", .{ worker_id, submit_ret });
         }
 
-        const res = cqe.?.res;
-        const user_data = cqe.?.user_data;
-        const decoded = decodeUserData(user_data);
-
-        blitz_io_uring_cqe_seen(&ring, cqe);
-
-        if (res < 0) {
-            if (decoded.op == .read or decoded.op == .write) {
-                _ = c.close(decoded.fd);
-            }
-            continue;
-        }
-
-        switch (decoded.op) {
-            .accept => {
-                const client_fd: c_int = res;
-                connection_count += 1;
-
-                // Get read buffer from pool (zero allocation)
-                const read_buf = buffer_pool.acquireRead() orelse {
-                    // Pool exhausted - close connection and continue
-                    _ = c.close(client_fd);
-                    // Re-submit accept
-                    const sqe_opt2 = blitz_io_uring_get_sqe(&ring);
-                    if (sqe_opt2 == null) continue;
-                    sqe = sqe_opt2.?;
-                    c.io_uring_prep_accept(sqe, server_fd, null, null, 0);
-                    setSqeData(sqe, encodeUserData(server_fd, .accept));
-                    _ = c.io_uring_submit(&ring);
-                    continue;
-                };
-
-                // Store connection info in HashMap
-                const now: i64 = @intCast(std.time.nanoTimestamp());
-                try connections.put(client_fd, Connection{
-                    .fd = client_fd,
-                    .read_buffer = read_buf,
-                    .in_use = true,
-                    .created_at = now,
-                    .last_active = now,
-                    .request_count = 0,
-                });
-                // Don't initialize TLS here - we'll detect it from first bytes
-
-                // Make socket non-blocking (required for OpenSSL)
-                // Note: Socket is already non-blocking from SOCK_NONBLOCK flag, but ensure it's set
-                const flags = c.fcntl(client_fd, c.F_GETFL, @as(c_int, 0));
-                if (flags >= 0) {
-                    _ = c.fcntl(client_fd, c.F_SETFL, @as(c_int, flags | c.O_NONBLOCK));
-                }
-
-                // Submit read for new connection
-                const sqe_opt4 = blitz_io_uring_get_sqe(&ring);
-                if (sqe_opt4 == null) {
-                    buffer_pool.releaseRead(read_buf);
-                    _ = c.close(client_fd);
-                } else {
-                    const read_sqe = sqe_opt4.?;
-                    c.io_uring_prep_read(read_sqe, client_fd, read_buf.ptr, @as(c_uint, @intCast(BUFFER_SIZE)), 0);
-                    setSqeData(read_sqe, encodeUserData(client_fd, .read));
-                    _ = c.io_uring_submit(&ring);
-                }
-
-                // Re-submit accept for next connection
-                const sqe_opt3 = blitz_io_uring_get_sqe(&ring);
-                if (sqe_opt3 != null) {
-                    sqe = sqe_opt3.?;
-                    c.io_uring_prep_accept(sqe, server_fd, null, null, 0);
-                    setSqeData(sqe, encodeUserData(server_fd, .accept));
-                    _ = c.io_uring_submit(&ring);
-                }
-            },
-            .read => {
-                const bytes_read: usize = @intCast(res);
-                const client_fd = decoded.fd;
-
-                if (bytes_read == 0) {
-                    // Connection closed - explicit cleanup
-                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "client closed");
-                    continue;
+        // Drain every ready CQE, then release them to the kernel in one step
+        const cqe_count = blitz_io_uring_peek_batch_cqe(ring_ptr, &cqes, CQE_BATCH_SIZE);
+        defer blitz_io_uring_cq_advance(ring_ptr, cqe_count);
+
+        for (cqes[0..cqe_count]) |cqe_opt| {
+            const cqe = cqe_opt orelse continue;
+            const res = cqe.res;
+            const user_data = cqe.user_data;
+            const cqe_flags = cqe.flags;
+            const decoded = decodeUserData(user_data);
+
+            // Multishot requests keep posting while F_MORE is set; once it's clear they must be re-armed
+            const more = (cqe_flags & c.IORING_CQE_F_MORE) != 0;
+
+            // Multishot recv handles its own errors (ENOBUFS re-arm, deferred close);
+            // the timer completes with -ETIME on every tick; inotify and the handshake
+            // eventfd aren't connections; splice_out is cancelled when its linked splice_in
+            // comes up short, which isn't an error
+            if (res < 0 and decoded.op != .recv and decoded.op != .timer and decoded.op != .inotify and decoded.op != .tls_handshake and decoded.op != .splice_out) {
+                if (decoded.op == .close) {
+                    // Nothing left to clean up
+                } else if (decoded.op == .accept) {
+                    if (!more and !armAccept(&io, server_fd)) {
+                        std.log.err("Worker {}: failed to re-arm accept", .{worker_id});
+                    }
+                } else if (connections.get(decoded.fd, decoded.generation) != null) {
+                    closeConnection(&io, decoded.fd, &connections, &buffer_pool, conn_allocator, "I/O error");
                 }
+                continue;
+            }
 
-                // Get connection from HashMap
-                const conn_opt = connections.getPtr(client_fd);
-                if (conn_opt == null) {
-                    // Connection not found - close it
-                    _ = c.close(client_fd);
-                    continue;
-                }
-                var conn = conn_opt.?;
+            switch (decoded.op) {
+                .accept => {
+                    const client_fd: c_int = res;
 
-                const read_buf = conn.read_buffer orelse {
-                    _ = c.close(client_fd);
-                    continue;
-                };
-
-                // Track effective data length (decrypted_len for TLS, bytes_read for plaintext)
-                var effective_bytes: usize = bytes_read;
-
-                // TLS detection disabled for PicoTLS migration
-                // TLS will be handled by PicoTLS in QUIC implementation
-
-                // Handle TLS handshake if in progress (continuation after initial detection)
-                // Note: TLS is currently disabled (PicoTLS migration)
-                // When TLS is re-enabled, tls_conn should be properly typed
-                if (conn.is_tls) {
-                    if (conn.tls_conn) |tls_conn_opaque| {
-                        // Cast opaque pointer to TlsConnectionStub to access protocol field
-                        // When TLS is re-enabled, this should be properly typed
-                        // Note: This is unsafe casting - TLS is currently disabled
-                        // In Zig 0.15.2, use @as for type assertion
-                        const tls_conn = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque)));
-                        if (tls_conn.state == .handshake) {
-                            // Feed new data to TLS connection
-                            tls_conn.feedData(read_buf[0..bytes_read]) catch |err| {
-                                std.log.warn("Failed to feed TLS data: {}", .{err});
-                                buffer_pool.releaseRead(read_buf);
-                                _ = c.close(client_fd);
-                                continue;
-                            };
+                    if (!more and !armAccept(&io, server_fd)) {
+                        std.log.err("Worker {}: failed to re-arm accept", .{worker_id});
+                    }
 
-                            // Continue TLS handshake
-                            _ = tls_conn.doHandshake() catch |err| {
-                                std.log.warn("TLS handshake failed: {}", .{err});
-                                buffer_pool.releaseRead(read_buf);
-                                _ = c.close(client_fd);
-                                continue;
-                            };
-
-                            // Check handshake state after doHandshake
-                            // TLS is disabled - state check is a no-op
-                            if (tls_conn.state == .handshake) {
-                                // Check for encrypted output to send
-                                if (tls_conn.hasEncryptedOutput()) {
-                                    const write_buf_tls = buffer_pool.acquireWrite() orelse {
-                                        buffer_pool.releaseRead(read_buf);
-                                        _ = c.close(client_fd);
-                                        continue;
-                                    };
-                                    // CRITICAL: Must read all encrypted output to prevent incomplete TLS records
-                                    const encrypted_len = tls_conn.getAllEncryptedOutput(write_buf_tls) catch |err| {
-                                        std.log.warn("Failed to get TLS encrypted output: {}", .{err});
-                                        buffer_pool.releaseWrite(write_buf_tls);
-                                        buffer_pool.releaseRead(read_buf);
-                                        _ = c.close(client_fd);
-                                        continue;
-                                    };
-
-                                    if (connections.getPtr(client_fd)) |conn_ptr| {
-                                        conn_ptr.write_buffer = write_buf_tls;
-                                    }
-
-                                    const sqe_opt_tls_write = blitz_io_uring_get_sqe(&ring);
-                                    if (sqe_opt_tls_write == null) {
-                                        buffer_pool.releaseRead(read_buf);
-                                        continue;
-                                    }
-                                    sqe = sqe_opt_tls_write.?;
-                                    c.io_uring_prep_write(sqe, client_fd, write_buf_tls.ptr, @as(c_uint, @intCast(encrypted_len)), 0);
-                                    setSqeData(sqe, encodeUserData(client_fd, .write));
-                                    _ = c.io_uring_submit(&ring);
-                                }
-
-                                // Need more data - submit another read
-                                const sqe_opt5 = blitz_io_uring_get_sqe(&ring);
-                                if (sqe_opt5 == null) {
-                                    buffer_pool.releaseRead(read_buf);
-                                    _ = c.close(client_fd);
-                                    continue;
-                                }
-                                sqe = sqe_opt5.?;
-                                c.io_uring_prep_read(sqe, client_fd, read_buf.ptr, @as(c_uint, @intCast(BUFFER_SIZE)), 0);
-                                setSqeData(sqe, encodeUserData(client_fd, .read));
-                                _ = c.io_uring_submit(&ring);
-                                buffer_pool.releaseRead(read_buf);
-                                continue;
-                            }
+                    // No read buffer is taken here - multishot recv picks one when data arrives
+                    const now: i64 = @intCast(std.time.nanoTimestamp());
+                    const conn = connections.open(client_fd, now) orelse {
+                        std.log.warn("Worker {}: fd {} exceeds connection table ({} slots), closing", .{ worker_id, client_fd, connections.slots.len });
+                        closeSocket(&io, client_fd);
+                        continue;
+                    };
+                    // With a certificate configured the listener only speaks TLS
+                    if (tls_context) |*tls_ctx| {
+                        const session = conn_allocator.create(tls.TlsConnection) catch {
+                            closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "no memory for TLS session");
+                            continue;
+                        };
+                        session.* = tls_ctx.newConnection() catch {
+                            conn_allocator.destroy(session);
+                            closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "TLS session setup failed");
+                            continue;
+                        };
+                        // Registered-file sockets have no fd to hand the keys to
+                        if (io.fixed_files) session.ktls_wanted = false;
+                        conn.tls_session = session;
+                    }
 
-                            // Handshake complete - send any remaining encrypted output (final Finished message)
-                            if (tls_conn.hasEncryptedOutput()) {
-                                const write_buf_tls = buffer_pool.acquireWrite() orelse {
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no write buffer");
-                                    continue;
-                                };
-                                // CRITICAL: Must read all encrypted output to prevent incomplete TLS records
-                                const encrypted_len = tls_conn.getAllEncryptedOutput(write_buf_tls) catch |err| {
-                                    std.log.warn("Failed to get TLS encrypted output: {}", .{err});
-                                    buffer_pool.releaseWrite(write_buf_tls);
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "getEncryptedOutput failed");
-                                    continue;
-                                };
-
-                                if (connections.getPtr(client_fd)) |conn_ptr| {
-                                    conn_ptr.write_buffer = write_buf_tls;
-                                }
-
-                                const sqe_opt_tls_write2 = blitz_io_uring_get_sqe(&ring);
-                                if (sqe_opt_tls_write2 == null) {
-                                    buffer_pool.releaseRead(read_buf);
-                                    continue;
-                                }
-                                sqe = sqe_opt_tls_write2.?;
-                                c.io_uring_prep_write(sqe, client_fd, write_buf_tls.ptr, @as(c_uint, @intCast(encrypted_len)), 0);
-                                setSqeData(sqe, encodeUserData(client_fd, .write));
-                                _ = c.io_uring_submit(&ring);
-                            }
+                    // Socket is already non-blocking (required for OpenSSL): accept passes SOCK_NONBLOCK
 
-                            // Handshake complete - WAIT for next read event (encrypted HTTP request)
-                            // Don't try to decrypt yet - client will send encrypted HTTP GET in next packet
-                            // CRITICAL: Clear read_bio before releasing buffer to prevent "bad record mac" errors
-                            tls_conn.clearReadBio();
-                            buffer_pool.releaseRead(read_buf);
+                    if (armRecv(&io, conn)) {
+                        conn.recv_armed = true;
+                        timers.schedule(&conn.timer, timerTick(conn.deadline()) + 1);
+                    } else {
+                        closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "no SQE for recv");
+                    }
+                },
+                .close => {},
+                .tls_handshake => {
+                    const offload = worker_handshakes orelse continue;
+                    if (res < 0) {
+                        std.log.warn("Worker {}: handshake eventfd read failed ({d})", .{ worker_id, res });
+                    }
+                    var done = offload.completions.take();
+                    while (done) |job| {
+                        done = job.next;
+                        const hs: *HandshakeJob = @fieldParentPtr("job", job);
+                        const owner = connections.get(hs.fd, hs.generation);
+                        if (owner == null or owner.?.handshake_job != hs) {
+                            // Closed while the step ran: the session was left to the job
+                            hs.session.deinit();
+                            conn_allocator.destroy(hs.session);
+                            conn_allocator.destroy(hs);
                             continue;
                         }
-
-                        // Check if TLS is now connected (after handshake or if already connected)
-                        // TLS is disabled - state check is a no-op
-                        if (tls_conn.state == .connected) {
-                            // This is encrypted application data (HTTP request)
-                            // Feed encrypted data from io_uring to OpenSSL read_bio
-                            tls_conn.feedData(read_buf[0..bytes_read]) catch |err| {
-                                std.log.warn("Failed to feed TLS application data: {}", .{err});
-                                // CRITICAL: Clear read_bio before releasing buffer
-                                tls_conn.clearReadBio();
-                                buffer_pool.releaseRead(read_buf);
-                                closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "TLS feedData failed");
-                                continue;
-                            };
-
-                            // Decrypt data: SSL_read reads from read_bio, decrypts, writes to buffer
-                            // Note: We use a separate buffer for decrypted data to avoid overwriting
-                            // The encrypted data in read_buf is already fed to read_bio
-                            const tls_decrypted_len = tls_conn.read(read_buf) catch |err| {
-                                if (err == error.WantRead) {
-                                    // Need more data - don't clear read_bio yet, we'll need it for the next read
-                                    const sqe_opt6 = blitz_io_uring_get_sqe(&ring);
-                                    if (sqe_opt6 == null) {
-                                        // CRITICAL: Clear read_bio before releasing buffer
-                                        tls_conn.clearReadBio();
-                                        buffer_pool.releaseRead(read_buf);
-                                        _ = c.close(client_fd);
-                                        continue;
-                                    }
-                                    sqe = sqe_opt6.?;
-                                    c.io_uring_prep_read(sqe, client_fd, read_buf.ptr, @as(c_uint, @intCast(BUFFER_SIZE)), 0);
-                                    setSqeData(sqe, encodeUserData(client_fd, .read));
-                                    _ = c.io_uring_submit(&ring);
-                                    continue;
-                                } else {
-                                    std.log.warn("TLS read failed: {}", .{err});
-                                    // CRITICAL: Clear read_bio before releasing buffer
-                                    tls_conn.clearReadBio();
-                                    buffer_pool.releaseRead(read_buf);
-                                    _ = c.close(client_fd);
-                                    continue;
-                                }
-                            };
-
-                            // Update protocol based on ALPN (only if not already set, to preserve across reads)
-                            if (conn.protocol == .http1_1) {
-                                conn.protocol = tls_conn.protocol;
-                            }
-
-                            std.log.debug("TLS decrypted {} bytes, protocol: {} (conn.protocol: {})", .{ tls_decrypted_len, tls_conn.protocol, conn.protocol });
-
-                            // Initialize HTTP/2 connection if negotiated (check conn.protocol which persists across reads)
-                            if (conn.protocol == .http2) {
-                                std.log.debug("HTTP/2 protocol detected, processing frames", .{});
-                                const is_new_http2_conn = (conn.http2_conn == null);
-
-                                if (is_new_http2_conn) {
-                                    const http2_conn = http2.Http2Connection.init(backing_allocator);
-                                    conn.http2_conn = backing_allocator.create(http2.Http2Connection) catch {
-                                        std.log.warn("Failed to allocate HTTP/2 connection", .{});
-                                        buffer_pool.releaseRead(read_buf);
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "HTTP/2 allocation failed");
-                                        continue;
-                                    };
-                                    conn.http2_conn.?.* = http2_conn;
-
-                                    // Send initial server SETTINGS frame immediately after connection establishment
-                                    const write_buf_init = buffer_pool.acquireWrite() orelse {
-                                        buffer_pool.releaseRead(read_buf);
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no write buffer for SETTINGS");
-                                        continue;
-                                    };
-
-                                    const server_settings = conn.http2_conn.?.getServerSettings();
-                                    const settings_len = http2.frame.generateServerSettings(server_settings, write_buf_init) catch |err| {
-                                        std.log.warn("Failed to generate server SETTINGS: {}", .{err});
-                                        buffer_pool.releaseWrite(write_buf_init);
-                                        buffer_pool.releaseRead(read_buf);
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "SETTINGS generation failed");
-                                        continue;
-                                    };
-
-                                    // Encrypt and send initial SETTINGS
-                                    _ = tls_conn.write(write_buf_init[0..settings_len]) catch |err| {
-                                        std.log.warn("Failed to encrypt SETTINGS: {}", .{err});
-                                        buffer_pool.releaseWrite(write_buf_init);
-                                        buffer_pool.releaseRead(read_buf);
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "TLS write failed");
-                                        continue;
-                                    };
-
-                                    // CRITICAL: Must read all encrypted output to prevent incomplete TLS records
-                                    const encrypted_settings_len = tls_conn.getAllEncryptedOutput(write_buf_init) catch |err| {
-                                        std.log.warn("Failed to get encrypted SETTINGS: {}", .{err});
-                                        buffer_pool.releaseWrite(write_buf_init);
-                                        buffer_pool.releaseRead(read_buf);
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "TLS output failed");
-                                        continue;
-                                    };
-
-                                    const sqe_opt_settings = blitz_io_uring_get_sqe(&ring);
-                                    if (sqe_opt_settings != null) {
-                                        const settings_sqe = sqe_opt_settings.?;
-                                        c.io_uring_prep_write(settings_sqe, client_fd, write_buf_init.ptr, @as(c_uint, @intCast(encrypted_settings_len)), 0);
-                                        setSqeData(settings_sqe, encodeUserData(client_fd, .write));
-                                        _ = c.io_uring_submit(&ring);
-
-                                        // Only assign write_buffer after successfully obtaining SQE
-                                        if (connections.getPtr(client_fd)) |conn_ptr| {
-                                            conn_ptr.write_buffer = write_buf_init;
-                                        }
-                                    } else {
-                                        // Clear write_buffer before releasing to avoid double-free in closeConnection
-                                        if (connections.getPtr(client_fd)) |conn_ptr| {
-                                            if (conn_ptr.write_buffer) |buf| {
-                                                if (buf.ptr == write_buf_init.ptr) {
-                                                    conn_ptr.write_buffer = null;
-                                                }
-                                            }
-                                        }
-                                        buffer_pool.releaseWrite(write_buf_init);
-                                        buffer_pool.releaseRead(read_buf);
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no SQE for SETTINGS");
-                                        continue;
-                                    }
-
-                                    // After sending initial SETTINGS, wait for client frames
-                                    buffer_pool.releaseRead(read_buf);
-
-                                    // Submit read for client's SETTINGS frame
-                                    const fresh_read_buf = buffer_pool.acquireRead() orelse {
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no read buffer");
-                                        continue;
-                                    };
-
-                                    if (connections.getPtr(client_fd)) |conn_ptr| {
-                                        conn_ptr.read_buffer = fresh_read_buf;
-                                    }
-
-                                    const sqe_opt_read = blitz_io_uring_get_sqe(&ring);
-                                    if (sqe_opt_read != null) {
-                                        const read_sqe = sqe_opt_read.?;
-                                        c.io_uring_prep_read(read_sqe, client_fd, fresh_read_buf.ptr, @as(c_uint, @intCast(BUFFER_SIZE)), 0);
-                                        setSqeData(read_sqe, encodeUserData(client_fd, .read));
-                                        _ = c.io_uring_submit(&ring);
-                                    } else {
-                                        buffer_pool.releaseRead(fresh_read_buf);
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no SQE for read");
-                                    }
-
-                                    continue; // Wait for client's SETTINGS frame
-                                }
-
-                                // Handle HTTP/2 frames using decrypted data
-                                // Process all frames in the buffer (may contain multiple frames)
-                                std.log.info("Processing HTTP/2 frames, {} bytes available (first 16 bytes: {any})", .{ tls_decrypted_len, read_buf[0..@min(16, tls_decrypted_len)] });
-                                const frame_result = conn.http2_conn.?.processAllFrames(read_buf[0..tls_decrypted_len]) catch |err| {
-                                    std.log.err("HTTP/2 frame handling failed: {} (first 16 bytes: {any})", .{ err, read_buf[0..@min(16, tls_decrypted_len)] });
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "HTTP/2 frame error");
-                                    continue;
-                                };
-                                const response_action = frame_result.action;
-                                const needs_settings_ack = frame_result.needs_settings_ack;
-                                const frames_consumed = frame_result.bytes_consumed;
-                                std.log.info("Processed {} bytes of HTTP/2 frames, response action: {}, needs_settings_ack: {}", .{ frames_consumed, response_action, needs_settings_ack });
-
-                                // CRITICAL: If we need SETTINGS ACK, we MUST send it BEFORE any response
-                                // This is required by HTTP/2 spec - clients will hang if ACK comes after response
-
-                                // Process response action
-                                const write_buf = buffer_pool.acquireWrite() orelse {
-                                    // Free response_action if it has owned resources before closing connection
-                                    response_action.deinit(backing_allocator);
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no write buffer");
-                                    continue;
-                                };
-
-                                var response_len: usize = 0;
-                                var offset: usize = 0;
-
-                                // Send SETTINGS ACK first if needed (CRITICAL for HTTP/2 compliance)
-                                if (needs_settings_ack) {
-                                    std.log.info("Sending SETTINGS ACK before response", .{});
-                                    const ack_len = http2.frame.generateSettingsAck(write_buf[offset..]) catch |err| {
-                                        std.log.warn("Failed to generate SETTINGS ACK: {}", .{err});
-                                        buffer_pool.releaseWrite(write_buf);
-                                        buffer_pool.releaseRead(read_buf);
-                                        continue;
-                                    };
-                                    offset += ack_len;
-                                }
-
-                                // Now send the main response (if any)
-                                switch (response_action) {
-                                    .none => {
-                                        // If we only need SETTINGS ACK (no response), send it now
-                                        if (needs_settings_ack) {
-                                            // response_len is already set to offset (ACK length) above
-                                            // Continue to encryption/write below
-                                            std.log.info("Sending SETTINGS ACK only (no response)", .{});
-                                        } else {
-                                            // No response and no ACK needed - just read more
-                                            buffer_pool.releaseWrite(write_buf);
-                                            buffer_pool.releaseRead(read_buf);
-                                            // Submit another read for next frame
-                                            const sqe_opt_next = blitz_io_uring_get_sqe(&ring);
-                                            if (sqe_opt_next != null) {
-                                                const read_sqe = sqe_opt_next.?;
-                                                const fresh_read_buf = buffer_pool.acquireRead() orelse {
-                                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no read buffer");
-                                                    continue;
-                                                };
-                                                if (connections.getPtr(client_fd)) |conn_ptr| {
-                                                    conn_ptr.read_buffer = fresh_read_buf;
-                                                }
-                                                c.io_uring_prep_read(read_sqe, client_fd, fresh_read_buf.ptr, @as(c_uint, @intCast(BUFFER_SIZE)), 0);
-                                                setSqeData(read_sqe, encodeUserData(client_fd, .read));
-                                                _ = c.io_uring_submit(&ring);
-                                            } else {
-                                                closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no SQE for read");
-                                            }
-                                            continue;
-                                        }
-                                    },
-                                    .send_settings => {
-                                        // Send server SETTINGS frame (initial settings)
-                                        const server_settings = conn.http2_conn.?.getServerSettings();
-                                        const settings_len = http2.frame.generateServerSettings(server_settings, write_buf[offset..]) catch |err| {
-                                            std.log.warn("Failed to generate server SETTINGS: {}", .{err});
-                                            buffer_pool.releaseWrite(write_buf);
-                                            buffer_pool.releaseRead(read_buf);
-                                            continue;
-                                        };
-                                        offset += settings_len;
-                                    },
-                                    .send_settings_ack => {
-                                        // This should not happen here since we handle it above, but keep for safety
-                                        if (!needs_settings_ack) {
-                                            const ack_len = http2.frame.generateSettingsAck(write_buf[offset..]) catch |err| {
-                                                std.log.warn("Failed to generate SETTINGS ACK: {}", .{err});
-                                                buffer_pool.releaseWrite(write_buf);
-                                                buffer_pool.releaseRead(read_buf);
-                                                continue;
-                                            };
-                                            offset += ack_len;
-                                        }
-                                    },
-                                    .send_ping_ack => |ping_data| {
-                                        const ping_len = http2.frame.generatePingAck(ping_data, write_buf[offset..]) catch |err| {
-                                            std.log.warn("Failed to generate PING ACK: {}", .{err});
-                                            // Use deinit to properly free owned ping_data
-                                            response_action.deinit(backing_allocator);
-                                            buffer_pool.releaseWrite(write_buf);
-                                            buffer_pool.releaseRead(read_buf);
-                                            continue;
-                                        };
-                                        offset += ping_len;
-                                        // Use deinit to properly free owned ping_data
-                                        response_action.deinit(backing_allocator);
-                                    },
-                                    .send_response => |resp| {
-                                        std.log.info("Generating HTTP/2 response for stream {}, body_len={}", .{ resp.stream_id, resp.body.len });
-                                        const resp_len = conn.http2_conn.?.generateResponse(resp.stream_id, resp.status, resp.headers, resp.body, write_buf[offset..]) catch |err| {
-                                            std.log.warn("Failed to generate HTTP/2 response: {}", .{err});
-                                            // Use deinit to properly free all owned resources (body, headers slice, and allocated header values)
-                                            response_action.deinit(backing_allocator);
-                                            buffer_pool.releaseWrite(write_buf);
-                                            buffer_pool.releaseRead(read_buf);
-                                            continue;
-                                        };
-                                        offset += resp_len;
-                                        std.log.info("Generated HTTP/2 response, {} bytes", .{resp_len});
-                                        // Use deinit to properly free all owned resources (body, headers slice, and allocated header values)
-                                        response_action.deinit(backing_allocator);
-                                    },
-                                    .send_goaway => |last_stream_id| {
-                                        const goaway_len = http2.frame.generateGoaway(@as(u31, @intCast(last_stream_id)), @intFromEnum(http2.frame.ErrorCode.no_error), write_buf[offset..]) catch |err| {
-                                            std.log.warn("Failed to generate GOAWAY: {}", .{err});
-                                            buffer_pool.releaseWrite(write_buf);
-                                            buffer_pool.releaseRead(read_buf);
-                                            continue;
-                                        };
-                                        offset += goaway_len;
-                                    },
-                                    .close_connection => {
-                                        buffer_pool.releaseWrite(write_buf);
-                                        buffer_pool.releaseRead(read_buf);
-                                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "GOAWAY received");
-                                        continue;
-                                    },
-                                }
-
-                                // CRITICAL: Set response_len AFTER all frames are written to offset
-                                // This ensures we include both SETTINGS ACK (if sent) AND the main response
-                                // offset contains: ACK length (if needs_settings_ack) + response length (if any)
-                                response_len = offset;
-
-                                // CRITICAL: If response_len is 0, we have nothing to send - this is an error
-                                if (response_len == 0) {
-                                    std.log.warn("HTTP/2 response length is 0! needs_settings_ack={}, response_action={}", .{ needs_settings_ack, response_action });
-                                    buffer_pool.releaseWrite(write_buf);
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "HTTP/2 response length is 0");
-                                    continue;
-                                }
-
-                                // Encrypt HTTP/2 response frame(s)
-                                // CRITICAL: Clear any stale data from write_bio before encrypting new data
-                                // This prevents "bad record mac" errors from leftover encrypted data
-                                // Clear multiple times to ensure BIO is completely empty (OpenSSL BIOs can have internal state)
-                                tls_conn.clearEncryptedOutput();
-
-                                // Verify write_bio is empty before encrypting - retry if needed
-                                var clear_attempts: u32 = 0;
-                                while (tls_conn.hasEncryptedOutput() and clear_attempts < 3) {
-                                    std.log.warn("Warning: write_bio still has data after clearEncryptedOutput() (attempt {})!", .{clear_attempts + 1});
-                                    tls_conn.clearEncryptedOutput();
-                                    clear_attempts += 1;
-                                }
-
-                                // Final check - if still not empty, log error but continue (might be a false positive)
-                                if (tls_conn.hasEncryptedOutput()) {
-                                    std.log.err("ERROR: write_bio still has data after {} clear attempts! This may cause 'bad record mac' errors.", .{clear_attempts + 1});
-                                }
-
-                                std.log.info("Encrypting HTTP/2 response, {} bytes (ACK: {}, main: {})", .{ response_len, needs_settings_ack, response_action != .none });
-
-                                _ = tls_conn.write(write_buf[0..response_len]) catch |err| {
-                                    std.log.warn("Failed to encrypt HTTP/2 response: {}", .{err});
-                                    buffer_pool.releaseWrite(write_buf);
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "TLS write failed");
-                                    continue;
-                                };
-
-                                // CRITICAL: Must read all encrypted output to prevent incomplete TLS records
-                                const encrypted_len = tls_conn.getAllEncryptedOutput(write_buf) catch |err| {
-                                    std.log.warn("Failed to get encrypted HTTP/2 output: {}", .{err});
-                                    buffer_pool.releaseWrite(write_buf);
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "TLS output failed");
-                                    continue;
-                                };
-
-                                std.log.info("Encrypted HTTP/2 response, {} bytes (plaintext: {}), submitting write", .{ encrypted_len, response_len });
-
-                                // CRITICAL: If encrypted_len is 0, TLS write produced no output - this is an error
-                                if (encrypted_len == 0) {
-                                    std.log.warn("TLS encryption produced no output for HTTP/2 response!", .{});
-                                    buffer_pool.releaseWrite(write_buf);
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no encrypted output");
-                                    continue;
-                                }
-
-                                const sqe_opt_write = blitz_io_uring_get_sqe(&ring);
-                                if (sqe_opt_write != null) {
-                                    const write_sqe = sqe_opt_write.?;
-                                    c.io_uring_prep_write(write_sqe, client_fd, write_buf.ptr, @as(c_uint, @intCast(encrypted_len)), 0);
-                                    setSqeData(write_sqe, encodeUserData(client_fd, .write));
-                                    _ = c.io_uring_submit(&ring);
-
-                                    // Only assign write_buffer after successfully obtaining SQE
-                                    if (connections.getPtr(client_fd)) |conn_ptr| {
-                                        conn_ptr.write_buffer = write_buf;
-                                    }
-                                } else {
-                                    // Clear write_buffer before releasing to avoid double-free in closeConnection
-                                    if (connections.getPtr(client_fd)) |conn_ptr| {
-                                        if (conn_ptr.write_buffer) |buf| {
-                                            if (buf.ptr == write_buf.ptr) {
-                                                conn_ptr.write_buffer = null;
-                                            }
-                                        }
-                                        // CRITICAL: Clear encrypted output before releasing buffer
-                                        if (conn_ptr.is_tls) {
-                                            if (conn_ptr.tls_conn) |tls_conn_opaque_inner| {
-                                                const tls_conn_inner = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque_inner)));
-                                                tls_conn_inner.clearEncryptedOutput();
-                                            }
-                                        }
-                                    }
-                                    buffer_pool.releaseWrite(write_buf);
-                                    // CRITICAL: Clear read_bio before releasing read buffer
-                                    if (connections.getPtr(client_fd)) |conn_ptr| {
-                                        if (conn_ptr.is_tls) {
-                                            if (conn_ptr.tls_conn) |tls_conn_opaque_inner| {
-                                                const tls_conn_inner = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque_inner)));
-                                                tls_conn_inner.clearReadBio();
-                                            }
-                                        }
-                                    }
-                                    buffer_pool.releaseRead(read_buf);
-                                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no SQE for write");
-                                }
-
-                                // CRITICAL: Clear read_bio before releasing buffer
-                                tls_conn.clearReadBio();
-                                buffer_pool.releaseRead(read_buf);
-                                continue;
-                            }
-
-                            // HTTP/1.1 over TLS - use decrypted data for parsing
-                            // OpenSSL SSL_read decrypts in-place, so read_buf contains decrypted data
-                            // Update effective_bytes to use decrypted length
-                            effective_bytes = tls_decrypted_len;
-
-                            // Update connection tracking
-                            const now: i64 = @intCast(std.time.nanoTimestamp());
-                            conn.last_active = now;
-                            conn.request_count += 1;
-
-                            // Check connection limits
-                            if (conn.request_count > Connection.MAX_REQUESTS_PER_CONN) {
-                                std.log.warn("Connection {} exceeded max requests ({}), closing", .{ client_fd, Connection.MAX_REQUESTS_PER_CONN });
-                                buffer_pool.releaseRead(read_buf);
-                                _ = c.close(client_fd);
-                                _ = connections.remove(client_fd);
-                                continue;
-                            }
-
-                            total_requests += 1;
-                            requests_this_second += 1;
-                            // Fall through to shared HTTP/1.1 handler below
-                        } else if (tls_conn.state == .tls_error or tls_conn.state == .closed) {
-                            // TLS error or closed state
-                            std.log.warn("TLS error/closed state: {}", .{tls_conn.state});
-                            buffer_pool.releaseRead(read_buf);
-                            _ = c.close(client_fd);
+                        const conn = owner.?;
+                        const result = hs.result;
+                        conn.handshake_job = null;
+                        conn_allocator.destroy(hs);
+
+                        const session = conn.tls_session.?;
+                        const served = resumeHandshake(&io, conn, session, &buffer_pool, result) catch |err| {
+                            closeConnection(&io, conn.fd, &connections, &buffer_pool, conn_allocator, tlsErrorReason(err));
                             continue;
-                        } else {
-                            // Unknown TLS state
-                            std.log.warn("TLS unknown state: {}", .{tls_conn.state});
-                            buffer_pool.releaseRead(read_buf);
-                            _ = c.close(client_fd);
+                        };
+                        total_requests += served;
+                        requests_this_second += served;
+
+                        if (!flushQueuedWrite(&io, conn, &buffer_pool)) {
+                            closeConnection(&io, conn.fd, &connections, &buffer_pool, conn_allocator, "no SQE for write");
                             continue;
                         }
-                    } else {
-                        // TLS connection not available
-                        std.log.warn("TLS expected but connection not available", .{});
-                        buffer_pool.releaseRead(read_buf);
-                        _ = c.close(client_fd);
+                        if (ktlsReady(conn, session)) {
+                            if (startKtls(&io, conn, session)) |reason| {
+                                closeConnection(&io, conn.fd, &connections, &buffer_pool, conn_allocator, reason);
+                            }
+                        }
+                    }
+                    if (!armHandshakeEvents(&io, offload)) {
+                        std.log.err("Worker {}: failed to re-arm handshake eventfd read", .{worker_id});
+                    }
+                },
+                .inotify => {
+                    if (res <= 0) {
+                        // Without invalidations the cache could serve stale files: stop caching
+                        std.log.warn("Worker {}: inotify read failed ({d}), static file cache disabled", .{ worker_id, res });
+                        file_cache.disable();
                         continue;
                     }
-                }
+                    file_cache.handleEvents(inotify_buf[0..@as(usize, @intCast(res))]);
+                    if (!armInotify(&io, file_cache.inotify_fd, &inotify_buf)) {
+                        std.log.warn("Worker {}: failed to re-arm inotify read, static file cache disabled", .{worker_id});
+                        file_cache.disable();
+                    }
+                },
+                .splice_in => {
+                    const conn = connections.get(decoded.fd, decoded.generation) orelse continue;
+                    if (conn.closing or conn.file_send == null) continue;
+                    switch (spliceInDone(&io, conn, res)) {
+                        .in_flight, .complete => {},
+                        .failed => |reason| closeConnection(&io, decoded.fd, &connections, &buffer_pool, conn_allocator, reason),
+                    }
+                },
+                .splice_out => {
+                    const conn = connections.get(decoded.fd, decoded.generation) orelse continue;
+                    if (conn.closing or conn.file_send == null) continue;
+                    switch (spliceOutDone(&io, conn, res)) {
+                        .in_flight => continue,
+                        .failed => |reason| {
+                            closeConnection(&io, decoded.fd, &connections, &buffer_pool, conn_allocator, reason);
+                            continue;
+                        },
+                        .complete => {},
+                    }
 
-                // Plain HTTP/1.1 (no TLS) - increment counters and update tracking
-                if (!conn.is_tls) {
-                    const now: i64 = @intCast(std.time.nanoTimestamp());
-                    conn.last_active = now;
-                    conn.request_count += 1;
-
-                    // Check connection limits
-                    if (conn.request_count > Connection.MAX_REQUESTS_PER_CONN) {
-                        std.log.warn("Connection {} exceeded max requests ({}), closing", .{ client_fd, Connection.MAX_REQUESTS_PER_CONN });
-                        buffer_pool.releaseRead(read_buf);
-                        _ = c.close(client_fd);
-                        _ = connections.remove(client_fd);
+                    // Body complete: answer the pipelined requests that waited behind it
+                    file_cache.release(conn.file_send.?.entry);
+                    conn.file_send = null;
+                    const served = serveHttp1(conn, &buffer_pool, &.{}) catch |err| {
+                        closeConnection(&io, decoded.fd, &connections, &buffer_pool, conn_allocator, http1ErrorReason(err));
                         continue;
+                    };
+                    total_requests += served;
+                    requests_this_second += served;
+                    if (!flushQueuedWrite(&io, conn, &buffer_pool)) {
+                        closeConnection(&io, decoded.fd, &connections, &buffer_pool, conn_allocator, "no SQE for write");
+                    }
+                },
+                .timer => {
+                    const now: i64 = @intCast(std.time.nanoTimestamp());
+                    var expired = timers.advance(timerTick(now));
+                    while (expired) |node| {
+                        expired = node.next;
+                        const conn: *Connection = @fieldParentPtr("timer", node);
+                        if (!conn.in_use or conn.closing) continue;
+
+                        // Deadlines only move later with activity: re-check at the new one
+                        const conn_deadline = conn.deadline();
+                        if (now < conn_deadline) {
+                            timers.schedule(node, timerTick(conn_deadline) + 1);
+                            continue;
+                        }
+                        std.log.debug("Closing connection {} ({s})", .{ conn.fd, conn.timeoutReason(now) });
+                        closeConnection(&io, conn.fd, &connections, &buffer_pool, conn_allocator, conn.timeoutReason(now));
                     }
 
-                    total_requests += 1;
-                    requests_this_second += 1;
-                }
-                // Note: TLS connections already incremented counters above
-
-                // Parse HTTP request (zero-allocation - all slices point into read_buf)
-                // For TLS: use effective_bytes (set to decrypted_len above), for plaintext: use bytes_read
-                const request_data = read_buf[0..effective_bytes];
-                const parsed_request = http.parseRequest(request_data) catch {
-                    // Invalid request - send 400 Bad Request
-                    const write_buf = buffer_pool.acquireWrite() orelse {
-                        _ = c.close(client_fd);
+                    if (!armTimer(&io, &timer_ts)) {
+                        std.log.err("Worker {}: failed to re-arm timer", .{worker_id});
+                    }
+                },
+                .recv => {
+                    const client_fd = decoded.fd;
+                    const has_buffer = (cqe_flags & c.IORING_CQE_F_BUFFER) != 0;
+
+                    const conn = connections.get(client_fd, decoded.generation) orelse {
+                        // Completion for a connection we no longer track
+                        if (has_buffer) recv_buffers.recycle(cqeBufferId(cqe_flags));
                         continue;
                     };
+                    if (!more) conn.recv_armed = false;
 
-                    const response = http.CommonResponses.BAD_REQUEST;
-                    if (write_buf.len >= response.len) {
-                        @memcpy(write_buf[0..response.len], response);
-                    } else {
-                        buffer_pool.releaseWrite(write_buf);
-                        _ = c.close(client_fd);
+                    // Connection is shutting down: drop data, finish the close on the final CQE
+                    if (conn.closing) {
+                        if (has_buffer) recv_buffers.recycle(cqeBufferId(cqe_flags));
+                        if (!more) closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "recv drained");
                         continue;
                     }
 
-                    if (connections.getPtr(client_fd)) |conn_ptr| {
-                        conn_ptr.write_buffer = write_buf;
-                    }
+                    const rx_install_pending = if (conn.tls_session) |session| session.rx_install_pending else false;
 
-                    const sqe_opt2 = blitz_io_uring_get_sqe(&ring);
-                    if (sqe_opt2 == null) {
-                        buffer_pool.releaseRead(read_buf);
-                        continue;
-                    }
-                    sqe = sqe_opt2.?;
-                    // For TLS, encrypt before writing
-                    if (conn.is_tls) {
-                        if (conn.tls_conn) |tls_conn_opaque| {
-                            const tls_conn = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque)));
-                            // CRITICAL: Release read buffer before encrypting/writing
-                            buffer_pool.releaseRead(read_buf);
-                            conn.read_buffer = null;
-
-                            _ = tls_conn.write(write_buf[0..response.len]) catch |err| {
-                                std.log.warn("TLS write failed: {}", .{err});
-                                buffer_pool.releaseWrite(write_buf);
-                                closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "TLS write failed");
-                                continue;
-                            };
-                            // CRITICAL: Must read all encrypted output to prevent incomplete TLS records
-                            const encrypted_len = tls_conn.getAllEncryptedOutput(write_buf) catch |err| {
-                                std.log.warn("Failed to get TLS encrypted output: {}", .{err});
-                                buffer_pool.releaseWrite(write_buf);
-                                closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "getEncryptedOutput failed");
-                                continue;
-                            };
-                            c.io_uring_prep_write(sqe, client_fd, write_buf.ptr, @as(c_uint, @intCast(encrypted_len)), 0);
+                    if (res < 0) {
+                        if (!more and rx_install_pending and (res == -c.ECANCELED or res == -c.ENOBUFS)) {
+                            // Stopped for the kTLS RX install; everything before it has been decrypted
+                            if (resumeRecvAfterRxInstall(&io, conn, conn.tls_session.?)) |reason| {
+                                closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, reason);
+                            }
+                        } else if (res == -c.ENOBUFS and !more) {
+                            // Every provided buffer is busy - re-arm, they're recycled at the end of each CQE
+                            if (armRecv(&io, conn)) {
+                                conn.recv_armed = true;
+                            } else {
+                                closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "no SQE for recv");
+                            }
                         } else {
-                            c.io_uring_prep_write(sqe, client_fd, write_buf.ptr, @as(c_uint, @intCast(response.len)), 0);
+                            closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "recv error");
                         }
-                    } else {
-                        c.io_uring_prep_write(sqe, client_fd, write_buf.ptr, @as(c_uint, @intCast(response.len)), 0);
+                        continue;
                     }
-                    setSqeData(sqe, encodeUserData(client_fd, .write));
-                    _ = c.io_uring_submit(&ring);
-                    buffer_pool.releaseRead(read_buf);
-                    continue;
-                };
 
-                // Generate response based on parsed request
-                const write_buf = buffer_pool.acquireWrite() orelse {
-                    _ = c.close(client_fd);
-                    continue;
-                };
-
-                var response: []const u8 = http.CommonResponses.NOT_FOUND;
-                var response_len: usize = http.CommonResponses.NOT_FOUND.len;
-
-                // Route based on path
-                // /hello is optimized for benchmarking (fastest path)
-                if (std.mem.eql(u8, parsed_request.path, "/hello")) {
-                    response = http.CommonResponses.HELLO;
-                    response_len = http.CommonResponses.HELLO.len;
-                } else if (std.mem.eql(u8, parsed_request.path, "/") or std.mem.eql(u8, parsed_request.path, "/health")) {
-                    // Root or health check endpoint
-                    response = http.CommonResponses.OK;
-                    response_len = http.CommonResponses.OK.len;
-                } else if (std.mem.startsWith(u8, parsed_request.path, "/echo")) {
-                    // Echo endpoint - return the path as plain text
-                    // Format: "HTTP/1.1 200 OK\r\nContent-Length: X\r\nConnection: keep-alive\r\n\r\n{path}"
-                    const echo_body = parsed_request.path;
-
-                    // Manually construct response for echo (simpler and faster)
-                    var pos: usize = 0;
-                    const status_line = "HTTP/1.1 200 OK\r\n";
-                    @memcpy(write_buf[pos..][0..status_line.len], status_line);
-                    pos += status_line.len;
-
-                    const content_type_header = "Content-Type: text/plain\r\n";
-                    @memcpy(write_buf[pos..][0..content_type_header.len], content_type_header);
-                    pos += content_type_header.len;
-
-                    const content_length_header = std.fmt.bufPrint(write_buf[pos..], "Content-Length: {}\r\n", .{echo_body.len}) catch {
-                        buffer_pool.releaseWrite(write_buf);
-                        _ = c.close(client_fd);
+                    if (res == 0) {
+                        closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "client closed");
                         continue;
-                    };
-                    pos += content_length_header.len;
-
-                    const connection_header = "Connection: keep-alive\r\n\r\n";
-                    @memcpy(write_buf[pos..][0..connection_header.len], connection_header);
-                    pos += connection_header.len;
+                    }
 
-                    @memcpy(write_buf[pos..][0..echo_body.len], echo_body);
-                    pos += echo_body.len;
+                    const bid = cqeBufferId(cqe_flags);
+                    defer recv_buffers.recycle(bid);
+                    const request_data = recv_buffers.get(bid)[0..@as(usize, @intCast(res))];
 
-                    response = write_buf[0..pos];
-                    response_len = pos;
-                } else {
-                    // Not found
-                    response = http.CommonResponses.NOT_FOUND;
-                    response_len = http.CommonResponses.NOT_FOUND.len;
-                }
+                    // The kernel can end a multishot recv (e.g. CQ overflow) - keep it armed.
+                    // A pending kTLS RX install re-arms below, once this data is decrypted.
+                    if (!more and !rx_install_pending) {
+                        if (armRecv(&io, conn)) {
+                            conn.recv_armed = true;
+                        } else {
+                            closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "no SQE for recv");
+                            continue;
+                        }
+                    }
 
-                // Copy response to write buffer
-                if (write_buf.len >= response_len) {
-                    @memcpy(write_buf[0..response_len], response);
-                } else {
-                    buffer_pool.releaseWrite(write_buf);
-                    _ = c.close(client_fd);
-                    continue;
-                }
+                    const now: i64 = @intCast(std.time.nanoTimestamp());
+                    conn.last_active = now;
 
-                // Submit write
-                const sqe_opt6 = blitz_io_uring_get_sqe(&ring);
-                if (sqe_opt6 == null) {
-                    buffer_pool.releaseWrite(write_buf);
-                    _ = c.close(client_fd);
-                    continue;
-                }
-                sqe = sqe_opt6.?;
-
-                // For TLS connections, encrypt the response using memory BIOs
-                if (conn.is_tls) {
-                    if (conn.tls_conn) |tls_conn_opaque| {
-                        const tls_conn = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque)));
-                        // CRITICAL: Release read buffer before encrypting/writing
-                        // Don't reuse the buffer that contained encrypted request data
-                        // This prevents BIO state issues and "bad record mac" errors
-                        buffer_pool.releaseRead(read_buf);
-                        conn.read_buffer = null;
-
-                        // Encrypt response (puts encrypted data in write_bio)
-                        _ = tls_conn.write(write_buf[0..response_len]) catch |err| {
-                            std.log.warn("TLS write failed: {}", .{err});
-                            buffer_pool.releaseWrite(write_buf);
-                            closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "TLS write failed");
+                    const served = if (conn.tls_session) |session|
+                        serveTls(&io, conn, session, &buffer_pool, request_data) catch |err| {
+                            closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, tlsErrorReason(err));
                             continue;
-                        };
-
-                        // Get ALL encrypted output from write_bio
-                        // CRITICAL: Must read all data to prevent incomplete TLS records and "bad record mac" errors
-                        const encrypted_len = tls_conn.getAllEncryptedOutput(write_buf) catch |err| {
-                            std.log.warn("Failed to get TLS encrypted output: {}", .{err});
-                            buffer_pool.releaseWrite(write_buf);
-                            closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "getEncryptedOutput failed");
+                        }
+                    else
+                        serveHttp1(conn, &buffer_pool, request_data) catch |err| {
+                            closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, http1ErrorReason(err));
                             continue;
                         };
+                    total_requests += served;
+                    requests_this_second += served;
 
-                        if (encrypted_len == 0) {
-                            std.log.warn("TLS encryption produced no output", .{});
-                            buffer_pool.releaseWrite(write_buf);
-                            closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no encrypted output");
+                    if (!more and rx_install_pending) {
+                        if (resumeRecvAfterRxInstall(&io, conn, conn.tls_session.?)) |reason| {
+                            closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, reason);
                             continue;
                         }
-
-                        // Write encrypted data via io_uring
-                        c.io_uring_prep_write(sqe, client_fd, write_buf.ptr, @as(c_uint, @intCast(encrypted_len)), 0);
-                    } else {
-                        // TLS connection not available, use plain write
-                        c.io_uring_prep_write(sqe, client_fd, write_buf.ptr, @as(c_uint, @intCast(response_len)), 0);
                     }
-                } else {
-                    // Plain HTTP/1.1 write - can reuse read buffer for keep-alive
-                    c.io_uring_prep_write(sqe, client_fd, write_buf.ptr, @as(c_uint, @intCast(response_len)), 0);
-                }
 
-                // Only assign write_buffer after successfully obtaining SQE and completing all preparation
-                if (connections.getPtr(client_fd)) |conn_ptr| {
-                    conn_ptr.write_buffer = write_buf;
-                }
+                    // Trickled headers keep last_active fresh, so a partial request gets its own deadline
+                    if (conn.pending_len == 0) {
+                        conn.request_started_at = 0;
+                    } else if (conn.request_started_at == 0) {
+                        conn.request_started_at = now;
+                    }
 
-                setSqeData(sqe, encodeUserData(client_fd, .write));
-                _ = c.io_uring_submit(&ring);
-            },
-            .write => {
-                // After write completes, release write buffer and prepare next read for keep-alive
-                const client_fd = decoded.fd;
-
-                // Get connection - check if it still exists
-                const conn_opt = connections.getPtr(client_fd);
-                if (conn_opt == null) {
-                    // Connection already closed - just close the fd
-                    _ = c.close(client_fd);
-                    continue;
-                }
-                const conn = conn_opt.?;
-
-                // CRITICAL: For TLS connections, clear write BIO BEFORE releasing buffer
-                // This prevents "bad record mac" errors when buffers are reused
-                // OpenSSL's memory BIOs maintain pointers to the buffer - we must clear them first
-                if (conn.is_tls) {
-                    if (conn.tls_conn) |tls_conn_opaque| {
-                        const tls_conn = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque)));
-                        tls_conn.clearEncryptedOutput();
+                    if (!flushQueuedWrite(&io, conn, &buffer_pool)) {
+                        closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "no SQE for write");
+                        continue;
                     }
-                }
 
-                // Release write buffer back to pool (after clearing encrypted output)
-                if (conn.write_buffer) |buf| {
-                    buffer_pool.releaseWrite(buf);
-                    conn.write_buffer = null;
-                }
+                    // Handshake finished without leaving anything to send
+                    if (conn.tls_session) |session| {
+                        if (ktlsReady(conn, session)) {
+                            if (startKtls(&io, conn, session)) |reason| {
+                                closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, reason);
+                            }
+                        }
+                    }
+                },
+                .write => {
+                    // After write completes, release write buffer and flush queued responses
+                    const client_fd = decoded.fd;
+
+                    // Connection already closed (and possibly the fd reused) - nothing to do
+                    const conn_opt = connections.get(client_fd, decoded.generation);
+                    if (conn_opt == null) {
+                        continue;
+                    }
+                    const conn = conn_opt.?;
 
-                // For TLS connections, ensure read buffer is fresh (should already be null from read handler)
-                // For plain HTTP/1.1, we can reuse the read buffer
-                if (conn.is_tls) {
-                    // CRITICAL: Clear read_bio before getting a new read buffer
-                    // This prevents "bad record mac" errors from stale data in read_bio
-                    if (conn.tls_conn) |tls_conn_opaque| {
-                        const tls_conn = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque)));
-                        tls_conn.clearReadBio();
+                    // Release write buffer back to pool
+                    if (conn.write_buffer) |buf| {
+                        buffer_pool.releaseWrite(buf);
+                        conn.write_buffer = null;
                     }
-                    // TLS: Always use a fresh read buffer for each request
-                    // The previous read buffer was already released in the read handler
-                    if (conn.read_buffer) |old_buf| {
-                        // Shouldn't happen, but clean up just in case
-                        buffer_pool.releaseRead(old_buf);
-                        conn.read_buffer = null;
+
+                    if (conn.closing) continue;
+                    // The offload pool has the session; the step's completion carries on
+                    if (conn.handshake_job != null) continue;
+
+                    // The last handshake record is out: the kernel can take over from here
+                    if (conn.tls_session) |session| {
+                        if (ktlsReady(conn, session)) {
+                            if (startKtls(&io, conn, session)) |reason| {
+                                closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, reason);
+                                continue;
+                            }
+                        }
                     }
-                }
 
-                // Get fresh read buffer for next request
-                const fresh_read_buf = buffer_pool.acquireRead();
-                if (fresh_read_buf) |buf| {
-                    conn.read_buffer = buf; // Store fresh buffer
+                    // The head of a file response is out: splice its body before anything else.
+                    // File routes only run over TLS with kernel TX, where the socket encrypts the splice.
+                    const splice_ok = if (conn.tls_session) |session| session.kernelTx() else true;
+                    if (splice_ok and conn.file_send != null and conn.queued_write == null) {
+                        if (!submitSplice(&io, conn)) {
+                            closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "no SQE for splice");
+                        }
+                        continue;
+                    }
 
-                    const sqe_opt2 = blitz_io_uring_get_sqe(&ring);
-                    if (sqe_opt2 == null) {
-                        buffer_pool.releaseRead(buf);
-                        closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no SQE for keep-alive read");
+                    // The multishot recv stays armed: answer pipelined requests that were waiting
+                    // for queue space, then flush what was queued (through the record layer for
+                    // userspace TLS)
+                    const served = serveHttp1(conn, &buffer_pool, &.{}) catch |err| {
+                        closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, http1ErrorReason(err));
                         continue;
+                    };
+                    total_requests += served;
+                    requests_this_second += served;
+                    if (!flushQueuedWrite(&io, conn, &buffer_pool)) {
+                        closeConnection(&io, client_fd, &connections, &buffer_pool, conn_allocator, "no SQE for write");
                     }
-                    const read_sqe = sqe_opt2.?;
-                    c.io_uring_prep_read(read_sqe, client_fd, buf.ptr, @as(c_uint, @intCast(BUFFER_SIZE)), 0);
-                    setSqeData(read_sqe, encodeUserData(client_fd, .read));
-                    _ = c.io_uring_submit(&ring);
-                } else {
-                    // No buffers available - close connection
-                    closeConnection(client_fd, &connections, &buffer_pool, backing_allocator, "no read buffer available");
-                }
-            },
+                },
+            }
         }
 
-        // Print stats and cleanup idle connections every second
+        // Print stats every second (idle/age limits are enforced by the timer wheel)
         const now: i64 = @intCast(std.time.nanoTimestamp());
         if (now - last_stats_time >= std.time.ns_per_s) {
             const rps = requests_this_second;
-            std.log.info("Connections: {}, Total Requests: {}, RPS: {}", .{ connection_count, total_requests, rps });
+            const syscalls = io.syscalls - syscalls_at_last_stats;
+            const syscalls_per_request: f64 = if (rps > 0) @as(f64, @floatFromInt(syscalls)) / @as(f64, @floatFromInt(rps)) else 0;
+            std.log.info("Worker {}: Connections: {}, Total Requests: {}, RPS: {}, Syscalls/req: {d:.3}, Ring: {s}", .{ worker_id, connections.live, total_requests, rps, syscalls_per_request, @tagName(mode) });
+            if (tls_context) |*tls_ctx| {
+                std.log.info("Worker {}: TLS connections by record mode: userspace {}, kTLS tx {}, kTLS tx+rx {}; handshakes: full {}, resumed {}", .{
+                    worker_id,
+                    io.tls_modes.get(.userspace),
+                    io.tls_modes.get(.ktls_tx),
+                    io.tls_modes.get(.ktls),
+                    io.tls_full_handshakes,
+                    io.tls_resumed_handshakes,
+                });
+                // Shared by all workers: reported once
+                if (worker_id == 0 and tls_ctx.resumption.mode != .off) {
+                    const resumption = tls_ctx.resumption.stats();
+                    std.log.info("TLS session resumption ({s}): hits {}, misses {}", .{
+                        @tagName(tls_ctx.resumption.mode),
+                        resumption.hits.load(.monotonic),
+                        resumption.misses.load(.monotonic),
+                    });
+                }
+            }
             requests_this_second = 0;
+            syscalls_at_last_stats = io.syscalls;
             last_stats_time = now;
+        }
+    }
+}
 
-            // Cleanup idle and expired connections
-            var it = connections.iterator();
-            while (it.next()) |entry| {
-                const conn = entry.value_ptr;
-                const idle_time = now - conn.last_active;
-                const age = now - conn.created_at;
-
-                // Close idle connections
-                if (idle_time > Connection.IDLE_TIMEOUT_NS) {
-                    std.log.debug("Closing idle connection {} (idle: {}s)", .{ entry.key_ptr.*, @divTrunc(idle_time, std.time.ns_per_s) });
-                    if (conn.read_buffer) |buf| {
-                        buffer_pool.releaseRead(buf);
-                    }
-                    if (conn.write_buffer) |buf| {
-                        buffer_pool.releaseWrite(buf);
-                    }
-                    if (conn.tls_conn) |tls_conn_opaque| {
-                        const tls_conn = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque)));
-                        tls_conn.deinit();
-                    }
-                    if (conn.http2_conn) |http2_conn| {
-                        http2_conn.deinit();
-                        backing_allocator.destroy(http2_conn);
-                    }
-                    _ = c.close(entry.key_ptr.*);
-                    _ = connections.remove(entry.key_ptr.*);
-                    connection_count = if (connection_count > 0) connection_count - 1 else 0;
-                }
-                // Close expired connections (max age)
-                else if (age > Connection.MAX_CONNECTION_AGE_NS) {
-                    std.log.debug("Closing expired connection {} (age: {}s)", .{ entry.key_ptr.*, @divTrunc(age, std.time.ns_per_s) });
-                    if (conn.read_buffer) |buf| {
-                        buffer_pool.releaseRead(buf);
-                    }
-                    if (conn.write_buffer) |buf| {
-                        buffer_pool.releaseWrite(buf);
-                    }
-                    if (conn.tls_conn) |tls_conn_opaque| {
-                        const tls_conn = @as(*TlsConnectionStub, @ptrFromInt(@intFromPtr(tls_conn_opaque)));
-                        tls_conn.deinit();
-                    }
-                    if (conn.http2_conn) |http2_conn| {
-                        http2_conn.deinit();
-                        backing_allocator.destroy(http2_conn);
-                    }
-                    _ = c.close(entry.key_ptr.*);
-                    _ = connections.remove(entry.key_ptr.*);
-                    connection_count = if (connection_count > 0) connection_count - 1 else 0;
-                }
+// Drains one end of the socket pair the splice test writes to
+fn readAll(fd: c_int, out: []u8) void {
+    var got: usize = 0;
+    while (got < out.len) {
+        const n = std.posix.read(fd, out[got..]) catch return;
+        if (n == 0) return;
+        got += n;
+    }
+}
+
+test "unaligned range is spliced whole even when a linked chunk comes up short" {
+    var test_ring: c.struct_io_uring = undefined;
+    if (c.io_uring_queue_init(16, &test_ring, 0) < 0) return error.SkipZigTest;
+    defer c.io_uring_queue_exit(&test_ring);
+    var io = WorkerIo{ .ring = &test_ring };
+
+    const gpa = std.testing.allocator;
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const content = try gpa.alloc(u8, 200 * 1024);
+    defer gpa.free(content);
+    for (content, 0..) |*byte, i| byte.* = @truncate(i *% 31);
+    try tmp.dir.writeFile(.{ .sub_path = "range.bin", .data = content });
+    var root_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const root = try tmp.dir.realpath(".", &root_buf);
+
+    // Starting mid-page, a 64 KiB chunk spans 17 pages and overflows a
+    // 16-page pipe, so the linked file -> pipe splice returns short
+    var files = static_files.FileCache.init(gpa);
+    defer files.deinit();
+    const request = try http.parseRequest("GET /files/range.bin HTTP/1.1\r\nRange: bytes=1000-\r\n\r\n");
+    var head_buf: [1024]u8 = undefined;
+    var head = http_response.ResponseBuilder.init(&head_buf);
+    const body = try static_files.buildResponse(&files, root, "range.bin", &request, &head);
+    try std.testing.expect(std.mem.startsWith(u8, head_buf[0..head.len], "HTTP/1.1 206"));
+    try std.testing.expectEqual(@as(u64, 1000), body.offset);
+
+    var sv: [2]c_int = undefined;
+    try std.testing.expectEqual(@as(c_int, 0), c.socketpair(c.AF_UNIX, c.SOCK_STREAM, 0, &sv));
+    defer _ = c.close(sv[1]);
+    const received = try gpa.alloc(u8, body.length);
+    defer gpa.free(received);
+    const reader = try std.Thread.spawn(.{}, readAll, .{ sv[1], received });
+    // EOF lets the reader finish if the test bails out early
+    errdefer {
+        _ = c.close(sv[0]);
+        reader.join();
+    }
+
+    var conn = Connection{ .fd = sv[0] };
+    conn.file_send = .{ .entry = body.entry.?, .offset = body.offset, .end = body.offset + body.length };
+    try std.testing.expect(submitSplice(&io, &conn));
+
+    var cqes: [8]?*c.struct_io_uring_cqe = undefined;
+    var complete = false;
+    while (!complete) {
+        _ = c.io_uring_submit_and_wait(&test_ring, 1);
+        const count = blitz_io_uring_peek_batch_cqe(&test_ring, &cqes, cqes.len);
+        defer blitz_io_uring_cq_advance(&test_ring, count);
+        for (cqes[0..count]) |cqe_opt| {
+            const cqe = cqe_opt.?;
+            const op = decodeUserData(cqe.user_data).op;
+            // The event loop closes on these before the splice handlers see them
+            if (op == .splice_in and cqe.res < 0) return error.SpliceFailed;
+            const progress = if (op == .splice_in) spliceInDone(&io, &conn, cqe.res) else spliceOutDone(&io, &conn, cqe.res);
+            switch (progress) {
+                .in_flight => {},
+                .complete => complete = true,
+                .failed => |reason| {
+                    std.log.err("splice failed: {s}", .{reason});
+                    return error.SpliceFailed;
+                },
             }
         }
     }
+    _ = c.close(sv[0]);
+    reader.join();
+    files.release(conn.file_send.?.entry);
+    _ = c.close(conn.splice_pipe[0]);
+    _ = c.close(conn.splice_pipe[1]);
+
+    try std.testing.expectEqualSlices(u8, content[1000..], received);
 }
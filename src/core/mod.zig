@@ -5,3 +5,4 @@ pub const allocator = @import("allocator.zig");
 pub const io_uring = @import("io_uring.zig");
 pub const graceful_reload = @import("graceful_reload.zig");
 pub const protocol = @import("protocol.zig");
+pub const timer_wheel = @import("timer_wheel.zig");
@@ -0,0 +1,156 @@
+//! Hierarchical timing wheel for per-connection deadlines
+//!
+//! Four levels of 64 slots. A timer lands in the lowest level whose span covers
+//! its distance from the current tick; when a lower level wraps, the matching
+//! slot of the level above is cascaded down. Scheduling, cancelling and expiring
+//! a timer are O(1), and the wheel is advanced one tick at a time by a single
+//! io_uring timeout per worker - there are no per-connection kernel timers.
+//!
+//! Nodes are intrusive (embedded in the owning struct, recovered with
+//! @fieldParentPtr) and remember which slot list they are on, so a node can be
+//! cancelled without a reference to its wheel.
+
+const std = @import("std");
+
+pub const TimerWheel = struct {
+    const SLOT_BITS = 6;
+    const SLOTS = 1 << SLOT_BITS;
+    const SLOT_MASK: u64 = SLOTS - 1;
+    const LEVELS = 4;
+
+    /// Furthest a timer can be scheduled ahead; later deadlines are clamped and simply re-checked
+    pub const MAX_TICKS: u64 = (1 << (SLOT_BITS * LEVELS)) - 1;
+
+    pub const Node = struct {
+        prev: ?*Node = null,
+        next: ?*Node = null,
+        // Head of the slot list this node is on, null when not scheduled
+        head: ?*?*Node = null,
+        expires: u64 = 0,
+
+        pub fn isScheduled(self: *const Node) bool {
+            return self.head != null;
+        }
+
+        pub fn cancel(self: *Node) void {
+            const head = self.head orelse return;
+            if (self.prev) |prev| {
+                prev.next = self.next;
+            } else {
+                head.* = self.next;
+            }
+            if (self.next) |next| next.prev = self.prev;
+            self.prev = null;
+            self.next = null;
+            self.head = null;
+        }
+    };
+
+    slots: [LEVELS][SLOTS]?*Node = [_][SLOTS]?*Node{[_]?*Node{null} ** SLOTS} ** LEVELS,
+    current: u64,
+
+    pub fn init(now_tick: u64) TimerWheel {
+        return TimerWheel{ .current = now_tick };
+    }
+
+    /// (Re)schedule node to expire at the given tick; past ticks expire on the next advance
+    pub fn schedule(self: *TimerWheel, node: *Node, expires_tick: u64) void {
+        node.cancel();
+        node.expires = @max(expires_tick, self.current + 1);
+        if (node.expires - self.current > MAX_TICKS) node.expires = self.current + MAX_TICKS;
+        self.insert(node);
+    }
+
+    fn insert(self: *TimerWheel, node: *Node) void {
+        const delta = node.expires - self.current;
+        var level: usize = 0;
+        while (level < LEVELS - 1 and delta >= (@as(u64, 1) << @intCast(SLOT_BITS * (level + 1)))) {
+            level += 1;
+        }
+        const index: usize = @intCast((node.expires >> @intCast(SLOT_BITS * level)) & SLOT_MASK);
+        const head = &self.slots[level][index];
+
+        node.prev = null;
+        node.next = head.*;
+        if (head.*) |first| first.prev = node;
+        head.* = node;
+        node.head = head;
+    }
+
+    /// Advance to now_tick and return the expired timers as a list linked through
+    /// `next`. The nodes are already unscheduled; read `next` before rescheduling one.
+    pub fn advance(self: *TimerWheel, now_tick: u64) ?*Node {
+        var expired: ?*Node = null;
+        while (self.current < now_tick) {
+            self.current += 1;
+
+            // Cascade higher levels whose index just wrapped, top-down
+            var level: usize = LEVELS - 1;
+            while (level > 0) : (level -= 1) {
+                const lower_bits: u6 = @intCast(SLOT_BITS * level);
+                if (self.current & ((@as(u64, 1) << lower_bits) - 1) == 0) {
+                    const index: usize = @intCast((self.current >> lower_bits) & SLOT_MASK);
+                    self.cascade(level, index);
+                }
+            }
+
+            // Everything left in the current level-0 slot is due
+            const slot = &self.slots[0][@intCast(self.current & SLOT_MASK)];
+            while (slot.*) |node| {
+                node.cancel();
+                node.next = expired;
+                expired = node;
+            }
+        }
+        return expired;
+    }
+
+    fn cascade(self: *TimerWheel, level: usize, index: usize) void {
+        var list = self.slots[level][index];
+        self.slots[level][index] = null;
+        while (list) |node| {
+            list = node.next;
+            node.prev = null;
+            node.next = null;
+            node.head = null;
+            self.insert(node);
+        }
+    }
+};
+
+test "timer expires at its tick" {
+    var wheel = TimerWheel.init(0);
+    var node = TimerWheel.Node{};
+    wheel.schedule(&node, 5);
+
+    try std.testing.expect(wheel.advance(4) == null);
+    try std.testing.expect(wheel.advance(5) == &node);
+    try std.testing.expect(!node.isScheduled());
+}
+
+test "timers cascade from higher levels" {
+    var wheel = TimerWheel.init(10);
+    var near = TimerWheel.Node{};
+    var far = TimerWheel.Node{};
+    wheel.schedule(&near, 70);
+    wheel.schedule(&far, 5000);
+
+    try std.testing.expect(wheel.advance(69) == null);
+    try std.testing.expect(wheel.advance(70) == &near);
+    try std.testing.expect(wheel.advance(4999) == null);
+    try std.testing.expect(wheel.advance(5000) == &far);
+}
+
+test "cancelled and rescheduled timers" {
+    var wheel = TimerWheel.init(0);
+    var a = TimerWheel.Node{};
+    var b = TimerWheel.Node{};
+    wheel.schedule(&a, 3);
+    wheel.schedule(&b, 3);
+    a.cancel();
+    wheel.schedule(&b, 8);
+
+    try std.testing.expect(wheel.advance(7) == null);
+    try std.testing.expect(wheel.advance(8) == &b);
+    try std.testing.expect(b.next == null);
+}
@@ -1,8 +1,10 @@
 const std = @import("std");
+const builtin = @import("builtin");
+const response = @import("response.zig");
 
 // HTTP/1.1 Request Parser
 // Zero-allocation parser that works on pre-allocated buffers
-// Optimized for speed - no heap allocations, SIMD-ready structure
+// Optimized for speed - no heap allocations, token boundaries found with SIMD
 
 // Request validation limits (DoS protection)
 const MAX_REQUEST_SIZE: usize = 16 * 1024; // 16KB max request size
@@ -10,6 +12,75 @@ const MAX_HEADERS: usize = 100; // Max 100 headers
 const MAX_PATH_LENGTH: usize = 8192; // 8KB max path length
 const MAX_HEADER_NAME_LENGTH: usize = 256; // Max header name length
 const MAX_HEADER_VALUE_LENGTH: usize = 8192; // Max header value length
+const MAX_CHUNK_LINE_LENGTH: usize = 1024; // Chunk size line, including extensions
+const MAX_TRAILER_SIZE: usize = 8192; // Total trailer section of a chunked body
+
+// Bytes classified per scanner step, picked for the target at comptime:
+// 64 with AVX-512BW, 32 with AVX2, 16 for SSE2 and NEON, scalar otherwise
+pub const VECTOR_LEN: usize = switch (builtin.cpu.arch) {
+    .x86_64, .x86 => if (std.Target.x86.featureSetHas(builtin.cpu.features, .avx512bw))
+        64
+    else if (std.Target.x86.featureSetHas(builtin.cpu.features, .avx2))
+        32
+    else
+        16,
+    .aarch64, .aarch64_be => 16,
+    .arm, .armeb => if (std.Target.arm.featureSetHas(builtin.cpu.features, .neon)) 16 else 0,
+    else => 0,
+};
+
+// Find the first byte at or after start that is one of `stops` or, when validating,
+// a control character other than HTAB (never allowed in a request or header line).
+// vector_len 0 is the byte-at-a-time path, kept for targets without SIMD and for benchmarks.
+fn scanUntil(comptime vector_len: usize, buffer: []const u8, start: usize, comptime stops: []const u8, comptime validate: bool) ?usize {
+    var i = start;
+    if (vector_len > 0) {
+        const Vec = @Vector(vector_len, u8);
+        const Mask = std.meta.Int(.unsigned, vector_len);
+        while (i + vector_len <= buffer.len) : (i += vector_len) {
+            const chunk: Vec = buffer[i..][0..vector_len].*;
+            var hits: Mask = 0;
+            inline for (stops) |stop| {
+                hits |= @bitCast(chunk == @as(Vec, @splat(stop)));
+            }
+            if (validate) {
+                const control: Mask = @bitCast(chunk < @as(Vec, @splat(0x20)));
+                const tab: Mask = @bitCast(chunk == @as(Vec, @splat('\t')));
+                const del: Mask = @bitCast(chunk == @as(Vec, @splat(0x7f)));
+                hits |= (control & ~tab) | del;
+            }
+            if (hits != 0) return i + @ctz(hits);
+        }
+    }
+    while (i < buffer.len) : (i += 1) {
+        const byte = buffer[i];
+        inline for (stops) |stop| {
+            if (byte == stop) return i;
+        }
+        if (validate and ((byte < 0x20 and byte != '\t') or byte == 0x7f)) return i;
+    }
+    return null;
+}
+
+// End of the line starting at start (index of its CR), validating its bytes on the way
+fn lineEnd(comptime vector_len: usize, buffer: []const u8, start: usize) !?usize {
+    const end = scanUntil(vector_len, buffer, start, "\r", true) orelse return null;
+    if (buffer[end] != '\r') return error.InvalidCharacter;
+    if (end + 1 >= buffer.len) return null;
+    if (buffer[end + 1] != '\n') return error.InvalidLineEnding;
+    return end;
+}
+
+// Index of the blank line ending the header block ("\r\n\r\n") at or after start, or null
+fn headersEnd(comptime vector_len: usize, buffer: []const u8, start: usize) ?usize {
+    var pos = start;
+    while (scanUntil(vector_len, buffer, pos, "\r", false)) |cr| {
+        if (cr + 4 > buffer.len) return null;
+        if (std.mem.eql(u8, buffer[cr..][0..4], "\r\n\r\n")) return cr;
+        pos = cr + 1;
+    }
+    return null;
+}
 
 pub const Method = enum {
     GET,
@@ -36,16 +107,78 @@ pub const Header = struct {
     value: []const u8,
 };
 
+// Headers the gateway itself looks at. The parser resolves these while it scans,
+// so reading one is an array index instead of a case-insensitive search.
+// Wire names are derived from the tags ('_' becomes '-').
+pub const KnownHeader = enum {
+    host,
+    content_length,
+    content_type,
+    transfer_encoding,
+    connection,
+    upgrade,
+    expect,
+    authorization,
+    cookie,
+    accept,
+    accept_encoding,
+    user_agent,
+    x_forwarded_for,
+    x_forwarded_proto,
+    x_request_id,
+    if_none_match,
+    if_modified_since,
+    range,
+
+    pub fn name(comptime self: KnownHeader) []const u8 {
+        return comptime wireName(@tagName(self));
+    }
+
+    fn wireName(comptime tag: []const u8) []const u8 {
+        var buf: [tag.len]u8 = undefined;
+        for (tag, 0..) |ch, i| buf[i] = if (ch == '_') '-' else ch;
+        const final = buf;
+        return &final;
+    }
+
+    const map = blk: {
+        const fields = @typeInfo(KnownHeader).@"enum".fields;
+        var entries: [fields.len]struct { []const u8, KnownHeader } = undefined;
+        for (fields, 0..) |field, i| {
+            entries[i] = .{ wireName(field.name), @field(KnownHeader, field.name) };
+        }
+        break :blk std.StaticStringMapWithEql(KnownHeader, std.static_string_map.eqlAsciiIgnoreCase).initComptime(entries);
+    };
+
+    pub fn lookup(header_name: []const u8) ?KnownHeader {
+        return map.get(header_name);
+    }
+};
+
 pub const Request = struct {
     method: Method,
     path: []const u8,
     version: Version,
-    headers: []Header,
+    // Stored inline so headers() stays valid wherever the request is copied to
+    header_storage: [MAX_HEADERS]Header = undefined,
+    header_count: u8 = 0,
+    // Value of the first occurrence of each known header
+    known: std.EnumArray(KnownHeader, ?[]const u8) = .initFill(null),
     body: []const u8,
     raw: []const u8, // Original request buffer
 
-    pub fn getHeader(self: Request, name: []const u8) ?[]const u8 {
-        for (self.headers) |header| {
+    pub fn headers(self: *const Request) []const Header {
+        return self.header_storage[0..self.header_count];
+    }
+
+    // O(1) lookup of a header the parser already resolved
+    pub fn get(self: *const Request, header: KnownHeader) ?[]const u8 {
+        return self.known.get(header);
+    }
+
+    pub fn getHeader(self: *const Request, name: []const u8) ?[]const u8 {
+        if (KnownHeader.lookup(name)) |known| return self.known.get(known);
+        for (self.headers()) |header| {
             if (std.ascii.eqlIgnoreCase(header.name, name)) {
                 return header.value;
             }
@@ -58,6 +191,23 @@ pub const Request = struct {
 // Returns parsed request or error
 // Zero-allocation: all slices point into the input buffer
 pub fn parseRequest(buffer: []const u8) !Request {
+    var request: Request = undefined;
+    try parseRequestInto(&request, buffer);
+    return request;
+}
+
+// Parse into a caller-owned Request. Request carries its headers inline, so the
+// per-request path fills one in place rather than copying it out of parseRequest.
+pub fn parseRequestInto(request: *Request, buffer: []const u8) !void {
+    return parseInto(VECTOR_LEN, request, buffer);
+}
+
+// Same parse one byte at a time, the baseline for the parser benchmark
+pub fn parseRequestScalar(request: *Request, buffer: []const u8) !void {
+    return parseInto(0, request, buffer);
+}
+
+fn parseInto(comptime vector_len: usize, request: *Request, buffer: []const u8) !void {
     // Validate request size (DoS protection)
     if (buffer.len > MAX_REQUEST_SIZE) {
         return error.RequestTooLarge;
@@ -67,11 +217,10 @@ pub fn parseRequest(buffer: []const u8) !Request {
         return error.EmptyRequest;
     }
 
-    var request = Request{
+    request.* = Request{
         .method = .UNKNOWN,
         .path = "",
         .version = .UNKNOWN,
-        .headers = &[_]Header{},
         .body = "",
         .raw = buffer,
     };
@@ -80,7 +229,7 @@ pub fn parseRequest(buffer: []const u8) !Request {
     const len = buffer.len;
 
     // Parse request line: "METHOD /path HTTP/1.1\r\n"
-    const request_line_end = std.mem.indexOf(u8, buffer, "\r\n") orelse return error.InvalidRequestLine;
+    const request_line_end = (try lineEnd(vector_len, buffer, 0)) orelse return error.InvalidRequestLine;
     const request_line = buffer[0..request_line_end];
     pos = request_line_end + 2;
 
@@ -110,7 +259,6 @@ pub fn parseRequest(buffer: []const u8) !Request {
 
     // Parse headers
     var header_count: usize = 0;
-    var headers: [MAX_HEADERS]Header = undefined;
 
     while (pos < len) {
         // Check for end of headers (empty line)
@@ -119,16 +267,21 @@ pub fn parseRequest(buffer: []const u8) !Request {
             break;
         }
 
-        // Find end of header line
-        const header_line_end = std.mem.indexOfPos(u8, buffer, pos, "\r\n") orelse break;
-        const header_line = buffer[pos..header_line_end];
+        // One pass finds the colon and validates the name, a second finds the line end
+        // and validates the value: "Name: Value\r\n"
+        const line_start = pos;
+        const colon_or_end = scanUntil(vector_len, buffer, pos, ":\r", true) orelse break;
+        if (buffer[colon_or_end] != ':') {
+            // Line without a colon: skip it
+            const header_line_end = (try lineEnd(vector_len, buffer, colon_or_end)) orelse break;
+            pos = header_line_end + 2;
+            continue;
+        }
+        const header_line_end = (try lineEnd(vector_len, buffer, colon_or_end + 1)) orelse break;
         pos = header_line_end + 2;
 
-        // Parse header: "Name: Value"
-        const colon_pos = std.mem.indexOfScalar(u8, header_line, ':') orelse continue;
-        const name = std.mem.trim(u8, header_line[0..colon_pos], " \t");
-        const value_start = colon_pos + 1;
-        const value = std.mem.trim(u8, header_line[value_start..], " \t");
+        const name = std.mem.trim(u8, buffer[line_start..colon_or_end], " \t");
+        const value = std.mem.trim(u8, buffer[colon_or_end + 1 .. header_line_end], " \t");
 
         // Validate header name and value lengths (DoS protection)
         if (name.len > MAX_HEADER_NAME_LENGTH) {
@@ -139,27 +292,218 @@ pub fn parseRequest(buffer: []const u8) !Request {
         }
 
         if (header_count < MAX_HEADERS) {
-            headers[header_count] = Header{
+            request.header_storage[header_count] = Header{
                 .name = name,
                 .value = value,
             };
             header_count += 1;
+
+            // Case-folded once here; the first occurrence wins, as with a linear search
+            if (KnownHeader.lookup(name)) |known| {
+                if (request.known.get(known)) |first| {
+                    // Except for framing: a repeat that disagrees with the first is how
+                    // requests get smuggled, so it is rejected instead of ignored
+                    switch (known) {
+                        .content_length => if (!std.mem.eql(u8, first, value)) return error.ConflictingFraming,
+                        .transfer_encoding => return error.UnsupportedTransferEncoding,
+                        else => {},
+                    }
+                } else request.known.set(known, value);
+            }
         } else {
             // Too many headers
             return error.TooManyHeaders;
         }
     }
 
-    request.headers = headers[0..header_count];
+    request.header_count = @intCast(header_count);
 
     // Parse body (if present)
     if (pos < len) {
         request.body = buffer[pos..];
     }
+}
 
-    return request;
+// 1*DIGIT (base 10) or 1*HEXDIG (base 16), nothing else. std.fmt.parseInt also
+// takes a sign and '_' separators, so "+10" and "1_0" would frame a body that a
+// stricter proxy in front of us reads differently.
+fn parseDigits(digits: []const u8, comptime base: u8) ?u64 {
+    if (digits.len == 0) return null;
+    var value: u64 = 0;
+    for (digits) |ch| {
+        const digit = std.fmt.charToDigit(ch, base) catch return null;
+        value = std.math.mul(u64, value, base) catch return null;
+        value = std.math.add(u64, value, digit) catch return null;
+    }
+    return value;
+}
+
+// RFC 9112 §6.3: a request body is chunked only when chunked is the final
+// transfer coding, applied once. Codings ahead of it ("gzip, chunked") stay on
+// the de-chunked body, which is passed through untouched.
+fn chunkedIsLast(codings: []const u8) bool {
+    var chunked_seen = false;
+    var elements = std.mem.splitScalar(u8, codings, ',');
+    while (elements.next()) |element| {
+        // Drop any ";param=value" after the coding name
+        const coding = std.mem.trim(u8, element[0 .. std.mem.indexOfScalar(u8, element, ';') orelse element.len], " \t");
+        // Empty list elements are allowed and carry nothing
+        if (coding.len == 0) continue;
+        if (chunked_seen) return false;
+        chunked_seen = std.ascii.eqlIgnoreCase(coding, "chunked");
+    }
+    return chunked_seen;
 }
 
+const BodyFraming = union(enum) {
+    none,
+    length: u64,
+    chunked,
+};
+
+// How the body following a parsed head is delimited. A request carrying both
+// Content-Length and Transfer-Encoding is rejected rather than guessed at, since
+// that disagreement is how requests get smuggled; repeats of either were already
+// checked by the parse.
+fn bodyFraming(request: *const Request) !BodyFraming {
+    const content_length = request.get(.content_length);
+    if (request.get(.transfer_encoding)) |codings| {
+        if (content_length != null) return error.ConflictingFraming;
+        if (!chunkedIsLast(codings)) return error.UnsupportedTransferEncoding;
+        return .chunked;
+    }
+    const value = content_length orelse return .none;
+    return .{ .length = parseDigits(value, 10) orelse return error.InvalidContentLength };
+}
+
+// Push-style request parser for bytes as they arrive from the socket.
+// feed() reports how much of its input it consumed and what it found; bytes
+// it didn't consume (part of a head or of a chunk-size line) must be fed again
+// together with whatever arrives next. Only the head is ever held back:
+// Content-Length and chunked bodies come out as .body events sliced from the
+// input, so an upload of any size streams through without being buffered and
+// MAX_REQUEST_SIZE only bounds the head.
+pub const RequestParser = struct {
+    state: State = .head,
+    // Bytes already searched for the end of the head, so a trickled head isn't rescanned
+    scanned: usize = 0,
+    // Body bytes left in the Content-Length body or the current chunk
+    remaining: u64 = 0,
+    trailer_len: usize = 0,
+
+    pub const State = enum {
+        head,
+        body,
+        chunk_size,
+        chunk_data,
+        chunk_end,
+        trailers,
+        done,
+    };
+
+    pub const Event = union(enum) {
+        // Everything usable was consumed; feed the rest again with more data
+        need_more,
+        // The consumed bytes are the complete head (request line and headers),
+        // already parsed into the Request passed to feed()
+        head: usize,
+        // Body bytes, de-chunked, sliced from the input
+        body: []const u8,
+        // The request is complete; the parser is ready for the next one
+        done,
+    };
+
+    pub const Progress = struct {
+        consumed: usize,
+        event: Event,
+    };
+
+    pub fn reset(self: *RequestParser) void {
+        self.* = .{};
+    }
+
+    pub fn feed(self: *RequestParser, input: []const u8, request: *Request) !Progress {
+        var pos: usize = 0;
+        while (true) {
+            switch (self.state) {
+                .head => {
+                    const end = headersEnd(VECTOR_LEN, input, self.scanned -| 3) orelse {
+                        if (input.len > MAX_REQUEST_SIZE) return error.RequestTooLarge;
+                        self.scanned = input.len;
+                        return .{ .consumed = 0, .event = .need_more };
+                    };
+                    const head_len = end + 4;
+                    if (head_len > MAX_REQUEST_SIZE) return error.RequestTooLarge;
+                    self.scanned = 0;
+                    try parseRequestInto(request, input[0..head_len]);
+                    switch (try bodyFraming(request)) {
+                        .none => self.state = .done,
+                        .length => |length| {
+                            self.remaining = length;
+                            self.state = if (length == 0) .done else .body;
+                        },
+                        .chunked => self.state = .chunk_size,
+                    }
+                    return .{ .consumed = head_len, .event = .{ .head = head_len } };
+                },
+                .body, .chunk_data => {
+                    if (pos == input.len) return .{ .consumed = pos, .event = .need_more };
+                    const n: usize = @intCast(@min(self.remaining, input.len - pos));
+                    self.remaining -= n;
+                    if (self.remaining == 0) {
+                        self.state = if (self.state == .body) .done else .chunk_end;
+                    }
+                    return .{ .consumed = pos + n, .event = .{ .body = input[pos..][0..n] } };
+                },
+                .chunk_size => {
+                    // "1a;ext=val\r\n"
+                    const line_end = std.mem.indexOfPos(u8, input, pos, "\r\n") orelse {
+                        if (input.len - pos > MAX_CHUNK_LINE_LENGTH) return error.InvalidChunk;
+                        return .{ .consumed = pos, .event = .need_more };
+                    };
+                    const line = input[pos..line_end];
+                    if (line.len > MAX_CHUNK_LINE_LENGTH) return error.InvalidChunk;
+                    const size_end = std.mem.indexOfScalar(u8, line, ';') orelse line.len;
+                    // Whitespace is only allowed ahead of an extension (BWS)
+                    const size = parseDigits(std.mem.trimRight(u8, line[0..size_end], " \t"), 16) orelse return error.InvalidChunk;
+                    pos = line_end + 2;
+                    if (size == 0) {
+                        self.state = .trailers;
+                    } else {
+                        self.remaining = size;
+                        self.state = .chunk_data;
+                    }
+                },
+                .chunk_end => {
+                    if (input.len - pos < 2) return .{ .consumed = pos, .event = .need_more };
+                    if (!std.mem.eql(u8, input[pos..][0..2], "\r\n")) return error.InvalidChunk;
+                    pos += 2;
+                    self.state = .chunk_size;
+                },
+                .trailers => {
+                    // Trailer fields are skipped; the section ends with an empty line
+                    const line_end = std.mem.indexOfPos(u8, input, pos, "\r\n") orelse {
+                        if (self.trailer_len + input.len - pos > MAX_TRAILER_SIZE) return error.RequestTooLarge;
+                        return .{ .consumed = pos, .event = .need_more };
+                    };
+                    const line_len = line_end - pos;
+                    pos = line_end + 2;
+                    if (line_len == 0) {
+                        self.state = .done;
+                    } else {
+                        self.trailer_len += line_len + 2;
+                        if (self.trailer_len > MAX_TRAILER_SIZE) return error.RequestTooLarge;
+                    }
+                },
+                .done => {
+                    self.reset();
+                    return .{ .consumed = pos, .event = .done };
+                },
+            }
+        }
+    }
+};
+
 fn parseMethod(method_str: []const u8) Method {
     if (std.mem.eql(u8, method_str, "GET")) return .GET;
     if (std.mem.eql(u8, method_str, "POST")) return .POST;
@@ -180,45 +524,47 @@ fn parseVersion(version_str: []const u8) Version {
     return .UNKNOWN;
 }
 
+// Reason phrase for a status line
+pub fn reasonPhrase(status_code: u16) []const u8 {
+    return switch (status_code) {
+        200 => "OK",
+        201 => "Created",
+        204 => "No Content",
+        206 => "Partial Content",
+        301 => "Moved Permanently",
+        302 => "Found",
+        304 => "Not Modified",
+        400 => "Bad Request",
+        401 => "Unauthorized",
+        403 => "Forbidden",
+        404 => "Not Found",
+        405 => "Method Not Allowed",
+        413 => "Content Too Large",
+        416 => "Range Not Satisfiable",
+        429 => "Too Many Requests",
+        500 => "Internal Server Error",
+        502 => "Bad Gateway",
+        503 => "Service Unavailable",
+        504 => "Gateway Timeout",
+        else => "Unknown",
+    };
+}
+
 // Format HTTP response (zero-allocation, uses provided buffer)
 pub fn formatResponse(buffer: []u8, status_code: u16, status_text: []const u8, headers: []const Header, body: []const u8) ![]u8 {
-    var pos: usize = 0;
-
-    // Status line: "HTTP/1.1 200 OK\r\n"
-    const status_line = try std.fmt.bufPrint(buffer[pos..], "HTTP/1.1 {} {s}\r\n", .{ status_code, status_text });
-    pos += status_line.len;
-
-    // Headers
+    var builder = response.ResponseBuilder.init(buffer);
+    try builder.statusWithReason(status_code, status_text);
     for (headers) |header| {
-        const header_line = try std.fmt.bufPrint(buffer[pos..], "{s}: {s}\r\n", .{ header.name, header.value });
-        pos += header_line.len;
-    }
-
-    // Content-Length header if body present
-    if (body.len > 0) {
-        const content_length = try std.fmt.bufPrint(buffer[pos..], "Content-Length: {}\r\n", .{body.len});
-        pos += content_length.len;
+        try builder.header(header.name, header.value);
     }
-
-    // Connection header
-    const connection = try std.fmt.bufPrint(buffer[pos..], "Connection: keep-alive\r\n", .{});
-    pos += connection.len;
-
-    // Empty line before body
-    buffer[pos] = '\r';
-    buffer[pos + 1] = '\n';
-    pos += 2;
-
-    // Body
     if (body.len > 0) {
-        if (pos + body.len > buffer.len) {
-            return error.BufferTooSmall;
-        }
-        @memcpy(buffer[pos..][0..body.len], body);
-        pos += body.len;
+        try builder.contentLength(body.len);
     }
-
-    return buffer[0..pos];
+    try builder.header("Connection", "keep-alive");
+    try builder.date();
+    try builder.end();
+    try builder.body(body);
+    return buffer[0..builder.len];
 }
 
 // Pre-formatted common responses (zero-allocation)
@@ -231,3 +577,157 @@ pub const CommonResponses = struct {
     pub const INTERNAL_ERROR = "HTTP/1.1 500 Internal Server Error\r\nContent-Type: text/plain\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
     pub const METHOD_NOT_ALLOWED = "HTTP/1.1 405 Method Not Allowed\r\nContent-Type: text/plain\r\nContent-Length: 0\r\nConnection: keep-alive\r\n\r\n";
 };
+
+test "RequestParser splits pipelined requests" {
+    var parsed: Request = undefined;
+    const pipelined = "GET /a HTTP/1.1\r\nHost: x\r\n\r\nPOST /b HTTP/1.1\r\nContent-Length: 3\r\n\r\nabcGET /c";
+    var parser = RequestParser{};
+    var pos: usize = 0;
+
+    const first = try parser.feed(pipelined, &parsed);
+    try std.testing.expectEqualStrings("GET /a HTTP/1.1\r\nHost: x\r\n\r\n", pipelined[0..first.event.head]);
+    try std.testing.expectEqualStrings("/a", parsed.path);
+    pos += first.consumed;
+    try std.testing.expect((try parser.feed(pipelined[pos..], &parsed)).event == .done);
+
+    const second = try parser.feed(pipelined[pos..], &parsed);
+    try std.testing.expect(std.mem.endsWith(u8, pipelined[pos..][0..second.event.head], "Content-Length: 3\r\n\r\n"));
+    pos += second.consumed;
+    const body = try parser.feed(pipelined[pos..], &parsed);
+    try std.testing.expectEqualStrings("abc", body.event.body);
+    pos += body.consumed;
+    try std.testing.expect((try parser.feed(pipelined[pos..], &parsed)).event == .done);
+
+    // The third head hasn't fully arrived: nothing is consumed
+    const partial = try parser.feed(pipelined[pos..], &parsed);
+    try std.testing.expect(partial.event == .need_more);
+    try std.testing.expectEqual(@as(usize, 0), partial.consumed);
+}
+
+test "vector and scalar scanners agree" {
+    const request = "GET /index.html?q=1 HTTP/1.1\r\nHost: example.com\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\nX-Long: " ++ ("a" ** 100) ++ "\r\n\r\n";
+    const vector = try parseRequest(request);
+    var scalar: Request = undefined;
+    try parseRequestScalar(&scalar, request);
+    try std.testing.expectEqualStrings("/index.html", vector.path);
+    try std.testing.expectEqualStrings(scalar.path, vector.path);
+    try std.testing.expectEqual(scalar.version, vector.version);
+    try std.testing.expectEqual(scalar.headers().len, vector.headers().len);
+
+    const bad = "GET / HTTP/1.1\r\nHost: exa\x01mple.com\r\n\r\n";
+    try std.testing.expectError(error.InvalidCharacter, parseRequest(bad));
+    try std.testing.expectError(error.InvalidCharacter, parseRequestScalar(&scalar, bad));
+}
+
+test "RequestParser decodes a chunked body fed one byte at a time" {
+    var parsed: Request = undefined;
+    const request = "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: t\r\n\r\nGET /next";
+
+    var parser = RequestParser{};
+    var body: [32]u8 = undefined;
+    var body_len: usize = 0;
+    var head_len: ?usize = null;
+    var done = false;
+
+    // Deliver the bytes one at a time; unconsumed bytes are fed again with the next one
+    var start: usize = 0;
+    var end: usize = 1;
+    while (!done and end <= request.len) {
+        const step = try parser.feed(request[start..end], &parsed);
+        start += step.consumed;
+        switch (step.event) {
+            .need_more => end += 1,
+            .head => |len| head_len = len,
+            .body => |chunk| {
+                @memcpy(body[body_len..][0..chunk.len], chunk);
+                body_len += chunk.len;
+            },
+            .done => done = true,
+        }
+    }
+
+    try std.testing.expect(done);
+    try std.testing.expectEqual(@as(usize, 53), head_len.?);
+    try std.testing.expectEqualStrings("hello world", body[0..body_len]);
+    try std.testing.expectEqualStrings("GET /next", request[start..]);
+}
+
+test "RequestParser streams a Content-Length body and rejects conflicting framing" {
+    var parsed: Request = undefined;
+    var parser = RequestParser{};
+    const request = "PUT /a HTTP/1.1\r\nContent-Length: 4\r\n\r\nab";
+
+    const head = try parser.feed(request, &parsed);
+    try std.testing.expect(head.event == .head);
+    const first = try parser.feed(request[head.consumed..], &parsed);
+    try std.testing.expectEqualStrings("ab", first.event.body);
+    try std.testing.expect((try parser.feed("", &parsed)).event == .need_more);
+    try std.testing.expectEqualStrings("cd", (try parser.feed("cd", &parsed)).event.body);
+    try std.testing.expect((try parser.feed("", &parsed)).event == .done);
+
+    parser.reset();
+    try std.testing.expectError(error.ConflictingFraming, parser.feed("POST / HTTP/1.1\r\nContent-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n", &parsed));
+    // Repeats are checked even though lookups only see the first occurrence
+    parser.reset();
+    try std.testing.expectError(error.ConflictingFraming, parser.feed("POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 4\r\n\r\n", &parsed));
+    parser.reset();
+    try std.testing.expectError(error.UnsupportedTransferEncoding, parser.feed("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: gzip\r\n\r\n", &parsed));
+    parser.reset();
+    try std.testing.expect((try parser.feed("POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\n", &parsed)).event == .head);
+    try std.testing.expectEqual(@as(u64, 3), parser.remaining);
+}
+
+test "Content-Length and chunk-size accept bare digits only" {
+    var parsed: Request = undefined;
+    const bad_lengths = [_][]const u8{ "+10", "1_0", "", "-1", "0x10", "1 0", "18446744073709551616" };
+    for (bad_lengths) |value| {
+        var head_buf: [128]u8 = undefined;
+        const head = try std.fmt.bufPrint(&head_buf, "POST / HTTP/1.1\r\nContent-Length: {s}\r\n\r\n", .{value});
+        var parser = RequestParser{};
+        try std.testing.expectError(error.InvalidContentLength, parser.feed(head, &parsed));
+    }
+    var parser = RequestParser{};
+    try std.testing.expect((try parser.feed("POST / HTTP/1.1\r\nContent-Length: 010\r\n\r\n", &parsed)).event == .head);
+    try std.testing.expectEqual(@as(u64, 10), parser.remaining);
+
+    const bad_sizes = [_][]const u8{ "+a", "1_0", "", " 5", "-5", "fffffffffffffffff" };
+    for (bad_sizes) |size| {
+        var chunk_buf: [128]u8 = undefined;
+        const chunk = try std.fmt.bufPrint(&chunk_buf, "{s}\r\nhello\r\n0\r\n\r\n", .{size});
+        var chunked = RequestParser{};
+        _ = try chunked.feed("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", &parsed);
+        try std.testing.expectError(error.InvalidChunk, chunked.feed(chunk, &parsed));
+    }
+    var chunked = RequestParser{};
+    _ = try chunked.feed("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", &parsed);
+    try std.testing.expectEqualStrings("hello", (try chunked.feed("5 ;ext\r\nhello\r\n", &parsed)).event.body);
+}
+
+test "Transfer-Encoding is chunked only when chunked is the last coding" {
+    var parsed: Request = undefined;
+    const chunked_codings = [_][]const u8{ "chunked", "gzip, chunked", "gzip,chunked", "CHUNKED", "chunked ;x=1", ", chunked" };
+    for (chunked_codings) |codings| {
+        var head_buf: [128]u8 = undefined;
+        const head = try std.fmt.bufPrint(&head_buf, "POST / HTTP/1.1\r\nTransfer-Encoding: {s}\r\n\r\n", .{codings});
+        var parser = RequestParser{};
+        try std.testing.expect((try parser.feed(head, &parsed)).event == .head);
+        try std.testing.expectEqual(RequestParser.State.chunk_size, parser.state);
+    }
+    const other_codings = [_][]const u8{ "gzip", "chunked, gzip", "chunked, chunked", "", "chunkedx" };
+    for (other_codings) |codings| {
+        var head_buf: [128]u8 = undefined;
+        const head = try std.fmt.bufPrint(&head_buf, "POST / HTTP/1.1\r\nTransfer-Encoding: {s}\r\n\r\n", .{codings});
+        var parser = RequestParser{};
+        try std.testing.expectError(error.UnsupportedTransferEncoding, parser.feed(head, &parsed));
+    }
+}
+
+test "known headers resolve without a search and outlive parseRequest" {
+    const request = try parseRequest("GET / HTTP/1.1\r\nHOST: example.com\r\nX-Custom: 1\r\ncontent-length: 0\r\nHost: second\r\n\r\n");
+    try std.testing.expectEqualStrings("example.com", request.get(.host).?);
+    try std.testing.expectEqualStrings("0", request.getHeader("Content-Length").?);
+    try std.testing.expectEqualStrings("1", request.getHeader("x-custom").?);
+    try std.testing.expect(request.get(.authorization) == null);
+    try std.testing.expectEqualStrings("Host", request.headers()[3].name);
+    try std.testing.expectEqualStrings("content-length", KnownHeader.content_length.name());
+}
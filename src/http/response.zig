@@ -0,0 +1,220 @@
+//! Allocation-free HTTP/1.1 response serializer
+//!
+//! Status lines come from a table built at comptime, integers are written with
+//! a two-digits-at-a-time itoa, and header lines are plain memcpys into the
+//! caller's buffer. The Date header is formatted at most once per second per
+//! thread. iovecs() hands back the serialized head and the body as separate
+//! buffers, so a body can be written with writev without being copied.
+
+const std = @import("std");
+const parser = @import("parser.zig");
+
+// "HTTP/1.1 200 OK\r\n" for every status code the parser has a reason phrase for
+const status_lines = blk: {
+    @setEvalBranchQuota(200_000);
+    var lines: [600][]const u8 = [_][]const u8{""} ** 600;
+    for (100..600) |code| {
+        const reason = parser.reasonPhrase(code);
+        if (!std.mem.eql(u8, reason, "Unknown")) {
+            lines[code] = std.fmt.comptimePrint("HTTP/1.1 {d} {s}\r\n", .{ code, reason });
+        }
+    }
+    break :blk lines;
+};
+
+const digit_pairs = blk: {
+    var pairs: [200]u8 = undefined;
+    for (0..100) |i| {
+        pairs[i * 2] = '0' + @as(u8, @intCast(i / 10));
+        pairs[i * 2 + 1] = '0' + @as(u8, @intCast(i % 10));
+    }
+    break :blk pairs;
+};
+
+/// Write the decimal form of value to the front of out; returns the digits written
+pub fn writeInt(out: []u8, value: u64) ![]u8 {
+    var tmp: [20]u8 = undefined;
+    var pos: usize = tmp.len;
+    var v = value;
+    while (v >= 100) {
+        const pair: usize = @intCast(v % 100);
+        v /= 100;
+        pos -= 2;
+        tmp[pos..][0..2].* = digit_pairs[pair * 2 ..][0..2].*;
+    }
+    if (v >= 10) {
+        const pair: usize = @intCast(v);
+        pos -= 2;
+        tmp[pos..][0..2].* = digit_pairs[pair * 2 ..][0..2].*;
+    } else {
+        pos -= 1;
+        tmp[pos] = '0' + @as(u8, @intCast(v));
+    }
+    const digits = tmp[pos..];
+    if (out.len < digits.len) return error.BufferTooSmall;
+    @memcpy(out[0..digits.len], digits);
+    return out[0..digits.len];
+}
+
+/// IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT") for Date and Last-Modified
+pub fn formatHttpDate(timestamp: i64, out: *[29]u8) void {
+    const day_names = [_]*const [3]u8{ "Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed" }; // 1970-01-01 was a Thursday
+    const month_names = [_]*const [3]u8{ "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    const secs: u64 = @intCast(@max(timestamp, 0));
+    const epoch_seconds = std.time.epoch.EpochSeconds{ .secs = secs };
+    const epoch_day = epoch_seconds.getEpochDay();
+    const year_day = epoch_day.calculateYearDay();
+    const month_day = year_day.calculateMonthDay();
+    const day_seconds = epoch_seconds.getDaySeconds();
+
+    out[0..3].* = day_names[@intCast(epoch_day.day % 7)].*;
+    out[3..5].* = ", ".*;
+    out[5..7].* = digit_pairs[@as(usize, month_day.day_index + 1) * 2 ..][0..2].*;
+    out[7] = ' ';
+    out[8..11].* = month_names[@intFromEnum(month_day.month) - 1].*;
+    out[11] = ' ';
+    _ = writeInt(out[12..16], year_day.year) catch unreachable;
+    out[16] = ' ';
+    out[17..19].* = digit_pairs[@as(usize, day_seconds.getHoursIntoDay()) * 2 ..][0..2].*;
+    out[19] = ':';
+    out[20..22].* = digit_pairs[@as(usize, day_seconds.getMinutesIntoHour()) * 2 ..][0..2].*;
+    out[22] = ':';
+    out[23..25].* = digit_pairs[@as(usize, day_seconds.getSecondsIntoMinute()) * 2 ..][0..2].*;
+    out[25..29].* = " GMT".*;
+}
+
+// "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+const DATE_HEADER_LEN = 37;
+
+const DateCache = struct {
+    second: i64 = -1,
+    line: [DATE_HEADER_LEN]u8 = undefined,
+
+    fn get(self: *DateCache, now: i64) []const u8 {
+        if (now != self.second) {
+            self.format(now);
+            self.second = now;
+        }
+        return &self.line;
+    }
+
+    fn format(self: *DateCache, now: i64) void {
+        self.line[0..6].* = "Date: ".*;
+        formatHttpDate(now, self.line[6..35]);
+        self.line[35..37].* = "\r\n".*;
+    }
+};
+
+// Per thread, so workers never share (or lock) the cached line
+threadlocal var date_cache: DateCache = .{};
+
+/// "Date: ...\r\n" for the current second
+pub fn dateHeader() []const u8 {
+    return date_cache.get(std.time.timestamp());
+}
+
+/// Serializes a response head into a caller-provided buffer
+pub const ResponseBuilder = struct {
+    buf: []u8,
+    len: usize = 0,
+
+    pub fn init(buf: []u8) ResponseBuilder {
+        return .{ .buf = buf };
+    }
+
+    fn append(self: *ResponseBuilder, data: []const u8) !void {
+        if (self.buf.len - self.len < data.len) return error.BufferTooSmall;
+        @memcpy(self.buf[self.len..][0..data.len], data);
+        self.len += data.len;
+    }
+
+    pub fn status(self: *ResponseBuilder, status_code: u16) !void {
+        if (status_code < status_lines.len and status_lines[status_code].len > 0) {
+            return self.append(status_lines[status_code]);
+        }
+        try self.append("HTTP/1.1 ");
+        try self.int(status_code);
+        try self.append(" Unknown\r\n");
+    }
+
+    /// Status line with a custom reason phrase; the table is still used when it matches
+    pub fn statusWithReason(self: *ResponseBuilder, status_code: u16, reason: []const u8) !void {
+        if (std.mem.eql(u8, reason, parser.reasonPhrase(status_code))) return self.status(status_code);
+        try self.append("HTTP/1.1 ");
+        try self.int(status_code);
+        try self.append(" ");
+        try self.append(reason);
+        try self.append("\r\n");
+    }
+
+    pub fn header(self: *ResponseBuilder, name: []const u8, value: []const u8) !void {
+        // Check up front so a header is never left half-written
+        if (self.buf.len - self.len < name.len + value.len + 4) return error.BufferTooSmall;
+        try self.append(name);
+        try self.append(": ");
+        try self.append(value);
+        try self.append("\r\n");
+    }
+
+    pub fn contentLength(self: *ResponseBuilder, length: u64) !void {
+        try self.append("Content-Length: ");
+        try self.int(length);
+        try self.append("\r\n");
+    }
+
+    pub fn date(self: *ResponseBuilder) !void {
+        try self.append(dateHeader());
+    }
+
+    /// Blank line ending the head
+    pub fn end(self: *ResponseBuilder) !void {
+        try self.append("\r\n");
+    }
+
+    /// Copy the body in after the head, for callers that need one contiguous buffer
+    pub fn body(self: *ResponseBuilder, data: []const u8) !void {
+        try self.append(data);
+    }
+
+    fn int(self: *ResponseBuilder, value: u64) !void {
+        const digits = try writeInt(self.buf[self.len..], value);
+        self.len += digits.len;
+    }
+
+    pub fn bytes(self: *const ResponseBuilder) []const u8 {
+        return self.buf[0..self.len];
+    }
+
+    /// Head and body as separate buffers for writev; the body is not copied
+    pub fn iovecs(self: *const ResponseBuilder, body_bytes: []const u8) [2]std.posix.iovec_const {
+        return .{
+            .{ .base = self.buf.ptr, .len = self.len },
+            .{ .base = body_bytes.ptr, .len = body_bytes.len },
+        };
+    }
+};
+
+test "status lines, integers and headers" {
+    var buf: [256]u8 = undefined;
+    var builder = ResponseBuilder.init(&buf);
+    try builder.status(404);
+    try builder.header("Content-Type", "text/plain");
+    try builder.contentLength(1234567);
+    try builder.end();
+    try std.testing.expectEqualStrings("HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 1234567\r\n\r\n", builder.bytes());
+
+    var small: [8]u8 = undefined;
+    var overflow = ResponseBuilder.init(&small);
+    try std.testing.expectError(error.BufferTooSmall, overflow.status(200));
+
+    var digits: [20]u8 = undefined;
+    try std.testing.expectEqualStrings("0", try writeInt(&digits, 0));
+    try std.testing.expectEqualStrings("18446744073709551615", try writeInt(&digits, std.math.maxInt(u64)));
+}
+
+test "date header is cached per second" {
+    var cache = DateCache{};
+    try std.testing.expectEqualStrings("Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n", cache.get(784111777));
+    try std.testing.expectEqualStrings("Date: Thu, 01 Jan 1970 00:00:00 GMT\r\n", cache.get(0));
+}
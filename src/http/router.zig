@@ -0,0 +1,323 @@
+//! Path router: route tables compiled into a segment trie
+//!
+//! Patterns are '/'-separated segments:
+//!   /users/list      literal segment
+//!   /users/:id       parameter, captures one non-empty segment
+//!   /static/*path    wildcard, captures the rest of the path (last segment only)
+//!   /echo*           prefix: a literal followed by a wildcard within the segment
+//!
+//! At each level literals are tried before the parameter and the parameter
+//! before wildcards, so /users/list wins over /users/:id. Matching compares each
+//! path segment against one trie level and never allocates: captures are slices
+//! of the path stored in the returned Match.
+//!
+//! compile() builds the trie from a runtime route table (e.g. the config file);
+//! comptimeTrie() builds the same trie at compile time for built-in routes.
+
+const std = @import("std");
+
+pub const MAX_PARAMS: usize = 8;
+
+pub const Param = struct {
+    name: []const u8,
+    value: []const u8,
+};
+
+pub const RouteError = error{
+    InvalidPattern,
+    WildcardNotLast,
+    TooManyParams,
+    ConflictingParams,
+    DuplicateRoute,
+    OutOfMemory,
+};
+
+const Kind = enum { literal, param, wildcard };
+
+const Segment = struct {
+    kind: Kind,
+    // Literal text, or the literal part before '*' for a wildcard
+    text: []const u8,
+    // Capture name of a parameter or wildcard
+    capture: []const u8,
+
+    fn parse(raw: []const u8) Segment {
+        if (raw.len > 0 and raw[0] == ':') {
+            return .{ .kind = .param, .text = "", .capture = raw[1..] };
+        }
+        if (std.mem.indexOfScalar(u8, raw, '*')) |star| {
+            return .{ .kind = .wildcard, .text = raw[0..star], .capture = raw[star + 1 ..] };
+        }
+        return .{ .kind = .literal, .text = raw, .capture = "" };
+    }
+
+    // Same trie edge; parameters share one edge whatever they are named
+    fn sameEdge(a: Segment, b: Segment) bool {
+        if (a.kind != b.kind) return false;
+        return a.kind == .param or std.mem.eql(u8, a.text, b.text);
+    }
+};
+
+fn segmentCount(pattern: []const u8) usize {
+    return std.mem.count(u8, pattern[1..], "/") + 1;
+}
+
+fn segmentAt(pattern: []const u8, index: usize) Segment {
+    var it = std.mem.splitScalar(u8, pattern[1..], '/');
+    var i: usize = 0;
+    while (it.next()) |raw| : (i += 1) {
+        if (i == index) return Segment.parse(raw);
+    }
+    unreachable;
+}
+
+pub fn Router(comptime Handler: type) type {
+    return struct {
+        const Self = @This();
+
+        pub const Route = struct {
+            pattern: []const u8,
+            handler: Handler,
+        };
+
+        pub const Node = struct {
+            kind: Kind = .literal,
+            text: []const u8 = "",
+            capture: []const u8 = "",
+            handler: ?Handler = null,
+            // Literals first, then the parameter, then wildcards
+            children: []const Node = &.{},
+        };
+
+        pub const Match = struct {
+            handler: Handler,
+            params: [MAX_PARAMS]Param = undefined,
+            param_count: usize = 0,
+
+            pub fn param(self: *const Match, name: []const u8) ?[]const u8 {
+                for (self.params[0..self.param_count]) |p| {
+                    if (std.mem.eql(u8, p.name, name)) return p.value;
+                }
+                return null;
+            }
+        };
+
+        root: Node,
+        arena: ?std.heap.ArenaAllocator = null,
+
+        /// Build the trie for a runtime route table. Patterns are referenced, not copied.
+        pub fn compile(allocator: std.mem.Allocator, routes: []const Route) RouteError!Self {
+            var arena = std.heap.ArenaAllocator.init(allocator);
+            errdefer arena.deinit();
+            try validate(routes);
+            const root = try buildNode(arena.allocator(), routes, null, 0);
+            return .{ .root = root, .arena = arena };
+        }
+
+        /// Build the trie at compile time; invalid or conflicting routes are compile errors
+        pub fn comptimeTrie(comptime routes: []const Route) Self {
+            comptime {
+                @setEvalBranchQuota(100_000);
+                validate(routes) catch |err| @compileError("invalid route table: " ++ @errorName(err));
+                const root = buildNode(undefined, routes, null, 0) catch |err| @compileError("invalid route table: " ++ @errorName(err));
+                return .{ .root = root };
+            }
+        }
+
+        pub fn deinit(self: *Self) void {
+            if (self.arena) |*arena| arena.deinit();
+        }
+
+        pub fn match(self: *const Self, path: []const u8) ?Match {
+            if (path.len == 0 or path[0] != '/') return null;
+            var result = Match{ .handler = undefined };
+            if (matchChildren(&self.root, path[1..], &result)) return result;
+            return null;
+        }
+
+        fn matchChildren(node: *const Node, rest: []const u8, result: *Match) bool {
+            const separator = std.mem.indexOfScalar(u8, rest, '/');
+            const segment = rest[0 .. separator orelse rest.len];
+            const tail: ?[]const u8 = if (separator) |s| rest[s + 1 ..] else null;
+
+            for (node.children) |*child| {
+                switch (child.kind) {
+                    .literal => {
+                        if (std.mem.eql(u8, child.text, segment) and descend(child, tail, result)) return true;
+                    },
+                    .param => {
+                        if (segment.len == 0) continue;
+                        const saved = result.param_count;
+                        result.params[saved] = .{ .name = child.capture, .value = segment };
+                        result.param_count = saved + 1;
+                        if (descend(child, tail, result)) return true;
+                        result.param_count = saved;
+                    },
+                    .wildcard => {
+                        if (!std.mem.startsWith(u8, rest, child.text)) continue;
+                        result.params[result.param_count] = .{ .name = child.capture, .value = rest[child.text.len..] };
+                        result.param_count += 1;
+                        result.handler = child.handler.?;
+                        return true;
+                    },
+                }
+            }
+            return false;
+        }
+
+        fn descend(child: *const Node, tail: ?[]const u8, result: *Match) bool {
+            if (tail) |next| return matchChildren(child, next, result);
+            const handler = child.handler orelse return false;
+            result.handler = handler;
+            return true;
+        }
+
+        fn validate(routes: []const Route) RouteError!void {
+            for (routes) |route| {
+                if (route.pattern.len == 0 or route.pattern[0] != '/') return error.InvalidPattern;
+                const count = segmentCount(route.pattern);
+                var captures: usize = 0;
+                for (0..count) |i| {
+                    const segment = segmentAt(route.pattern, i);
+                    switch (segment.kind) {
+                        .literal => {},
+                        .param => {
+                            if (segment.capture.len == 0) return error.InvalidPattern;
+                            captures += 1;
+                        },
+                        .wildcard => {
+                            if (i + 1 != count) return error.WildcardNotLast;
+                            captures += 1;
+                        },
+                    }
+                }
+                if (captures > MAX_PARAMS) return error.TooManyParams;
+            }
+        }
+
+        // Does route sit under the node reached by the first depth segments of rep?
+        fn inSubtree(route: Route, rep: ?Route, depth: usize) bool {
+            const parent = rep orelse return true;
+            if (segmentCount(route.pattern) < depth) return false;
+            for (0..depth) |i| {
+                if (!segmentAt(route.pattern, i).sameEdge(segmentAt(parent.pattern, i))) return false;
+            }
+            return true;
+        }
+
+        // Is routes[index] the first route introducing its edge at this depth?
+        fn firstOfEdge(routes: []const Route, rep: ?Route, depth: usize, index: usize, kind: Kind) RouteError!bool {
+            const route = routes[index];
+            if (!inSubtree(route, rep, depth) or segmentCount(route.pattern) <= depth) return false;
+            const segment = segmentAt(route.pattern, depth);
+            if (segment.kind != kind) return false;
+            for (routes[0..index]) |earlier| {
+                if (!inSubtree(earlier, rep, depth) or segmentCount(earlier.pattern) <= depth) continue;
+                const other = segmentAt(earlier.pattern, depth);
+                if (!segment.sameEdge(other)) continue;
+                if (kind == .param and !std.mem.eql(u8, segment.capture, other.capture)) return error.ConflictingParams;
+                return false;
+            }
+            return true;
+        }
+
+        // Node for the first depth segments of rep (the root when rep is null)
+        fn buildNode(allocator: std.mem.Allocator, routes: []const Route, rep: ?Route, depth: usize) RouteError!Node {
+            var node = Node{};
+            if (rep) |route| {
+                const segment = segmentAt(route.pattern, depth - 1);
+                node.kind = segment.kind;
+                node.text = segment.text;
+                node.capture = segment.capture;
+            }
+
+            if (depth > 0) {
+                for (routes) |route| {
+                    if (!inSubtree(route, rep, depth) or segmentCount(route.pattern) != depth) continue;
+                    if (node.handler != null) return error.DuplicateRoute;
+                    node.handler = route.handler;
+                }
+            }
+
+            var count: usize = 0;
+            for (std.enums.values(Kind)) |kind| {
+                for (0..routes.len) |i| {
+                    if (try firstOfEdge(routes, rep, depth, i, kind)) count += 1;
+                }
+            }
+            if (count == 0) return node;
+
+            if (@inComptime()) {
+                var children: [count]Node = undefined;
+                try fillChildren(allocator, routes, rep, depth, &children);
+                const final = children;
+                node.children = &final;
+            } else {
+                const children = try allocator.alloc(Node, count);
+                try fillChildren(allocator, routes, rep, depth, children);
+                node.children = children;
+            }
+            return node;
+        }
+
+        fn fillChildren(allocator: std.mem.Allocator, routes: []const Route, rep: ?Route, depth: usize, children: []Node) RouteError!void {
+            var next: usize = 0;
+            for (std.enums.values(Kind)) |kind| {
+                for (routes, 0..) |route, i| {
+                    if (!try firstOfEdge(routes, rep, depth, i, kind)) continue;
+                    children[next] = try buildNode(allocator, routes, route, depth + 1);
+                    next += 1;
+                }
+            }
+        }
+    };
+}
+
+const TestRouter = Router(u8);
+
+test "literal, parameter and wildcard routes" {
+    var router = try TestRouter.compile(std.testing.allocator, &.{
+        .{ .pattern = "/", .handler = 0 },
+        .{ .pattern = "/users/:id", .handler = 1 },
+        .{ .pattern = "/users/list", .handler = 2 },
+        .{ .pattern = "/users/:id/posts/:post", .handler = 3 },
+        .{ .pattern = "/static/*file", .handler = 4 },
+        .{ .pattern = "/echo*", .handler = 5 },
+    });
+    defer router.deinit();
+
+    try std.testing.expectEqual(@as(u8, 0), router.match("/").?.handler);
+    try std.testing.expectEqual(@as(u8, 2), router.match("/users/list").?.handler);
+
+    const user = router.match("/users/42").?;
+    try std.testing.expectEqual(@as(u8, 1), user.handler);
+    try std.testing.expectEqualStrings("42", user.param("id").?);
+
+    const post = router.match("/users/7/posts/99").?;
+    try std.testing.expectEqual(@as(u8, 3), post.handler);
+    try std.testing.expectEqualStrings("99", post.param("post").?);
+
+    try std.testing.expectEqualStrings("css/site.css", router.match("/static/css/site.css").?.param("file").?);
+    try std.testing.expectEqual(@as(u8, 5), router.match("/echo/hi/there").?.handler);
+
+    try std.testing.expect(router.match("/users") == null);
+    try std.testing.expect(router.match("/users/") == null);
+    try std.testing.expect(router.match("/missing") == null);
+}
+
+test "comptime trie and table errors" {
+    const builtin_routes = comptime TestRouter.comptimeTrie(&.{
+        .{ .pattern = "/hello", .handler = 1 },
+        .{ .pattern = "/api/:version/*rest", .handler = 2 },
+    });
+    try std.testing.expectEqual(@as(u8, 1), builtin_routes.match("/hello").?.handler);
+    try std.testing.expectEqualStrings("v1/users", builtin_routes.match("/api/v1/v1/users").?.param("rest").?);
+
+    try std.testing.expectError(error.DuplicateRoute, TestRouter.compile(std.testing.allocator, &.{
+        .{ .pattern = "/a", .handler = 1 },
+        .{ .pattern = "/a", .handler = 2 },
+    }));
+    try std.testing.expectError(error.WildcardNotLast, TestRouter.compile(std.testing.allocator, &.{
+        .{ .pattern = "/a/*/b", .handler = 1 },
+    }));
+}
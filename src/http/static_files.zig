@@ -0,0 +1,470 @@
+//! Static file serving for the io_uring workers
+//!
+//! FileCache keeps open fds and stat results keyed by path, so a warm request
+//! costs no open(2)/fstat(2). Each worker owns one cache and takes no locks.
+//! The directory of every cached file is watched with inotify and entries are
+//! dropped as soon as the file changes; the worker reads the inotify fd through
+//! its ring and passes the events to handleEvents(). Entries are reference
+//! counted, so a file still being spliced to a socket stays open after it has
+//! been invalidated.
+//!
+//! Precompressed siblings (name.br, name.gz) are cached the same way, misses
+//! included, so picking a variant by Accept-Encoding never touches the
+//! filesystem once warm. buildResponse() writes the response head (200, 206,
+//! 304, 404 or 416) and returns the byte range of the file that should follow;
+//! the body itself is never read into userspace.
+
+const std = @import("std");
+const posix = std.posix;
+const linux = std.os.linux;
+const http = @import("parser.zig");
+const response = @import("response.zig");
+
+const MAX_PATH_LENGTH: usize = 4096;
+const ETAG_MAX_LENGTH: usize = 40;
+
+const WATCH_MASK: u32 = linux.IN.MODIFY | linux.IN.ATTRIB | linux.IN.CLOSE_WRITE | linux.IN.CREATE |
+    linux.IN.DELETE | linux.IN.MOVED_FROM | linux.IN.MOVED_TO | linux.IN.DELETE_SELF | linux.IN.MOVE_SELF | linux.IN.ONLYDIR;
+
+pub const Entry = struct {
+    // -1 for a cached miss (missing, unreadable or not a regular file)
+    fd: posix.fd_t,
+    size: u64 = 0,
+    etag: [ETAG_MAX_LENGTH]u8 = undefined,
+    etag_len: usize = 0,
+    last_modified: [29]u8 = undefined,
+    content_type: []const u8 = "application/octet-stream",
+    // The cache holds one reference while the entry is in the map
+    refs: u32 = 1,
+    key: []u8,
+
+    pub fn found(self: *const Entry) bool {
+        return self.fd >= 0;
+    }
+
+    pub fn etagValue(self: *const Entry) []const u8 {
+        return self.etag[0..self.etag_len];
+    }
+};
+
+pub const FileCache = struct {
+    allocator: std.mem.Allocator,
+    entries: std.StringHashMapUnmanaged(*Entry) = .{},
+    // Watch descriptor -> directory path, and the reverse so each directory is watched once
+    watches: std.AutoHashMapUnmanaged(i32, []u8) = .{},
+    watched_dirs: std.StringHashMapUnmanaged(i32) = .{},
+    // -1 when inotify is unavailable; nothing is cached then
+    inotify_fd: posix.fd_t,
+
+    pub fn init(allocator: std.mem.Allocator) FileCache {
+        const fd = posix.inotify_init1(linux.IN.CLOEXEC) catch |err| blk: {
+            std.log.warn("inotify unavailable ({}), static files will not be cached", .{err});
+            break :blk -1;
+        };
+        return .{ .allocator = allocator, .inotify_fd = fd };
+    }
+
+    /// Stop caching, e.g. when the inotify fd can no longer be read
+    pub fn disable(self: *FileCache) void {
+        self.invalidateAll();
+        if (self.inotify_fd >= 0) posix.close(self.inotify_fd);
+        self.inotify_fd = -1;
+    }
+
+    pub fn deinit(self: *FileCache) void {
+        self.disable();
+        self.entries.deinit(self.allocator);
+        self.watched_dirs.deinit(self.allocator);
+        self.watches.deinit(self.allocator);
+    }
+
+    /// Entry for path with a reference taken; pair with release()
+    pub fn acquire(self: *FileCache, path: []const u8) !*Entry {
+        if (self.entries.get(path)) |entry| {
+            entry.refs += 1;
+            return entry;
+        }
+
+        const entry = try self.load(path);
+        if (self.inotify_fd < 0) return entry;
+        errdefer self.release(entry);
+
+        // Watch the directory first: a change that lands before the watch exists would otherwise be missed
+        self.watchDirectory(std.fs.path.dirname(path) orelse ".") catch |err| {
+            std.log.debug("Not caching {s}: cannot watch its directory ({})", .{ path, err });
+            return entry;
+        };
+        try self.entries.put(self.allocator, entry.key, entry);
+        entry.refs += 1;
+        return entry;
+    }
+
+    pub fn release(self: *FileCache, entry: *Entry) void {
+        entry.refs -= 1;
+        if (entry.refs > 0) return;
+        if (entry.fd >= 0) posix.close(entry.fd);
+        self.allocator.free(entry.key);
+        self.allocator.destroy(entry);
+    }
+
+    fn load(self: *FileCache, path: []const u8) !*Entry {
+        const entry = try self.allocator.create(Entry);
+        errdefer self.allocator.destroy(entry);
+        entry.* = .{ .fd = -1, .key = try self.allocator.dupe(u8, path) };
+
+        const fd = posix.open(path, .{ .ACCMODE = .RDONLY, .CLOEXEC = true }, 0) catch return entry;
+        const stat = posix.fstat(fd) catch {
+            posix.close(fd);
+            return entry;
+        };
+        if (!posix.S.ISREG(stat.mode)) {
+            posix.close(fd);
+            return entry;
+        }
+
+        const mtime = stat.mtime();
+        entry.fd = fd;
+        entry.size = @intCast(stat.size);
+        const etag = std.fmt.bufPrint(&entry.etag, "\"{x}-{x}\"", .{ mtime.sec, entry.size }) catch unreachable;
+        entry.etag_len = etag.len;
+        response.formatHttpDate(mtime.sec, &entry.last_modified);
+        entry.content_type = contentType(path);
+        return entry;
+    }
+
+    fn watchDirectory(self: *FileCache, dir: []const u8) !void {
+        if (self.watched_dirs.contains(dir)) return;
+        const wd = try posix.inotify_add_watch(self.inotify_fd, dir, WATCH_MASK);
+        const owned = try self.allocator.dupe(u8, dir);
+        errdefer self.allocator.free(owned);
+        try self.watches.put(self.allocator, wd, owned);
+        try self.watched_dirs.put(self.allocator, owned, wd);
+    }
+
+    fn invalidate(self: *FileCache, path: []const u8) void {
+        const removed = self.entries.fetchRemove(path) orelse return;
+        self.release(removed.value);
+    }
+
+    /// Drop every entry and watch (inotify queue overflow, shutdown)
+    pub fn invalidateAll(self: *FileCache) void {
+        var it = self.entries.valueIterator();
+        while (it.next()) |entry| self.release(entry.*);
+        self.entries.clearRetainingCapacity();
+
+        var watch_it = self.watches.iterator();
+        while (watch_it.next()) |watch| {
+            if (self.inotify_fd >= 0) posix.inotify_rm_watch(self.inotify_fd, watch.key_ptr.*);
+            self.allocator.free(watch.value_ptr.*);
+        }
+        self.watches.clearRetainingCapacity();
+        self.watched_dirs.clearRetainingCapacity();
+    }
+
+    /// Apply a buffer of inotify events read from inotify_fd
+    pub fn handleEvents(self: *FileCache, events: []const u8) void {
+        var pos: usize = 0;
+        while (pos + @sizeOf(linux.inotify_event) <= events.len) {
+            const event: *align(1) const linux.inotify_event = @ptrCast(events[pos..].ptr);
+            const name_start = pos + @sizeOf(linux.inotify_event);
+            pos = name_start + event.len;
+            if (pos > events.len) break;
+
+            if (event.mask & linux.IN.Q_OVERFLOW != 0) {
+                self.invalidateAll();
+                return;
+            }
+            const dir = self.watches.get(event.wd) orelse continue;
+
+            if (event.mask & (linux.IN.IGNORED | linux.IN.DELETE_SELF | linux.IN.MOVE_SELF) != 0) {
+                // The directory itself went away: everything under it is suspect
+                self.invalidateAll();
+                return;
+            }
+
+            const name = std.mem.sliceTo(events[name_start..pos], 0);
+            var path_buf: [MAX_PATH_LENGTH]u8 = undefined;
+            const path = std.fmt.bufPrint(&path_buf, "{s}/{s}", .{ dir, name }) catch continue;
+            self.invalidate(path);
+            // A variant appearing or disappearing changes negotiation for the base file too
+            for ([_][]const u8{ ".br", ".gz" }) |suffix| {
+                if (std.mem.endsWith(u8, path, suffix)) {
+                    self.invalidate(path[0 .. path.len - suffix.len]);
+                } else {
+                    var variant_buf: [MAX_PATH_LENGTH]u8 = undefined;
+                    const variant = std.fmt.bufPrint(&variant_buf, "{s}{s}", .{ path, suffix }) catch continue;
+                    self.invalidate(variant);
+                }
+            }
+        }
+    }
+};
+
+/// Body to send after the head: length bytes of entry starting at offset.
+/// entry is null when there is no body (HEAD, 304, errors); otherwise the
+/// caller owns a reference and must release it once the body has been sent.
+pub const FileBody = struct {
+    entry: ?*Entry = null,
+    offset: u64 = 0,
+    length: u64 = 0,
+};
+
+/// Write the response head for rel_path under root and pick the body range.
+/// head is left untouched on error so the caller can retry with more space.
+pub fn buildResponse(cache: *FileCache, root: []const u8, rel_path: []const u8, request: *const http.Request, head: *response.ResponseBuilder) !FileBody {
+    const start_len = head.len;
+    errdefer head.len = start_len;
+
+    var path_buf: [MAX_PATH_LENGTH]u8 = undefined;
+    const path = resolvePath(&path_buf, root, rel_path) orelse {
+        try simpleStatus(head, 404);
+        return .{};
+    };
+
+    const identity = try cache.acquire(path);
+    var entry = identity;
+    errdefer cache.release(entry);
+    if (!identity.found()) {
+        try simpleStatus(head, 404);
+        cache.release(entry);
+        return .{};
+    }
+
+    // Ranges are only served from the identity representation
+    const range_header = request.get(.range);
+    var encoding: ?[]const u8 = null;
+    if (range_header == null) {
+        if (request.get(.accept_encoding)) |accept| {
+            for ([_][2][]const u8{ .{ "br", ".br" }, .{ "gzip", ".gz" } }) |candidate| {
+                if (!acceptsEncoding(accept, candidate[0])) continue;
+                var variant_buf: [MAX_PATH_LENGTH]u8 = undefined;
+                const variant_path = std.fmt.bufPrint(&variant_buf, "{s}{s}", .{ path, candidate[1] }) catch continue;
+                const variant = try cache.acquire(variant_path);
+                if (!variant.found()) {
+                    cache.release(variant);
+                    continue;
+                }
+                cache.release(entry);
+                entry = variant;
+                encoding = candidate[0];
+                break;
+            }
+        }
+    }
+
+    // Conditional requests
+    const not_modified = if (request.get(.if_none_match)) |tags|
+        etagMatches(tags, entry.etagValue())
+    else if (request.get(.if_modified_since)) |since|
+        std.mem.eql(u8, since, &entry.last_modified)
+    else
+        false;
+    if (not_modified) {
+        try head.status(304);
+        try validators(head, entry);
+        try head.date();
+        try head.end();
+        cache.release(entry);
+        return .{};
+    }
+
+    var offset: u64 = 0;
+    var length: u64 = entry.size;
+    if (range_header) |range| {
+        switch (parseRange(range, entry.size)) {
+            .full => {},
+            .unsatisfiable => {
+                try head.status(416);
+                var content_range_buf: [48]u8 = undefined;
+                try head.header("Content-Range", std.fmt.bufPrint(&content_range_buf, "bytes */{d}", .{entry.size}) catch unreachable);
+                try head.contentLength(0);
+                try head.date();
+                try head.end();
+                cache.release(entry);
+                return .{};
+            },
+            .partial => |partial| {
+                offset = partial.start;
+                length = partial.end - partial.start + 1;
+            },
+        }
+    }
+
+    try head.status(if (length != entry.size) 206 else 200);
+    try head.header("Content-Type", entry.content_type);
+    try head.contentLength(length);
+    if (length != entry.size) {
+        var content_range_buf: [64]u8 = undefined;
+        try head.header("Content-Range", std.fmt.bufPrint(&content_range_buf, "bytes {d}-{d}/{d}", .{ offset, offset + length - 1, entry.size }) catch unreachable);
+    }
+    if (encoding) |coding| try head.header("Content-Encoding", coding);
+    try head.header("Vary", "Accept-Encoding");
+    try head.header("Accept-Ranges", "bytes");
+    try validators(head, entry);
+    try head.header("Connection", "keep-alive");
+    try head.date();
+    try head.end();
+
+    if (request.method == .HEAD or length == 0) {
+        cache.release(entry);
+        return .{};
+    }
+    return .{ .entry = entry, .offset = offset, .length = length };
+}
+
+fn simpleStatus(head: *response.ResponseBuilder, status_code: u16) !void {
+    try head.status(status_code);
+    try head.contentLength(0);
+    try head.header("Connection", "keep-alive");
+    try head.date();
+    try head.end();
+}
+
+fn validators(head: *response.ResponseBuilder, entry: *const Entry) !void {
+    try head.header("ETag", entry.etagValue());
+    try head.header("Last-Modified", &entry.last_modified);
+}
+
+// root/rel with rel percent-decoded, or null if rel could step outside root
+fn resolvePath(buf: []u8, root: []const u8, rel: []const u8) ?[]const u8 {
+    const prefix = std.fmt.bufPrint(buf, "{s}/", .{std.mem.trimRight(u8, root, "/")}) catch return null;
+    var len = prefix.len;
+    var i: usize = 0;
+    while (i < rel.len) : (i += 1) {
+        var ch = rel[i];
+        if (ch == '%') {
+            if (i + 2 >= rel.len) return null;
+            ch = std.fmt.parseInt(u8, rel[i + 1 .. i + 3], 16) catch return null;
+            i += 2;
+        }
+        if (ch == 0) return null;
+        // Collapse leading and repeated slashes
+        if (ch == '/' and buf[len - 1] == '/') continue;
+        if (len == buf.len) return null;
+        buf[len] = ch;
+        len += 1;
+    }
+
+    const decoded = buf[prefix.len..len];
+    var segments = std.mem.splitScalar(u8, decoded, '/');
+    while (segments.next()) |segment| {
+        if (std.mem.eql(u8, segment, "..")) return null;
+    }
+    if (decoded.len == 0 or decoded[decoded.len - 1] == '/') {
+        const index = "index.html";
+        if (buf.len - len < index.len) return null;
+        @memcpy(buf[len..][0..index.len], index);
+        len += index.len;
+    }
+    return buf[0..len];
+}
+
+fn acceptsEncoding(accept: []const u8, coding: []const u8) bool {
+    var items = std.mem.splitScalar(u8, accept, ',');
+    while (items.next()) |item| {
+        var parts = std.mem.splitScalar(u8, item, ';');
+        const name = std.mem.trim(u8, parts.first(), " \t");
+        if (!std.ascii.eqlIgnoreCase(name, coding)) continue;
+        // Only an explicit q=0 refuses it
+        while (parts.next()) |param| {
+            const p = std.mem.trim(u8, param, " \t");
+            if (std.mem.startsWith(u8, p, "q=") and (std.fmt.parseFloat(f32, p[2..]) catch 1) == 0) return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+fn etagMatches(if_none_match: []const u8, etag: []const u8) bool {
+    if (std.mem.eql(u8, std.mem.trim(u8, if_none_match, " \t"), "*")) return true;
+    var tags = std.mem.splitScalar(u8, if_none_match, ',');
+    while (tags.next()) |tag| {
+        var candidate = std.mem.trim(u8, tag, " \t");
+        // Weak comparison, as If-None-Match requires
+        if (std.mem.startsWith(u8, candidate, "W/")) candidate = candidate[2..];
+        if (std.mem.eql(u8, candidate, etag)) return true;
+    }
+    return false;
+}
+
+const Range = union(enum) {
+    // No usable range: serve the whole file
+    full,
+    unsatisfiable,
+    partial: struct { start: u64, end: u64 },
+};
+
+// Single "bytes=" ranges; anything else (including multiple ranges) is served whole
+fn parseRange(header: []const u8, size: u64) Range {
+    const spec = std.mem.trim(u8, header, " \t");
+    if (!std.mem.startsWith(u8, spec, "bytes=")) return .full;
+    const range = spec["bytes=".len..];
+    if (std.mem.indexOfScalar(u8, range, ',') != null) return .full;
+    const dash = std.mem.indexOfScalar(u8, range, '-') orelse return .full;
+    const first = std.mem.trim(u8, range[0..dash], " \t");
+    const last = std.mem.trim(u8, range[dash + 1 ..], " \t");
+
+    if (first.len == 0) {
+        // Suffix range: the last n bytes
+        const suffix = std.fmt.parseInt(u64, last, 10) catch return .full;
+        if (suffix == 0 or size == 0) return .unsatisfiable;
+        return .{ .partial = .{ .start = size - @min(suffix, size), .end = size - 1 } };
+    }
+    const start = std.fmt.parseInt(u64, first, 10) catch return .full;
+    if (start >= size) return .unsatisfiable;
+    const end = if (last.len == 0) size - 1 else @min(std.fmt.parseInt(u64, last, 10) catch return .full, size - 1);
+    if (end < start) return .full;
+    return .{ .partial = .{ .start = start, .end = end } };
+}
+
+fn contentType(path: []const u8) []const u8 {
+    const types = [_][2][]const u8{
+        .{ ".html", "text/html; charset=utf-8" },
+        .{ ".htm", "text/html; charset=utf-8" },
+        .{ ".css", "text/css; charset=utf-8" },
+        .{ ".js", "text/javascript; charset=utf-8" },
+        .{ ".mjs", "text/javascript; charset=utf-8" },
+        .{ ".json", "application/json" },
+        .{ ".txt", "text/plain; charset=utf-8" },
+        .{ ".xml", "application/xml" },
+        .{ ".svg", "image/svg+xml" },
+        .{ ".png", "image/png" },
+        .{ ".jpg", "image/jpeg" },
+        .{ ".jpeg", "image/jpeg" },
+        .{ ".gif", "image/gif" },
+        .{ ".webp", "image/webp" },
+        .{ ".avif", "image/avif" },
+        .{ ".ico", "image/x-icon" },
+        .{ ".woff2", "font/woff2" },
+        .{ ".woff", "font/woff" },
+        .{ ".wasm", "application/wasm" },
+        .{ ".pdf", "application/pdf" },
+    };
+    const ext = std.fs.path.extension(path);
+    for (types) |entry| {
+        if (std.ascii.eqlIgnoreCase(ext, entry[0])) return entry[1];
+    }
+    return "application/octet-stream";
+}
+
+test "range parsing" {
+    try std.testing.expectEqual(Range{ .partial = .{ .start = 0, .end = 99 } }, parseRange("bytes=0-99", 1000));
+    try std.testing.expectEqual(Range{ .partial = .{ .start = 900, .end = 999 } }, parseRange("bytes=-100", 1000));
+    try std.testing.expectEqual(Range{ .partial = .{ .start = 500, .end = 999 } }, parseRange("bytes=500-", 1000));
+    try std.testing.expectEqual(Range{ .partial = .{ .start = 990, .end = 999 } }, parseRange("bytes=990-5000", 1000));
+    try std.testing.expectEqual(Range.unsatisfiable, parseRange("bytes=1000-", 1000));
+    try std.testing.expectEqual(Range.full, parseRange("bytes=0-1,5-6", 1000));
+}
+
+test "negotiation helpers" {
+    try std.testing.expect(acceptsEncoding("gzip, deflate, br", "br"));
+    try std.testing.expect(!acceptsEncoding("gzip, br;q=0", "br"));
+    try std.testing.expect(etagMatches("W/\"5f-10\", \"a-b\"", "\"5f-10\""));
+
+    var buf: [64]u8 = undefined;
+    try std.testing.expect(resolvePath(&buf, "/srv", "../etc/passwd") == null);
+    try std.testing.expect(resolvePath(&buf, "/srv", "a/%2e%2e/%2E%2E/etc") == null);
+    try std.testing.expectEqualStrings("/srv/my file.txt", resolvePath(&buf, "/srv", "my%20file.txt").?);
+    try std.testing.expectEqualStrings("/srv/www/index.html", resolvePath(&buf, "/srv/www/", "").?);
+    try std.testing.expectEqualStrings("/srv/www/css/site.css", resolvePath(&buf, "/srv/www", "css/site.css").?);
+}
@@ -20,6 +20,35 @@ const rate_limit = middleware.rate_limit;
 const metrics = @import("metrics/mod.zig");
 const auth = @import("auth/mod.zig");
 const jwt = auth.jwt;
+const router = @import("http/router.zig");
+const http_response = @import("http/response.zig");
+
+// Routes served by the JWT demo server
+const JwtRoute = enum { health, profile, admin };
+const jwt_routes = router.Router(JwtRoute).comptimeTrie(&.{
+    .{ .pattern = "/health", .handler = .health },
+    .{ .pattern = "/api/profile", .handler = .profile },
+    .{ .pattern = "/api/admin", .handler = .admin },
+});
+
+// Echo-mode CLI flags; unset fields fall back to the config file, then to defaults
+const EchoFlags = struct {
+    workers: ?u32 = null,
+    registered_io: ?bool = null,
+    ring_mode: ?config.RingConfig.Mode = null,
+    sq_entries: ?u32 = null,
+    cq_entries: ?u32 = null,
+    sqpoll_cpu: ?u32 = null,
+    sqpoll_idle_ms: ?u32 = null,
+    huge_pages: ?config.ArenaConfig.HugePages = null,
+    numa_local: ?bool = null,
+    tls_cert: ?[:0]const u8 = null,
+    tls_key: ?[:0]const u8 = null,
+    ktls: ?bool = null,
+    tls_handshake_threads: ?u32 = null,
+    tls_session_tickets: ?config.TlsConfig.SessionTickets = null,
+    tls_ticket_key_file: ?[:0]const u8 = null,
+};
 
 const Mode = enum {
     quic, // QUIC/HTTP3 server (default)
@@ -39,6 +68,8 @@ pub fn main() !void {
     var mode: Mode = .quic;
     var config_path: ?[]const u8 = null;
     var port: ?u16 = null;
+    var echo_flags = EchoFlags{};
+    var udp_batching = true;
 
     // Simple argument parsing
     var i: usize = 1;
@@ -67,6 +98,83 @@ pub fn main() !void {
                 i += 1;
                 port = try std.fmt.parseInt(u16, args[i], 10);
             }
+        } else if (std.mem.eql(u8, args[i], "--workers") or std.mem.eql(u8, args[i], "-w")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.workers = try std.fmt.parseInt(u32, args[i], 10);
+            }
+        } else if (std.mem.eql(u8, args[i], "--registered-io")) {
+            echo_flags.registered_io = true;
+        } else if (std.mem.eql(u8, args[i], "--ring-mode")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.ring_mode = config.RingConfig.Mode.parse(args[i]) orelse {
+                    std.log.err("Unknown ring mode: {s}. Use: default, sqpoll, coop, or defer", .{args[i]});
+                    return error.InvalidRingMode;
+                };
+            }
+        } else if (std.mem.eql(u8, args[i], "--sq-entries")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.sq_entries = try std.fmt.parseInt(u32, args[i], 10);
+            }
+        } else if (std.mem.eql(u8, args[i], "--cq-entries")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.cq_entries = try std.fmt.parseInt(u32, args[i], 10);
+            }
+        } else if (std.mem.eql(u8, args[i], "--sqpoll-cpu")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.sqpoll_cpu = try std.fmt.parseInt(u32, args[i], 10);
+            }
+        } else if (std.mem.eql(u8, args[i], "--sqpoll-idle-ms")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.sqpoll_idle_ms = try std.fmt.parseInt(u32, args[i], 10);
+            }
+        } else if (std.mem.eql(u8, args[i], "--huge-pages")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.huge_pages = std.meta.stringToEnum(config.ArenaConfig.HugePages, args[i]) orelse {
+                    std.log.err("Unknown huge pages mode: {s}. Use: off, transparent, or explicit", .{args[i]});
+                    return error.InvalidHugePagesMode;
+                };
+            }
+        } else if (std.mem.eql(u8, args[i], "--numa-local")) {
+            echo_flags.numa_local = true;
+        } else if (std.mem.eql(u8, args[i], "--tls-cert")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.tls_cert = args[i];
+            }
+        } else if (std.mem.eql(u8, args[i], "--tls-key")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.tls_key = args[i];
+            }
+        } else if (std.mem.eql(u8, args[i], "--no-ktls")) {
+            echo_flags.ktls = false;
+        } else if (std.mem.eql(u8, args[i], "--tls-handshake-threads")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.tls_handshake_threads = try std.fmt.parseInt(u32, args[i], 10);
+            }
+        } else if (std.mem.eql(u8, args[i], "--tls-session-tickets")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.tls_session_tickets = std.meta.stringToEnum(config.TlsConfig.SessionTickets, args[i]) orelse {
+                    std.log.err("Unknown session ticket mode: {s}. Use: stateless, stateful, or off", .{args[i]});
+                    return error.InvalidSessionTicketMode;
+                };
+            }
+        } else if (std.mem.eql(u8, args[i], "--tls-ticket-key-file")) {
+            if (i + 1 < args.len) {
+                i += 1;
+                echo_flags.tls_ticket_key_file = args[i];
+            }
+        } else if (std.mem.eql(u8, args[i], "--no-udp-batching")) {
+            udp_batching = false;
         } else if (std.mem.eql(u8, args[i], "--help") or std.mem.eql(u8, args[i], "-h")) {
             printUsage();
             return;
@@ -76,8 +184,8 @@ pub fn main() !void {
 
     // Route to appropriate mode
     switch (mode) {
-        .quic => try runQuicServer(allocator, config_path, port),
-        .echo => try runEchoServer(port orelse 8080),
+        .quic => try runQuicServer(allocator, config_path, port, udp_batching, echo_flags.workers),
+        .echo => try runEchoServer(allocator, config_path, port orelse 8080, echo_flags),
         .http => try runHttpServer(port orelse 8080),
     }
 }
@@ -95,6 +203,22 @@ fn printUsage() void {
         \\  --lb <config>     Load balancer mode with config file
         \\  --config <file>   Configuration file path
         \\  --port <port>     Port to listen on (default: 8443 for QUIC, 8080 for others)
+        \\  --no-udp-batching  QUIC mode: one recv/sendto per datagram instead of multishot recvmsg with GRO/GSO
+        \\  --workers <n>     io_uring worker threads (0 = one per CPU, default: 1); QUIC workers are picked by connection ID
+        \\  --registered-io   Echo mode: direct-accept into registered files, write from fixed buffers
+        \\  --ring-mode <m>   Echo mode ring setup: default, sqpoll, coop, or defer (falls back if unsupported)
+        \\  --sq-entries <n>  Echo mode: submission queue size (default: 4096)
+        \\  --cq-entries <n>  Echo mode: completion queue size (default: 2x SQ)
+        \\  --sqpoll-cpu <n>  Echo mode: pin worker N's SQPOLL thread to CPU n+N
+        \\  --sqpoll-idle-ms <n>  Echo mode: SQPOLL thread idle time before sleeping (default: 1000)
+        \\  --huge-pages <m>  Echo mode buffer arena: off (default), transparent, or explicit (MAP_HUGETLB)
+        \\  --numa-local      Echo mode: bind each worker's buffer arena to its local NUMA node
+        \\  --tls-cert <file> Echo mode: serve HTTPS with this PEM certificate chain (needs --tls-key)
+        \\  --tls-key <file>  Echo mode: private key for --tls-cert
+        \\  --no-ktls         Echo mode: keep TLS records in userspace instead of handing them to the kernel
+        \\  --tls-handshake-threads <n>  Echo mode: run TLS handshakes on n threads off the event loop (default: 0, inline)
+        \\  --tls-session-tickets <mode>  Echo mode: session resumption: stateless, stateful, or off (default: stateless)
+        \\  --tls-ticket-key-file <file>  Echo mode: shared 80-byte ticket key records instead of rotating random keys
         \\  --help, -h        Show this help message
         \\
         \\Examples:
@@ -103,11 +227,14 @@ fn printUsage() void {
         \\  zig build run -- --mode http            # HTTP/1.1 server
         \\  zig build run -- --lb config.toml       # Load balancer mode
         \\  zig build run -- --port 9000            # Custom port
+        \\  zig build run -- --mode echo --workers 0  # Echo server, one worker per CPU
+        \\  zig build run -- --workers 0           # QUIC server, one worker per CPU
+        \\  zig build run -- --mode echo --ring-mode sqpoll --sqpoll-cpu 4  # Kernel-side SQ polling
         \\
     , .{});
 }
 
-fn runQuicServer(allocator: std.mem.Allocator, config_path: ?[]const u8, port: ?u16) !void {
+fn runQuicServer(allocator: std.mem.Allocator, config_path: ?[]const u8, port: ?u16, udp_batching: bool, workers_flag: ?u32) !void {
     if (builtin.os.tag != .linux) {
         std.log.err("QUIC server requires Linux (io_uring support)", .{});
         return error.UnsupportedPlatform;
@@ -117,16 +244,18 @@ fn runQuicServer(allocator: std.mem.Allocator, config_path: ?[]const u8, port: ?
     std.debug.print("================================\n\n", .{});
 
     // Initialize io_uring
-    try io_uring.init();
+    try io_uring.init(.{});
     defer io_uring.deinit();
 
     const ring = &io_uring.ring;
 
     // Load configuration if provided
+    var workers: u32 = 1;
     if (config_path) |cfg_path| {
         std.debug.print("Loading configuration from: {s}\n", .{cfg_path});
         var cfg = try config.loadConfig(allocator, cfg_path);
         defer cfg.deinit();
+        workers = cfg.workers;
 
         if (cfg.mode == .load_balancer) {
             std.debug.print("Starting in Load Balancer mode\n", .{});
@@ -138,10 +267,13 @@ fn runQuicServer(allocator: std.mem.Allocator, config_path: ?[]const u8, port: ?
     // Default: Run QUIC server on port 8443
     const listen_port = port orelse 8443;
     std.debug.print("Starting QUIC/HTTP3 server on port {d}...\n", .{listen_port});
-    try udp_server.runQuicServer(ring, listen_port);
+    try udp_server.runQuicServer(ring, listen_port, .{
+        .batched_io = udp_batching,
+        .workers = workers_flag orelse workers,
+    });
 }
 
-fn runEchoServer(port: u16) !void {
+fn runEchoServer(allocator: std.mem.Allocator, config_path: ?[]const u8, port: u16, flags: EchoFlags) !void {
     if (builtin.os.tag != .linux) {
         std.log.err("Echo server requires Linux (io_uring support)", .{});
         return error.UnsupportedPlatform;
@@ -150,11 +282,60 @@ fn runEchoServer(port: u16) !void {
     std.debug.print("Blitz Echo Server Demo\n", .{});
     std.debug.print("======================\n\n", .{});
 
-    try io_uring.init();
-    defer io_uring.deinit();
+    var options = io_uring.EchoServerOptions{ .port = port };
+
+    // Config file supplies defaults; CLI flags override them
+    // (kept loaded while serving: the route table points into it)
+    var loaded_cfg: ?config.Config = null;
+    defer if (loaded_cfg) |*cfg| cfg.deinit();
+    if (config_path) |cfg_path| {
+        loaded_cfg = try config.loadConfig(allocator, cfg_path);
+        const cfg = &loaded_cfg.?;
+        options.workers = cfg.workers;
+        options.registered_io = cfg.registered_io;
+        options.ring = cfg.ring;
+        options.arena = cfg.arena;
+        options.routes = cfg.routes.items;
+    }
+    var tls_config = if (loaded_cfg) |cfg| cfg.tls else config.TlsConfig{};
+    if (flags.workers) |n| options.workers = n;
+    if (flags.registered_io) |enabled| options.registered_io = enabled;
+    if (flags.ring_mode) |mode| options.ring.mode = mode;
+    if (flags.sq_entries) |n| options.ring.sq_entries = n;
+    if (flags.cq_entries) |n| options.ring.cq_entries = n;
+    if (flags.sqpoll_cpu) |cpu| options.ring.sqpoll_cpu = cpu;
+    if (flags.sqpoll_idle_ms) |ms| options.ring.sqpoll_idle_ms = ms;
+    if (flags.huge_pages) |mode| options.arena.huge_pages = mode;
+    if (flags.numa_local) |enabled| options.arena.numa_local = enabled;
+    if (flags.tls_cert) |path| tls_config.cert_file = path;
+    if (flags.tls_key) |path| tls_config.key_file = path;
+    if (flags.ktls) |enabled| tls_config.ktls = enabled;
+    if (flags.tls_handshake_threads) |n| tls_config.handshake_threads = n;
+    if (flags.tls_session_tickets) |mode| tls_config.session_tickets = mode;
+    if (flags.tls_ticket_key_file) |path| tls_config.ticket_key_file = path;
+    if (tls_config.enabled()) {
+        options.tls = .{
+            .cert_file = tls_config.cert_file.?,
+            .key_file = tls_config.key_file.?,
+            .ktls = tls_config.ktls,
+            .handshake_threads = tls_config.handshake_threads,
+            .session_tickets = switch (tls_config.session_tickets) {
+                .stateless => .stateless,
+                .stateful => .stateful,
+                .off => .off,
+            },
+            .session_cache_size = tls_config.session_cache_size,
+            .ticket_key_file = tls_config.ticket_key_file,
+            .ticket_key_rotation_s = tls_config.ticket_key_rotation_s,
+        };
+    } else if (tls_config.cert_file != null or tls_config.key_file != null) {
+        std.log.err("TLS needs both a certificate and a key", .{});
+        return error.IncompleteTlsConfig;
+    }
 
+    // Each worker (including a single one) creates its own ring on its own thread
     std.log.info("Starting echo server on port {d}...", .{port});
-    try io_uring.runEchoServer(port);
+    try io_uring.runEchoServer(options);
 }
 
 fn runHttpServer(port: u16) !void {
@@ -228,7 +409,8 @@ fn handleHttpRequest(allocator: std.mem.Allocator, _: []const u8, path: []const
     var allocated_response: ?[]u8 = null;
     defer if (allocated_response) |resp| allocator.free(resp);
 
-    const requires_auth = !std.mem.eql(u8, path, "/health");
+    const route: ?JwtRoute = if (jwt_routes.match(path)) |matched| matched.handler else null;
+    const requires_auth = if (route) |r| r != .health else true;
     var authenticated = false;
     var user_claims: ?jwt.Token = null;
 
@@ -249,33 +431,39 @@ fn handleHttpRequest(allocator: std.mem.Allocator, _: []const u8, path: []const
     }
 
     if (status_code == 200) {
-        if (std.mem.eql(u8, path, "/health")) {
-            response_body = "{\"status\":\"healthy\",\"server\":\"blitz\"}";
-        } else if (std.mem.eql(u8, path, "/api/profile")) {
-            if (user_claims) |claims| {
-                const user_id = claims.payload.sub orelse "unknown";
-                const is_admin = if (claims.payload.custom_claims.get("admin")) |admin_claim| blk: {
-                    break :blk admin_claim == .bool and admin_claim.bool == true;
-                } else false;
-
-                allocated_response = try std.fmt.allocPrint(allocator, "{{\"user_id\":\"{s}\",\"profile\":{{\"name\":\"John Doe\",\"email\":\"john@example.com\"}},\"authenticated\":true,\"is_admin\":{}}}", .{ user_id, is_admin });
-                response_body = allocated_response.?;
-            } else {
-                response_body = "{\"error\":\"Authentication required\"}";
-            }
-        } else if (std.mem.eql(u8, path, "/api/admin")) {
-            var is_admin = false;
-            if (user_claims) |claims| {
-                if (claims.payload.custom_claims.get("admin")) |admin_claim| {
-                    is_admin = admin_claim == .bool and admin_claim.bool == true;
-                }
-            }
-
-            if (!is_admin) {
-                status_code = 403;
-                response_body = "{\"error\":\"Forbidden\",\"message\":\"Admin role required\"}";
-            } else {
-                response_body = "{\"message\":\"Admin access granted\"}";
+        if (route) |matched| {
+            switch (matched) {
+                .health => {
+                    response_body = "{\"status\":\"healthy\",\"server\":\"blitz\"}";
+                },
+                .profile => {
+                    if (user_claims) |claims| {
+                        const user_id = claims.payload.sub orelse "unknown";
+                        const is_admin = if (claims.payload.custom_claims.get("admin")) |admin_claim| blk: {
+                            break :blk admin_claim == .bool and admin_claim.bool == true;
+                        } else false;
+
+                        allocated_response = try std.fmt.allocPrint(allocator, "{{\"user_id\":\"{s}\",\"profile\":{{\"name\":\"John Doe\",\"email\":\"john@example.com\"}},\"authenticated\":true,\"is_admin\":{}}}", .{ user_id, is_admin });
+                        response_body = allocated_response.?;
+                    } else {
+                        response_body = "{\"error\":\"Authentication required\"}";
+                    }
+                },
+                .admin => {
+                    var is_admin = false;
+                    if (user_claims) |claims| {
+                        if (claims.payload.custom_claims.get("admin")) |admin_claim| {
+                            is_admin = admin_claim == .bool and admin_claim.bool == true;
+                        }
+                    }
+
+                    if (!is_admin) {
+                        status_code = 403;
+                        response_body = "{\"error\":\"Forbidden\",\"message\":\"Admin role required\"}";
+                    } else {
+                        response_body = "{\"message\":\"Admin access granted\"}";
+                    }
+                },
             }
         } else {
             status_code = 404;
@@ -287,31 +475,17 @@ fn handleHttpRequest(allocator: std.mem.Allocator, _: []const u8, path: []const
 }
 
 fn sendHttpResponse(stream: std.net.Stream, status_code: u16, content_type: []const u8, body: []const u8) !void {
-    const status_text = switch (status_code) {
-        200 => "OK",
-        401 => "Unauthorized",
-        403 => "Forbidden",
-        404 => "Not Found",
-        500 => "Internal Server Error",
-        else => "Unknown",
-    };
-
-    var response_buf: [2048]u8 = undefined;
-    var response_len: usize = 0;
-
-    const status_line = try std.fmt.bufPrint(response_buf[response_len..], "HTTP/1.1 {d} {s}\r\n", .{ status_code, status_text });
-    response_len += status_line.len;
-
-    const content_type_header = try std.fmt.bufPrint(response_buf[response_len..], "Content-Type: {s}\r\n", .{content_type});
-    response_len += content_type_header.len;
-
-    const content_length_header = try std.fmt.bufPrint(response_buf[response_len..], "Content-Length: {}\r\n\r\n", .{body.len});
-    response_len += content_length_header.len;
-
-    @memcpy(response_buf[response_len .. response_len + body.len], body);
-    response_len += body.len;
-
-    _ = try stream.write(response_buf[0..response_len]);
+    var head_buf: [512]u8 = undefined;
+    var builder = http_response.ResponseBuilder.init(&head_buf);
+    try builder.status(status_code);
+    try builder.header("Content-Type", content_type);
+    try builder.contentLength(body.len);
+    try builder.date();
+    try builder.end();
+
+    // Head and body go out in one writev; the body is never copied
+    const iovecs = builder.iovecs(body);
+    _ = try std.posix.writev(stream.handle, &iovecs);
 }
 
 fn runLoadBalancerMode(allocator: std.mem.Allocator, cfg: *const config.Config) !void {
@@ -0,0 +1,177 @@
+// Connection-ID routing for multi-worker QUIC
+//
+// Every worker owns one SO_REUSEPORT socket, its own ring and its own
+// connection table. The first byte of each connection ID the server issues
+// is the index of the worker that owns the connection. A small socket-filter
+// program attached with SO_ATTACH_REUSEPORT_EBPF reads that byte out of the
+// DCID of each datagram and returns it as the socket index in the reuseport
+// group, so every packet of a connection lands on its owner's socket and no
+// table is ever shared between threads.
+//
+// A client's first Initial carries a DCID the client made up. Its first byte
+// modulo the worker count still picks a fixed worker (retransmits go to the
+// same place), and that worker then issues CIDs carrying its own index.
+
+const std = @import("std");
+const linux = std.os.linux;
+
+// Import io_uring C bindings from parent module for type compatibility
+const io_uring_mod = @import("../core/io_uring.zig");
+const c = io_uring_mod.c;
+
+/// Length of every server-issued connection ID
+pub const CID_LEN = 8;
+/// The worker index is one byte of the CID
+pub const MAX_WORKERS = 256;
+
+// <asm-generic/socket.h>
+const SO_ATTACH_REUSEPORT_EBPF: c_int = 52;
+
+// <linux/bpf.h>
+const BPF_PROG_LOAD = 5;
+const BPF_PROG_TYPE_SOCKET_FILTER = 1;
+
+// Returned when the DCID can't be read: out of range, so the kernel falls
+// back to its usual reuseport hash
+const NO_WORKER: i32 = -1;
+
+/// Fresh server CID owned by `worker`
+pub fn newConnectionId(worker: u8) [CID_LEN]u8 {
+    var cid: [CID_LEN]u8 = undefined;
+    std.crypto.random.bytes(&cid);
+    cid[0] = worker;
+    return cid;
+}
+
+/// Worker the steering program picks for a datagram; null when there is no
+/// DCID to route on. Kept in step with buildProgram.
+pub fn workerForDatagram(datagram: []const u8, worker_count: u32) ?u32 {
+    if (datagram.len == 0) return null;
+    const byte: u8 = if ((datagram[0] & 0x80) == 0) blk: {
+        // Short header: DCID right after the first byte
+        if (datagram.len < 2) return null;
+        break :blk datagram[1];
+    } else blk: {
+        // Long header: flags, version (4), DCID length, DCID
+        if (datagram.len < 7 or datagram[5] == 0) return null;
+        break :blk datagram[6];
+    };
+    return byte % worker_count;
+}
+
+// One eBPF instruction: opcode, dst/src registers, offset, immediate
+const Insn = packed struct(u64) {
+    code: u8,
+    dst: u4 = 0,
+    src: u4 = 0,
+    off: i16 = 0,
+    imm: i32 = 0,
+};
+
+fn ldAbsByte(offset: i32) Insn {
+    // BPF_LD | BPF_ABS | BPF_B; offsets are from the UDP payload
+    return .{ .code = 0x30, .imm = offset };
+}
+
+const PROGRAM_LEN = 12;
+
+// Socket filters run with skb->data at the UDP payload; an LD_ABS past the end
+// of the packet ends the program with 0, which sends runt datagrams to worker 0.
+fn buildProgram(worker_count: u32) [PROGRAM_LEN]Insn {
+    return .{
+        // r6 = ctx, which LD_ABS reads from
+        .{ .code = 0xbf, .dst = 6, .src = 1 },
+        ldAbsByte(0),
+        // Long header: jump to its DCID
+        .{ .code = 0x45, .off = 2, .imm = 0x80 },
+        ldAbsByte(1),
+        .{ .code = 0x05, .off = 3 },
+        ldAbsByte(5),
+        // Zero-length DCID: nothing to route on
+        .{ .code = 0x15, .off = 3, .imm = 0 },
+        ldAbsByte(6),
+        // w0 %= worker_count
+        .{ .code = 0x94, .imm = @intCast(worker_count) },
+        .{ .code = 0x95 },
+        .{ .code = 0xb4, .imm = NO_WORKER },
+        .{ .code = 0x95 },
+    };
+}
+
+// union bpf_attr, BPF_PROG_LOAD prefix
+const ProgLoadAttr = extern struct {
+    prog_type: u32,
+    insn_cnt: u32,
+    insns: u64,
+    license: u64,
+    log_level: u32 = 0,
+    log_size: u32 = 0,
+    log_buf: u64 = 0,
+    kern_version: u32 = 0,
+    prog_flags: u32 = 0,
+};
+
+/// Load the steering program and attach it to the reuseport group `fd`
+/// belongs to. The sockets must have been bound in worker order: the group
+/// indexes them by bind order. Fails without CAP_BPF when unprivileged BPF
+/// is disabled; the caller then keeps the kernel's 4-tuple hash.
+pub fn attachSteering(fd: c_int, worker_count: u32) !void {
+    std.debug.assert(worker_count > 1 and worker_count <= MAX_WORKERS);
+    const program = buildProgram(worker_count);
+    const license = "GPL";
+    var attr = ProgLoadAttr{
+        .prog_type = BPF_PROG_TYPE_SOCKET_FILTER,
+        .insn_cnt = PROGRAM_LEN,
+        .insns = @intFromPtr(&program),
+        .license = @intFromPtr(license.ptr),
+    };
+    const rc = linux.syscall3(.bpf, BPF_PROG_LOAD, @intFromPtr(&attr), @sizeOf(ProgLoadAttr));
+    if (linux.E.init(rc) != .SUCCESS) {
+        std.log.warn("BPF_PROG_LOAD for QUIC steering failed: {s}", .{@tagName(linux.E.init(rc))});
+        return error.SteeringProgramLoadFailed;
+    }
+    const prog_fd: c_int = @intCast(rc);
+    // The reuseport group keeps its own reference
+    defer _ = c.close(prog_fd);
+
+    if (c.setsockopt(fd, c.SOL_SOCKET, SO_ATTACH_REUSEPORT_EBPF, &prog_fd, @sizeOf(c_int)) < 0) {
+        return error.SteeringAttachFailed;
+    }
+}
+
+test "server CIDs route back to the worker that issued them" {
+    const workers = 6;
+    for (0..workers) |w| {
+        const cid = newConnectionId(@intCast(w));
+        // Short header
+        var short = [_]u8{0x40} ++ cid ++ [_]u8{ 0xaa, 0xbb };
+        try std.testing.expectEqual(@as(?u32, @intCast(w)), workerForDatagram(&short, workers));
+        // Long header (Handshake) addressed to the same CID
+        const long = [_]u8{ 0xe0, 0, 0, 0, 1, CID_LEN } ++ cid ++ [_]u8{ 8, 1, 2, 3, 4, 5, 6, 7, 8 };
+        try std.testing.expectEqual(@as(?u32, @intCast(w)), workerForDatagram(&long, workers));
+        short[1] +%= 1;
+        try std.testing.expect(workerForDatagram(&short, workers) != @as(?u32, @intCast(w)));
+    }
+
+    // A client-chosen DCID still maps to one fixed worker
+    const client_initial = [_]u8{ 0xc0, 0, 0, 0, 1, 4, 201, 7, 7, 7 };
+    try std.testing.expectEqual(@as(?u32, 201 % workers), workerForDatagram(&client_initial, workers));
+    // Nothing to route on: kernel hash
+    try std.testing.expect(workerForDatagram(&[_]u8{ 0xc0, 0, 0, 0, 1, 0, 0 }, workers) == null);
+    try std.testing.expect(workerForDatagram(&[_]u8{0x40}, workers) == null);
+}
+
+test "steering program jumps stay inside the program and every path exits" {
+    const program = buildProgram(4);
+    try std.testing.expectEqual(@as(u64, 0x30), @as(u64, @bitCast(ldAbsByte(0))) & 0xff);
+    try std.testing.expectEqual(@as(i32, 4), program[8].imm);
+    for (program, 0..) |insn, i| {
+        // BPF_JMP class with an offset
+        if ((insn.code & 0x07) == 0x05 and insn.code != 0x95) {
+            const target = @as(i64, @intCast(i)) + 1 + insn.off;
+            try std.testing.expect(target > @as(i64, @intCast(i)) and target < PROGRAM_LEN);
+        }
+    }
+    try std.testing.expectEqual(@as(u8, 0x95), program[PROGRAM_LEN - 1].code);
+    try std.testing.expectEqual(@as(u8, 0x95), program[9].code);
+}
@@ -3,6 +3,7 @@
 
 const std = @import("std");
 const packet = @import("packet.zig");
+const crypto = @import("crypto.zig");
 
 // Connection ID length (RFC 9000)
 pub const CONN_ID_LEN: usize = 8; // Default 8 bytes
@@ -25,6 +26,9 @@ pub const QuicConnection = struct {
     packet_number: u64 = 0,
     allocator: std.mem.Allocator,
 
+    // Packet protection per key epoch, set up once when the epoch's secrets arrive
+    keys: [4]?crypto.EpochKeys = .{null} ** 4,
+
     // Flow control
     max_data: u64 = 10_000_000, // Initial max data (10 MB)
     max_stream_data_bidi_local: u64 = 1_000_000,
@@ -56,6 +60,28 @@ pub const QuicConnection = struct {
             self.allocator.destroy(entry.value_ptr.*);
         }
         self.streams.deinit();
+        for (&self.keys) |*keys| {
+            if (keys.*) |*epoch_keys| epoch_keys.deinit();
+            keys.* = null;
+        }
+    }
+
+    /// Replaces (and frees) whatever the epoch had before
+    pub fn installKeys(self: *QuicConnection, epoch: crypto.Epoch, keys: crypto.EpochKeys) void {
+        const slot = &self.keys[@intFromEnum(epoch)];
+        if (slot.*) |*old| old.deinit();
+        slot.* = keys;
+    }
+
+    pub fn epochKeys(self: *QuicConnection, epoch: crypto.Epoch) ?*crypto.EpochKeys {
+        return if (self.keys[@intFromEnum(epoch)]) |*keys| keys else null;
+    }
+
+    /// Initial keys are discarded once Handshake keys are in use (RFC 9001 Section 4.9.1)
+    pub fn dropKeys(self: *QuicConnection, epoch: crypto.Epoch) void {
+        const slot = &self.keys[@intFromEnum(epoch)];
+        if (slot.*) |*keys| keys.deinit();
+        slot.* = null;
     }
 
     pub fn getOrCreateStream(self: *QuicConnection, stream_id: u64) !*Stream {
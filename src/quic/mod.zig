@@ -26,6 +26,9 @@ pub const ZeroRttSecrets = @import("crypto.zig").ZeroRttSecrets;
 pub const deriveInitialSecrets = @import("crypto.zig").deriveInitialSecrets;
 pub const decryptPayload = @import("crypto.zig").decryptPayload;
 pub const encryptPayload = @import("crypto.zig").encryptPayload;
+pub const EpochKeys = @import("crypto.zig").EpochKeys;
+pub const PacketKeys = @import("crypto.zig").PacketKeys;
+pub const Epoch = @import("crypto.zig").Epoch;
 
 pub const TransportParameters = @import("transport_params.zig").TransportParameters;
 pub const TransportParameterId = @import("transport_params.zig").TransportParameterId;
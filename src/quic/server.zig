@@ -9,6 +9,9 @@ const handshake = @import("handshake.zig");
 const udp = @import("udp.zig");
 // const tls = @import("../tls/tls.zig"); // Temporarily disabled for picotls migration
 const frames = @import("frames.zig");
+const crypto = @import("crypto.zig");
+const cid_routing = @import("cid_routing.zig");
+const slab = @import("../core/allocator.zig");
 
 // QUIC Server Connection
 pub const QuicServerConnection = struct {
@@ -65,6 +68,10 @@ pub const QuicServerConnection = struct {
             .long => |long_pkt| {
                 switch (long_pkt.packet_type) {
                     packet.PACKET_TYPE_INITIAL => {
+                        // Initial keys come from the client's first DCID; derive them once
+                        if (self.quic_conn.epochKeys(.initial) == null) {
+                            self.quic_conn.installKeys(.initial, try crypto.EpochKeys.initial(long_pkt.dest_conn_id));
+                        }
                         // Extract CRYPTO frames from payload
                         // For now, assume payload contains CRYPTO frame data
                         try self.handshake_mgr.processInitialPacket(long_pkt.payload, @ptrCast(ssl));
@@ -127,8 +134,15 @@ pub const QuicServerConnection = struct {
 // QUIC Server
 pub const QuicServer = struct {
     udp_fd: c_int,
+    // Issued CIDs carry this in their first byte (see cid_routing.zig)
+    worker_id: u8 = 0,
+    // Keyed by the client's CID, which long headers carry as SCID
     connections: std.HashMap([]const u8, *QuicServerConnection, ConnectionIdContext, std.hash_map.default_max_load_percentage),
+    // Keyed by the CID we issued, which short headers carry as DCID; keys are owned by the connection
+    local_ids: std.HashMap([]const u8, *QuicServerConnection, ConnectionIdContext, std.hash_map.default_max_load_percentage),
     allocator: std.mem.Allocator,
+    // Connection objects and their per-connection state
+    conn_slab: slab.SlabAllocator,
     ssl_ctx: ?*anyopaque = null, // SSL_CTX* for TLS (context for creating SSL connections)
 
     const ConnectionIdContext = struct {
@@ -143,22 +157,32 @@ pub const QuicServer = struct {
     };
 
     pub fn init(allocator: std.mem.Allocator, port: u16) !QuicServer {
-        const udp_fd = try udp.createUdpSocket(port);
+        return initWorker(allocator, try udp.createUdpSocket(port, false), 0);
+    }
 
+    /// One of several workers sharing the port; takes ownership of udp_fd
+    pub fn initWorker(allocator: std.mem.Allocator, udp_fd: c_int, worker_id: u8) QuicServer {
         return QuicServer{
             .udp_fd = udp_fd,
+            .worker_id = worker_id,
             .connections = std.HashMap([]const u8, *QuicServerConnection, ConnectionIdContext, std.hash_map.default_max_load_percentage).init(allocator),
+            .local_ids = std.HashMap([]const u8, *QuicServerConnection, ConnectionIdContext, std.hash_map.default_max_load_percentage).init(allocator),
             .allocator = allocator,
+            .conn_slab = slab.SlabAllocator.init(allocator),
         };
     }
 
     pub fn deinit(self: *QuicServer) void {
+        const conn_allocator = self.conn_slab.allocator();
         var it = self.connections.iterator();
         while (it.next()) |entry| {
             entry.value_ptr.*.deinit();
-            self.allocator.destroy(entry.value_ptr.*);
+            conn_allocator.destroy(entry.value_ptr.*);
+            conn_allocator.free(entry.key_ptr.*);
         }
         self.connections.deinit();
+        self.local_ids.deinit();
+        self.conn_slab.deinit();
         _ = c.close(self.udp_fd);
     }
 
@@ -173,24 +197,28 @@ pub const QuicServer = struct {
             return;
         }
 
-        const parsed = packet.Packet.parse(data, 8) catch |err| {
+        const parsed = packet.Packet.parse(data, cid_routing.CID_LEN) catch |err| {
             std.log.debug("Failed to parse QUIC packet: {any}", .{err});
             return;
         };
 
-        const remote_conn_id = switch (parsed) {
-            .long => |p| p.src_conn_id,
-            .short => |p| p.dest_conn_id,
-        };
-
         // Look up or create connection
-        const conn = try self.getOrCreateConnection(remote_conn_id, client_addr);
+        const conn = try self.connectionFor(parsed, client_addr) orelse return;
 
         // TODO: Create SSL connection from SSL_CTX for this connection
         // For now, pass null (handshake will need to be initialized properly)
         try conn.processPacket(data, null);
     }
 
+    /// Connection a parsed packet belongs to. Long headers may open one;
+    /// short headers only match a CID this worker issued.
+    pub fn connectionFor(self: *QuicServer, parsed: packet.Packet, client_addr: std.net.Ip4Address) !?*QuicServerConnection {
+        return switch (parsed) {
+            .long => |p| try self.getOrCreateConnection(p.src_conn_id, client_addr),
+            .short => |p| self.local_ids.get(p.dest_conn_id),
+        };
+    }
+
     pub fn getOrCreateConnection(
         self: *QuicServer,
         remote_conn_id: []const u8,
@@ -201,21 +229,27 @@ pub const QuicServer = struct {
             return existing;
         }
 
-        // Generate local connection ID
-        var local_conn_id: [8]u8 = undefined;
-        std.crypto.random.bytes(&local_conn_id);
+        // Local connection ID, routed back to this worker
+        var local_conn_id = cid_routing.newConnectionId(self.worker_id);
+        while (self.local_ids.contains(&local_conn_id)) local_conn_id = cid_routing.newConnectionId(self.worker_id);
 
         // Create new connection
-        const conn = try self.allocator.create(QuicServerConnection);
+        const conn_allocator = self.conn_slab.allocator();
+        const conn = try conn_allocator.create(QuicServerConnection);
+        errdefer conn_allocator.destroy(conn);
         conn.* = try QuicServerConnection.init(
-            self.allocator,
+            conn_allocator,
             &local_conn_id,
             remote_conn_id,
             client_addr,
         );
+        errdefer conn.deinit();
 
         // Store connection (using remote_conn_id as key)
-        const conn_id_copy = try self.allocator.dupe(u8, remote_conn_id);
+        const conn_id_copy = try conn_allocator.dupe(u8, remote_conn_id);
+        errdefer conn_allocator.free(conn_id_copy);
+        try self.local_ids.put(conn.quic_conn.local_conn_id, conn);
+        errdefer _ = self.local_ids.remove(conn.quic_conn.local_conn_id);
         try self.connections.put(conn_id_copy, conn);
 
         return conn;
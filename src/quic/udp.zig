@@ -8,8 +8,8 @@ const builtin = @import("builtin");
 const io_uring_mod = @import("../core/io_uring.zig");
 const c = io_uring_mod.c;
 
-// Create UDP socket for QUIC
-pub fn createUdpSocket(port: u16) !c_int {
+// Create UDP socket for QUIC; reuse_port lets each worker bind its own socket to the port
+pub fn createUdpSocket(port: u16, reuse_port: bool) !c_int {
     const sockfd = c.socket(c.AF_INET, c.SOCK_DGRAM | c.SOCK_NONBLOCK, 0);
     if (sockfd < 0) {
         return error.SocketCreationFailed;
@@ -18,6 +18,11 @@ pub fn createUdpSocket(port: u16) !c_int {
     // Enable SO_REUSEADDR
     const opt: c_int = 1;
     _ = c.setsockopt(sockfd, c.SOL_SOCKET, c.SO_REUSEADDR, &opt, @sizeOf(c_int));
+    if (reuse_port and c.setsockopt(sockfd, c.SOL_SOCKET, c.SO_REUSEPORT, &opt, @sizeOf(c_int)) < 0) {
+        std.log.err("setsockopt(SO_REUSEPORT) failed on UDP port {d}", .{port});
+        _ = c.close(sockfd);
+        return error.ReusePortFailed;
+    }
 
     // Bind to port
     var addr: c.struct_sockaddr_in = std.mem.zeroes(c.struct_sockaddr_in);
@@ -0,0 +1,279 @@
+// Batched datagram I/O for the QUIC server
+//
+// Receive: a single multishot recvmsg stays armed on the socket and the
+// kernel picks a 64 KiB provided buffer per completion. With UDP_GRO enabled
+// a burst of same-flow datagrams arrives coalesced in one buffer (and one
+// CQE); the UDP_GRO cmsg gives the segment size to split it back apart.
+//
+// Send: responses for the same peer are packed back to back into one
+// SendBatch and leave in a single sendmsg carrying UDP_SEGMENT (GSO); the
+// kernel, or the NIC, cuts it into datagrams.
+
+const std = @import("std");
+
+// Import io_uring C bindings from parent module for type compatibility
+const io_uring_mod = @import("../core/io_uring.zig");
+const c = io_uring_mod.c;
+
+// <netinet/udp.h> / <linux/udp.h>
+const SOL_UDP: c_int = 17;
+const UDP_SEGMENT: c_int = 103;
+const UDP_GRO: c_int = 104;
+
+// Largest GRO super-datagram, plus room for the recvmsg_out header, address and cmsgs
+pub const RECV_BUFFER_SIZE = 65536 + 4096;
+pub const RECV_RING_ENTRIES = 64; // Provided buffers (power of two)
+pub const RECV_BUFFER_GROUP: c_int = 1; // Distinct from the TCP workers' group 0
+// UDP_MAX_SEGMENTS on kernels before 6.1; later ones allow 128
+pub const MAX_SEGMENTS = 64;
+// IPv4 UDP payload limit, which also bounds a GSO send
+pub const MAX_GSO_BYTES = 65507;
+
+const CMSG_HDR_LEN = @sizeOf(CmsgHdr);
+// CMSG_SPACE(sizeof(int)): the UDP_GRO cmsg on receive
+const RECV_CONTROL_LEN = CMSG_HDR_LEN + 8;
+// CMSG_SPACE(sizeof(u16)): the UDP_SEGMENT cmsg on send
+const SEND_CONTROL_LEN = CMSG_HDR_LEN + 8;
+
+const CmsgHdr = extern struct {
+    len: usize,
+    level: c_int,
+    type: c_int,
+};
+
+// struct io_uring_recvmsg_out, at the start of every multishot recvmsg buffer
+const RecvMsgOut = extern struct {
+    namelen: u32,
+    controllen: u32,
+    payloadlen: u32,
+    flags: u32,
+};
+
+/// Ask the kernel to coalesce same-flow datagrams; false on kernels without UDP_GRO
+pub fn enableGro(fd: c_int) bool {
+    const on: c_int = 1;
+    return c.setsockopt(fd, SOL_UDP, UDP_GRO, &on, @sizeOf(c_int)) == 0;
+}
+
+/// Whether sendmsg accepts UDP_SEGMENT here (Linux 4.18+)
+pub fn gsoSupported(fd: c_int) bool {
+    const off: c_int = 0;
+    return c.setsockopt(fd, SOL_UDP, UDP_SEGMENT, &off, @sizeOf(c_int)) == 0;
+}
+
+// Provided buffers for the multishot recvmsg; each goes back to the kernel
+// as soon as its burst has been handled
+pub const RecvRing = struct {
+    br: *c.struct_io_uring_buf_ring,
+    memory: []align(std.heap.page_size_min) u8,
+    // Template the kernel reads on every completion: how much room to leave
+    // for the address and cmsgs ahead of the payload
+    msg: c.struct_msghdr,
+
+    pub fn init(ring: *c.struct_io_uring, allocator: std.mem.Allocator) !RecvRing {
+        const memory = try allocator.alignedAlloc(u8, .fromByteUnits(std.heap.page_size_min), RECV_RING_ENTRIES * RECV_BUFFER_SIZE);
+        errdefer allocator.free(memory);
+
+        var ret: c_int = 0;
+        const br_opt: ?*c.struct_io_uring_buf_ring = c.io_uring_setup_buf_ring(ring, RECV_RING_ENTRIES, RECV_BUFFER_GROUP, 0, &ret);
+        const br = br_opt orelse {
+            std.log.warn("io_uring_setup_buf_ring failed for QUIC receive: {d}", .{ret});
+            return error.BufferRingSetupFailed;
+        };
+
+        var self = RecvRing{ .br = br, .memory = memory, .msg = std.mem.zeroes(c.struct_msghdr) };
+        self.msg.msg_namelen = @sizeOf(c.struct_sockaddr_in);
+        self.msg.msg_controllen = RECV_CONTROL_LEN;
+        for (0..RECV_RING_ENTRIES) |bid| {
+            io_uring_mod.blitz_buf_ring_add(br, self.get(@intCast(bid)).ptr, RECV_BUFFER_SIZE, @intCast(bid), RECV_RING_ENTRIES - 1, @intCast(bid));
+        }
+        io_uring_mod.blitz_buf_ring_advance(br, RECV_RING_ENTRIES);
+        return self;
+    }
+
+    pub fn deinit(self: *RecvRing, ring: *c.struct_io_uring, allocator: std.mem.Allocator) void {
+        _ = c.io_uring_free_buf_ring(ring, self.br, RECV_RING_ENTRIES, RECV_BUFFER_GROUP);
+        allocator.free(self.memory);
+    }
+
+    /// Arm (or re-arm, once a CQE arrives without IORING_CQE_F_MORE) the multishot recvmsg
+    pub fn prepRecv(self: *RecvRing, sqe: *c.struct_io_uring_sqe, fd: c_int) void {
+        io_uring_mod.blitz_prep_recvmsg_multishot(sqe, fd, &self.msg, RECV_BUFFER_GROUP);
+    }
+
+    pub fn get(self: *const RecvRing, bid: u16) []u8 {
+        return self.memory[@as(usize, bid) * RECV_BUFFER_SIZE ..][0..RECV_BUFFER_SIZE];
+    }
+
+    pub fn recycle(self: *RecvRing, bid: u16) void {
+        io_uring_mod.blitz_buf_ring_add(self.br, self.get(bid).ptr, RECV_BUFFER_SIZE, bid, RECV_RING_ENTRIES - 1, 0);
+        io_uring_mod.blitz_buf_ring_advance(self.br, 1);
+    }
+
+    /// The datagrams one completion delivered, or null if the kernel had to truncate them
+    pub fn burst(self: *const RecvRing, bid: u16, res: usize) ?Burst {
+        return parseBurst(self.get(bid)[0..res], self.msg.msg_namelen, self.msg.msg_controllen);
+    }
+};
+
+/// Datagrams from one peer, coalesced by GRO; next() hands them out one at a time
+pub const Burst = struct {
+    peer: c.struct_sockaddr_in,
+    data: []u8,
+    segment_size: usize,
+
+    pub fn next(self: *Burst) ?[]u8 {
+        if (self.data.len == 0) return null;
+        const len = @min(self.segment_size, self.data.len);
+        const datagram = self.data[0..len];
+        self.data = self.data[len..];
+        return datagram;
+    }
+};
+
+fn parseBurst(buf: []u8, name_space: usize, control_space: usize) ?Burst {
+    if (buf.len < @sizeOf(RecvMsgOut)) return null;
+    const out = std.mem.bytesToValue(RecvMsgOut, buf[0..@sizeOf(RecvMsgOut)]);
+    if (out.flags & (c.MSG_TRUNC | c.MSG_CTRUNC) != 0) return null;
+    if (out.namelen < @sizeOf(c.struct_sockaddr_in) or out.namelen > name_space) return null;
+
+    const name_offset = @sizeOf(RecvMsgOut);
+    const control_offset = name_offset + name_space;
+    const payload_offset = control_offset + control_space;
+    if (payload_offset + out.payloadlen > buf.len) return null;
+
+    var self = Burst{
+        .peer = std.mem.bytesToValue(c.struct_sockaddr_in, buf[name_offset..][0..@sizeOf(c.struct_sockaddr_in)]),
+        .data = buf[payload_offset..][0..out.payloadlen],
+        .segment_size = out.payloadlen,
+    };
+
+    // Without a UDP_GRO cmsg the buffer holds a single datagram
+    const control = buf[control_offset..][0..@min(out.controllen, control_space)];
+    var offset: usize = 0;
+    while (offset + CMSG_HDR_LEN <= control.len) {
+        const hdr = std.mem.bytesToValue(CmsgHdr, control[offset..][0..CMSG_HDR_LEN]);
+        if (hdr.len < CMSG_HDR_LEN or offset + hdr.len > control.len) break;
+        if (hdr.level == SOL_UDP and hdr.type == UDP_GRO and hdr.len >= CMSG_HDR_LEN + @sizeOf(c_int)) {
+            const gso_size = std.mem.bytesToValue(c_int, control[offset + CMSG_HDR_LEN ..][0..@sizeOf(c_int)]);
+            if (gso_size > 0) self.segment_size = @intCast(gso_size);
+        }
+        offset += std.mem.alignForward(usize, hdr.len, @alignOf(CmsgHdr));
+    }
+    return self;
+}
+
+// Datagrams for one peer, sent with one sendmsg. GSO needs every segment but
+// the last to be exactly segment_size bytes; append() refuses anything that
+// would break that and the caller starts a new batch.
+pub const SendBatch = struct {
+    data: [MAX_GSO_BYTES]u8 = undefined,
+    len: usize = 0,
+    segment_size: usize = 0,
+    segments: usize = 0,
+    peer: c.struct_sockaddr_in = undefined,
+    // Read by the kernel until the send completes
+    iov: c.struct_iovec = undefined,
+    msg: c.struct_msghdr = undefined,
+    control: [SEND_CONTROL_LEN]u8 align(@alignOf(CmsgHdr)) = undefined,
+
+    pub fn reset(self: *SendBatch) void {
+        self.len = 0;
+        self.segment_size = 0;
+        self.segments = 0;
+    }
+
+    pub fn samePeer(self: *const SendBatch, peer: *const c.struct_sockaddr_in) bool {
+        return self.peer.sin_addr.s_addr == peer.sin_addr.s_addr and self.peer.sin_port == peer.sin_port;
+    }
+
+    /// Add a datagram; false if it has to go in a new batch
+    pub fn append(self: *SendBatch, peer: *const c.struct_sockaddr_in, datagram: []const u8, max_segments: usize) bool {
+        if (datagram.len == 0 or datagram.len > MAX_GSO_BYTES) return false;
+        if (self.segments == 0) {
+            self.peer = peer.*;
+            self.segment_size = datagram.len;
+        } else {
+            if (!self.samePeer(peer) or self.segments >= max_segments) return false;
+            // A short segment ends the batch
+            if (datagram.len > self.segment_size or self.len % self.segment_size != 0) return false;
+            if (self.len + datagram.len > MAX_GSO_BYTES) return false;
+        }
+        @memcpy(self.data[self.len..][0..datagram.len], datagram);
+        self.len += datagram.len;
+        self.segments += 1;
+        return true;
+    }
+
+    pub fn prepSend(self: *SendBatch, sqe: *c.struct_io_uring_sqe, fd: c_int) void {
+        self.iov = .{ .iov_base = &self.data, .iov_len = self.len };
+        self.msg = std.mem.zeroes(c.struct_msghdr);
+        self.msg.msg_name = &self.peer;
+        self.msg.msg_namelen = @sizeOf(c.struct_sockaddr_in);
+        self.msg.msg_iov = &self.iov;
+        self.msg.msg_iovlen = 1;
+        if (self.segments > 1) {
+            const hdr = CmsgHdr{ .len = CMSG_HDR_LEN + @sizeOf(u16), .level = SOL_UDP, .type = UDP_SEGMENT };
+            @memset(&self.control, 0);
+            @memcpy(self.control[0..CMSG_HDR_LEN], std.mem.asBytes(&hdr));
+            std.mem.writeInt(u16, self.control[CMSG_HDR_LEN..][0..2], @intCast(self.segment_size), .little);
+            self.msg.msg_control = &self.control;
+            self.msg.msg_controllen = SEND_CONTROL_LEN;
+        }
+        c.io_uring_prep_sendmsg(sqe, fd, &self.msg, 0);
+    }
+};
+
+test "GRO burst splits at the segment size" {
+    var buf: [256]u8 align(8) = [_]u8{0} ** 256;
+    const name_space = @sizeOf(c.struct_sockaddr_in);
+    const control_space = RECV_CONTROL_LEN;
+    const payload_offset = @sizeOf(RecvMsgOut) + name_space + control_space;
+
+    const out = RecvMsgOut{ .namelen = name_space, .controllen = control_space, .payloadlen = 25, .flags = 0 };
+    @memcpy(buf[0..@sizeOf(RecvMsgOut)], std.mem.asBytes(&out));
+    var peer = std.mem.zeroes(c.struct_sockaddr_in);
+    peer.sin_port = 0x1234;
+    @memcpy(buf[@sizeOf(RecvMsgOut)..][0..name_space], std.mem.asBytes(&peer));
+    const control_offset = @sizeOf(RecvMsgOut) + name_space;
+    const hdr = CmsgHdr{ .len = CMSG_HDR_LEN + @sizeOf(c_int), .level = SOL_UDP, .type = UDP_GRO };
+    @memcpy(buf[control_offset..][0..CMSG_HDR_LEN], std.mem.asBytes(&hdr));
+    std.mem.writeInt(c_int, buf[control_offset + CMSG_HDR_LEN ..][0..@sizeOf(c_int)], 10, .little);
+    for (buf[payload_offset..][0..25], 0..) |*byte, i| byte.* = @intCast(i);
+
+    var burst = parseBurst(buf[0 .. payload_offset + 25], name_space, control_space).?;
+    try std.testing.expectEqual(@as(u16, 0x1234), burst.peer.sin_port);
+    try std.testing.expectEqual(@as(usize, 10), burst.next().?.len);
+    try std.testing.expectEqual(@as(u8, 10), burst.next().?[0]);
+    try std.testing.expectEqual(@as(usize, 5), burst.next().?.len);
+    try std.testing.expect(burst.next() == null);
+
+    // Truncated by the kernel: dropped
+    const truncated = RecvMsgOut{ .namelen = name_space, .controllen = 0, .payloadlen = 25, .flags = c.MSG_TRUNC };
+    @memcpy(buf[0..@sizeOf(RecvMsgOut)], std.mem.asBytes(&truncated));
+    try std.testing.expect(parseBurst(buf[0 .. payload_offset + 25], name_space, control_space) == null);
+}
+
+test "send batch keeps GSO segments equal except the last" {
+    var batch = SendBatch{};
+    var peer = std.mem.zeroes(c.struct_sockaddr_in);
+    peer.sin_port = 443;
+    var other = peer;
+    other.sin_port = 444;
+
+    const full = [_]u8{0xaa} ** 1200;
+    try std.testing.expect(batch.append(&peer, &full, MAX_SEGMENTS));
+    try std.testing.expect(batch.append(&peer, &full, MAX_SEGMENTS));
+    try std.testing.expect(!batch.append(&other, &full, MAX_SEGMENTS));
+    try std.testing.expect(!batch.append(&peer, &([_]u8{0} ** 1300), MAX_SEGMENTS));
+    try std.testing.expect(batch.append(&peer, full[0..300], MAX_SEGMENTS));
+    // Nothing may follow a short segment
+    try std.testing.expect(!batch.append(&peer, full[0..300], MAX_SEGMENTS));
+    try std.testing.expectEqual(@as(usize, 3), batch.segments);
+    try std.testing.expectEqual(@as(usize, 2700), batch.len);
+
+    // Without GSO every datagram is its own batch
+    batch.reset();
+    try std.testing.expect(batch.append(&peer, &full, 1));
+    try std.testing.expect(!batch.append(&peer, &full, 1));
+}
@@ -11,6 +11,8 @@ const c = io_uring_mod.c;
 const server_mod = @import("server.zig");
 const packet = @import("packet.zig");
 const udp = @import("udp.zig");
+const udp_batch = @import("udp_batch.zig");
+const cid_routing = @import("cid_routing.zig");
 // const tls = @import("../tls/tls.zig"); // Temporarily disabled for picotls migration
 
 // Buffer pool for UDP packets
@@ -78,6 +80,9 @@ const UserData = struct {
     pub const Operation = enum {
         recvfrom,
         sendto,
+        recvmsg, // Multishot, with provided buffers
+        sendmsg, // buffer_idx is a SendQueue batch
+        stop, // Poll on the eventfd that shuts every worker down
     };
 };
 
@@ -105,25 +110,356 @@ fn setSqeData(sqe: *c.struct_io_uring_sqe, user_data: u64) void {
     c.io_uring_sqe_set_data(sqe, @as(?*anyopaque, @ptrFromInt(user_data)));
 }
 
-// Run QUIC UDP server with io_uring event loop
-pub fn runQuicServer(ring: *c.struct_io_uring, port: u16) !void {
+pub const QuicServerOptions = struct {
+    /// Multishot recvmsg with GRO and GSO sendmsg; false posts one recv and one sendto per datagram
+    batched_io: bool = true,
+    /// Workers, each with its own socket, ring, connection table and thread (the last one
+    /// runs on the calling thread); 0 = one per CPU.
+    /// Datagrams are steered to the owning worker by connection ID (see cid_routing.zig).
+    workers: u32 = 1,
+};
+
+// Datagram rates, logged every STATS_INTERVAL_MS while traffic flows
+const STATS_INTERVAL_MS = 5000;
+
+const IoStats = struct {
+    datagrams_in: u64 = 0,
+    recv_completions: u64 = 0,
+    datagrams_out: u64 = 0,
+    sends: u64 = 0,
+    dropped: u64 = 0,
+    window_start: i64,
+
+    fn init() IoStats {
+        return .{ .window_start = std.time.milliTimestamp() };
+    }
+
+    fn maybeReport(self: *IoStats, path: []const u8, worker_id: u8) void {
+        const now = std.time.milliTimestamp();
+        const elapsed_ms = now - self.window_start;
+        if (elapsed_ms < STATS_INTERVAL_MS) return;
+        const seconds = @as(f64, @floatFromInt(elapsed_ms)) / 1000.0;
+        std.log.info("QUIC UDP worker {d} ({s}): {d:.0} datagrams/s in ({d:.1} per recv completion), {d:.0} datagrams/s out ({d:.1} per send), {} dropped", .{
+            worker_id,
+            path,
+            @as(f64, @floatFromInt(self.datagrams_in)) / seconds,
+            perOp(self.datagrams_in, self.recv_completions),
+            @as(f64, @floatFromInt(self.datagrams_out)) / seconds,
+            perOp(self.datagrams_out, self.sends),
+            self.dropped,
+        });
+        self.* = .{ .window_start = now };
+    }
+
+    fn perOp(count: u64, ops: u64) f64 {
+        if (ops == 0) return 0;
+        return @as(f64, @floatFromInt(count)) / @as(f64, @floatFromInt(ops));
+    }
+};
+
+// Run QUIC UDP server with io_uring event loop. The last worker serves on
+// `ring` on the calling thread; every other one sets up its own ring on its own thread.
+pub fn runQuicServer(ring: *c.struct_io_uring, port: u16, options: QuicServerOptions) !void {
+    const cpu_count: usize = std.Thread.getCpuCount() catch 1;
+    const requested: usize = if (options.workers == 0) cpu_count else options.workers;
+    const worker_count = @min(requested, cid_routing.MAX_WORKERS);
+
+    if (worker_count == 1) {
+        std.log.info("QUIC server listening on UDP port {d}", .{port});
+        return serveWorker(ring, try udp.createUdpSocket(port, false), 0, options, null);
+    }
+
+    const worker_allocator = std.heap.page_allocator;
+    const server_fds = try worker_allocator.alloc(c_int, worker_count);
+    defer worker_allocator.free(server_fds);
+    const threads = try worker_allocator.alloc(std.Thread, worker_count);
+    defer worker_allocator.free(threads);
+
+    // Bind every socket up front and in worker order: the reuseport group
+    // numbers its sockets by bind order, and the steering program returns that number
+    var bound: usize = 0;
+    // Sockets [0..handed_off) belong to a worker, which closes its own
+    var handed_off: usize = 0;
+    errdefer for (server_fds[handed_off..bound]) |fd| {
+        _ = c.close(fd);
+    };
+    while (bound < worker_count) : (bound += 1) {
+        server_fds[bound] = try udp.createUdpSocket(port, true);
+    }
+
+    cid_routing.attachSteering(server_fds[0], @intCast(worker_count)) catch |err| {
+        std.log.warn("QUIC connection-ID steering unavailable ({any}); the kernel's 4-tuple hash picks the worker, so a client that changes address loses its connection", .{err});
+    };
+    std.log.info("QUIC server listening on UDP port {d} with {d} workers", .{ port, worker_count });
+
+    // Workers only return on error. Whatever ends this function (a failed
+    // spawn, or the last worker's loop) bumps this eventfd, which every worker
+    // keeps a poll on, so the joins below don't wait forever.
+    const stop_fd = try std.posix.eventfd(0, std.os.linux.EFD.CLOEXEC);
+    defer std.posix.close(stop_fd);
+
+    const last = worker_count - 1;
+    var spawned: usize = 0;
+    defer {
+        const one: u64 = 1;
+        _ = std.posix.write(stop_fd, std.mem.asBytes(&one)) catch 0;
+        for (threads[0..spawned]) |thread| thread.join();
+    }
+    while (spawned < last) : (spawned += 1) {
+        threads[spawned] = try std.Thread.spawn(.{}, workerMain, .{
+            server_fds[spawned],
+            @as(u32, @intCast(spawned)),
+            spawned % cpu_count,
+            options,
+            stop_fd,
+        });
+        handed_off = spawned + 1;
+    }
+
+    // The last worker runs here, on the ring the caller already set up
+    handed_off = worker_count;
+    pinWorker(@intCast(last), last % cpu_count);
+    try serveWorker(ring, server_fds[last], @intCast(last), options, stop_fd);
+}
+
+fn pinWorker(worker_id: u32, cpu: usize) void {
+    if (io_uring_mod.blitz_pin_to_cpu(@intCast(cpu)) != 0) {
+        std.log.warn("QUIC worker {}: failed to pin to CPU {}", .{ worker_id, cpu });
+    }
+}
+
+fn workerMain(fd: c_int, worker_id: u32, cpu: usize, options: QuicServerOptions, stop_fd: c_int) void {
+    pinWorker(worker_id, cpu);
+
+    serveOwnRing(fd, worker_id, options, stop_fd) catch |err| {
+        std.log.err("QUIC worker {} stopped: {}", .{ worker_id, err });
+    };
+}
+
+// Create the worker's ring on the calling thread (required for SINGLE_ISSUER) and run its loop
+fn serveOwnRing(fd: c_int, worker_id: u32, options: QuicServerOptions, stop_fd: c_int) !void {
+    var worker_ring: c.struct_io_uring = undefined;
+    const mode = io_uring_mod.initRing(&worker_ring, .{}, worker_id) catch |err| {
+        _ = c.close(fd);
+        return err;
+    };
+    defer c.io_uring_queue_exit(&worker_ring);
+
+    std.log.info("QUIC worker {}: {s} ring", .{ worker_id, @tagName(mode) });
+    try serveWorker(&worker_ring, fd, worker_id, options, stop_fd);
+}
+
+// One worker's event loop; owns fd from here on. Returns once stop_fd becomes readable.
+fn serveWorker(ring: *c.struct_io_uring, fd: c_int, worker_id: u32, options: QuicServerOptions, stop_fd: ?c_int) !void {
     var gpa = std.heap.GeneralPurposeAllocator(.{}){};
     defer _ = gpa.deinit();
     const allocator = gpa.allocator();
 
     // Initialize QUIC server
-    var quic_server = try server_mod.QuicServer.init(allocator, port);
+    var quic_server = server_mod.QuicServer.initWorker(allocator, fd, @intCast(worker_id));
     defer quic_server.deinit();
 
     // TLS context initialization disabled for PicoTLS migration
     // TODO: Re-enable TLS context when PicoTLS integration is complete
     quic_server.ssl_ctx = null;
 
+    // Stays armed across the fallback below: both loops return on its completion
+    if (stop_fd) |stop| {
+        const sqe = getSqe(ring) orelse return error.SubmissionQueueFull;
+        c.io_uring_prep_poll_add(sqe, stop, std.os.linux.POLL.IN);
+        setSqeData(sqe, encodeUserData(stop, .stop, 0));
+    }
+
+    if (options.batched_io) fallback: {
+        serveBatched(ring, &quic_server, allocator) catch |err| switch (err) {
+            error.BufferRingSetupFailed, error.MultishotRecvmsgUnsupported => {
+                std.log.warn("Batched UDP I/O unavailable ({any}), falling back to one recv per datagram", .{err});
+                break :fallback;
+            },
+            else => return err,
+        };
+        return;
+    }
+    try serveSingle(ring, &quic_server, allocator);
+}
+
+// Batches of responses not yet submitted, at most one open per peer. Everything
+// queued while handling one round of completions goes out before the next wait.
+const SEND_BATCHES = 64;
+const MAX_OPEN_BATCHES = 8;
+
+const SendQueue = struct {
+    batches: []udp_batch.SendBatch,
+    free_list: std.ArrayList(usize),
+    open: [MAX_OPEN_BATCHES]usize = undefined,
+    open_count: usize = 0,
+    // 1 without GSO: each datagram is its own sendmsg
+    max_segments: usize,
+    allocator: std.mem.Allocator,
+
+    fn init(allocator: std.mem.Allocator, gso: bool) !SendQueue {
+        const batches = try allocator.alloc(udp_batch.SendBatch, SEND_BATCHES);
+        errdefer allocator.free(batches);
+        var free_list = try std.ArrayList(usize).initCapacity(allocator, SEND_BATCHES);
+        for (batches, 0..) |*batch, i| {
+            batch.* = .{};
+            free_list.appendAssumeCapacity(i);
+        }
+        return .{
+            .batches = batches,
+            .free_list = free_list,
+            .max_segments = if (gso) udp_batch.MAX_SEGMENTS else 1,
+            .allocator = allocator,
+        };
+    }
+
+    fn deinit(self: *SendQueue) void {
+        self.free_list.deinit(self.allocator);
+        self.allocator.free(self.batches);
+    }
+
+    /// Queue a datagram; false (dropped) when every batch is in flight
+    fn push(self: *SendQueue, ring: *c.struct_io_uring, fd: c_int, peer: *const c.struct_sockaddr_in, datagram: []const u8, stats: *IoStats) bool {
+        for (self.open[0..self.open_count], 0..) |idx, slot| {
+            if (!self.batches[idx].samePeer(peer)) continue;
+            if (self.batches[idx].append(peer, datagram, self.max_segments)) return true;
+            // Full, or ended by a short segment: send it and start another
+            self.submitOpen(ring, fd, slot, stats);
+            break;
+        }
+        if (self.open_count == MAX_OPEN_BATCHES) self.submitOpen(ring, fd, 0, stats);
+
+        const idx = self.free_list.pop() orelse return false;
+        if (!self.batches[idx].append(peer, datagram, self.max_segments)) {
+            self.free_list.appendAssumeCapacity(idx);
+            return false;
+        }
+        self.open[self.open_count] = idx;
+        self.open_count += 1;
+        return true;
+    }
+
+    fn flush(self: *SendQueue, ring: *c.struct_io_uring, fd: c_int, stats: *IoStats) void {
+        while (self.open_count > 0) self.submitOpen(ring, fd, self.open_count - 1, stats);
+    }
+
+    fn submitOpen(self: *SendQueue, ring: *c.struct_io_uring, fd: c_int, slot: usize, stats: *IoStats) void {
+        const idx = self.open[slot];
+        std.mem.copyForwards(usize, self.open[slot .. self.open_count - 1], self.open[slot + 1 .. self.open_count]);
+        self.open_count -= 1;
+
+        const batch = &self.batches[idx];
+        const sqe = getSqe(ring) orelse {
+            stats.dropped += batch.segments;
+            self.complete(idx);
+            return;
+        };
+        batch.prepSend(sqe, fd);
+        setSqeData(sqe, encodeUserData(fd, .sendmsg, idx));
+        stats.datagrams_out += batch.segments;
+        stats.sends += 1;
+    }
+
+    fn complete(self: *SendQueue, idx: usize) void {
+        self.batches[idx].reset();
+        self.free_list.appendAssumeCapacity(idx);
+    }
+};
+
+// Buffer ID the kernel selected for a recvmsg CQE
+fn cqeBufferId(cqe_flags: u32) u16 {
+    return @intCast(cqe_flags >> @intCast(c.IORING_CQE_BUFFER_SHIFT));
+}
+
+fn armRecvMsg(ring: *c.struct_io_uring, recv_ring: *udp_batch.RecvRing, fd: c_int) !void {
+    const sqe = getSqe(ring) orelse return error.SubmissionQueueFull;
+    recv_ring.prepRecv(sqe, fd);
+    setSqeData(sqe, encodeUserData(fd, .recvmsg, 0));
+}
+
+const CQE_BATCH_SIZE = 256;
+
+// Batched path: one multishot recvmsg (GRO bursts into provided 64 KiB buffers),
+// responses coalesced per peer into GSO sendmsgs, one submit per round of completions
+fn serveBatched(ring: *c.struct_io_uring, quic_server: *server_mod.QuicServer, allocator: std.mem.Allocator) !void {
+    const fd = quic_server.udp_fd;
+    const gro = udp_batch.enableGro(fd);
+    const gso = udp_batch.gsoSupported(fd);
+
+    var recv_ring = try udp_batch.RecvRing.init(ring, allocator);
+    defer recv_ring.deinit(ring, allocator);
+    var send_queue = try SendQueue.init(allocator, gso);
+    defer send_queue.deinit();
+
+    std.log.info("QUIC UDP I/O: multishot recvmsg, GRO {s}, GSO {s}", .{
+        if (gro) "on" else "unavailable",
+        if (gso) "on" else "unavailable",
+    });
+
+    try armRecvMsg(ring, &recv_ring, fd);
+
+    var stats = IoStats.init();
+    var received_any = false;
+    var response_buf: [2048]u8 = undefined;
+    var cqes: [CQE_BATCH_SIZE]?*c.struct_io_uring_cqe = undefined;
+    while (true) {
+        _ = c.io_uring_submit_and_wait(ring, 1);
+        const count = io_uring_mod.blitz_io_uring_peek_batch_cqe(ring, &cqes, CQE_BATCH_SIZE);
+        defer io_uring_mod.blitz_io_uring_cq_advance(ring, count);
+
+        for (cqes[0..count]) |cqe_opt| {
+            const cqe = cqe_opt orelse continue;
+            const decoded = decodeUserData(cqe.user_data);
+            switch (decoded.op) {
+                .recvmsg => {
+                    if (cqe.res >= 0 and (cqe.flags & c.IORING_CQE_F_BUFFER) != 0) {
+                        received_any = true;
+                        const bid = cqeBufferId(cqe.flags);
+                        defer recv_ring.recycle(bid);
+                        // Null when the kernel had to truncate the burst: dropped
+                        if (recv_ring.burst(bid, @intCast(cqe.res))) |first| {
+                            var burst = first;
+                            stats.recv_completions += 1;
+                            while (burst.next()) |datagram| {
+                                stats.datagrams_in += 1;
+                                const response_len = handleQuicPacket(quic_server, datagram, &burst.peer, &response_buf) catch |err| {
+                                    std.log.debug("Error handling QUIC packet: {any}", .{err});
+                                    continue;
+                                };
+                                if (response_len == 0) continue;
+                                if (!send_queue.push(ring, fd, &burst.peer, response_buf[0..response_len], &stats)) {
+                                    stats.dropped += 1;
+                                }
+                            }
+                        }
+                    } else if (cqe.res == -c.EINVAL and !received_any) {
+                        // Multishot recvmsg needs Linux 6.0
+                        return error.MultishotRecvmsgUnsupported;
+                    }
+                    // Ended (ENOBUFS, or the kernel dropped the multishot): re-arm
+                    if ((cqe.flags & c.IORING_CQE_F_MORE) == 0) try armRecvMsg(ring, &recv_ring, fd);
+                },
+                .sendmsg => {
+                    if (cqe.res < 0) std.log.debug("QUIC sendmsg failed: {d}", .{cqe.res});
+                    send_queue.complete(decoded.buffer_idx);
+                },
+                .stop => return,
+                else => {},
+            }
+        }
+
+        send_queue.flush(ring, fd, &stats);
+        stats.maybeReport("batched", quic_server.worker_id);
+    }
+}
+
+// One recv per 1500-byte buffer and one sendto per response
+fn serveSingle(ring: *c.struct_io_uring, quic_server: *server_mod.QuicServer, allocator: std.mem.Allocator) !void {
     // Initialize buffer pool
     var buffer_pool = try UdpBufferPool.init(allocator);
     defer buffer_pool.deinit();
 
-    std.log.info("QUIC server listening on UDP port {d}", .{port});
+    var stats = IoStats.init();
 
     // Submit initial recvfrom operations (multiple for better throughput)
     const initial_recvs = 32;
@@ -198,17 +534,17 @@ pub fn runQuicServer(ring: *c.struct_io_uring, port: u16) !void {
                 const buf = &buffer_pool.buffers[decoded.buffer_idx];
                 const packet_data = buf.data[0..@intCast(res)];
 
+                stats.datagrams_in += 1;
+                stats.recv_completions += 1;
+
                 // Process QUIC packet (client_addr is already filled by recvfrom)
-                handleQuicPacket(
-                    &quic_server,
-                    packet_data,
-                    &buf.client_addr,
-                    &buf.client_addr_len,
-                    ring,
-                    &buffer_pool,
-                ) catch |err| {
+                var response_buf: [2048]u8 = undefined;
+                if (handleQuicPacket(quic_server, packet_data, &buf.client_addr, &response_buf)) |response_len| {
+                    if (response_len > 0) sendSingle(quic_server.udp_fd, response_buf[0..response_len], &buf.client_addr, buf.client_addr_len, ring, &buffer_pool, &stats);
+                } else |err| {
                     std.log.debug("Error handling QUIC packet: {any}", .{err});
-                };
+                }
+                stats.maybeReport("single", quic_server.worker_id);
 
                 // Resubmit recvfrom for next packet
                 const next_buf = buffer_pool.acquire() orelse {
@@ -252,18 +588,20 @@ pub fn runQuicServer(ring: *c.struct_io_uring, port: u16) !void {
                     buffer_pool.release(&buffer_pool.buffers[decoded.buffer_idx]);
                 }
             },
+            .stop => return,
+            // Batched path only
+            .recvmsg, .sendmsg => {},
         }
     }
 }
 
+// Returns the length of the response written to response_buf, 0 if there is none
 fn handleQuicPacket(
     quic_server: *server_mod.QuicServer,
     data: []const u8,
-    client_addr: *c.struct_sockaddr_in,
-    client_addr_len: *c.socklen_t,
-    ring: *c.struct_io_uring,
-    buffer_pool: *UdpBufferPool,
-) !void {
+    client_addr: *const c.struct_sockaddr_in,
+    response_buf: []u8,
+) !usize {
     // Convert C sockaddr to Zig address
     const client_ip = std.net.Ip4Address.init(
         @as([4]u8, @bitCast(client_addr.sin_addr.s_addr)),
@@ -271,52 +609,59 @@ fn handleQuicPacket(
     );
 
     // Parse packet to get connection ID for lookup
-    const parsed = packet.Packet.parse(data, 8) catch |err| {
+    const parsed = packet.Packet.parse(data, cid_routing.CID_LEN) catch |err| {
         std.log.debug("Failed to parse QUIC packet: {any}", .{err});
-        return;
+        return 0;
     };
 
-    const remote_conn_id = switch (parsed) {
-        .long => |p| p.src_conn_id,
-        .short => |p| p.dest_conn_id,
-    };
-
-    // Get or create connection
-    const conn = try quic_server.getOrCreateConnection(remote_conn_id, client_ip);
+    // Get or create connection; short headers for a CID we never issued are dropped
+    const conn = try quic_server.connectionFor(parsed, client_ip) orelse return 0;
 
     // Process packet
     try conn.processPacket(data, quic_server.ssl_ctx);
 
     // Check if we need to send a response (handshake in progress)
     if (conn.state == .handshaking) {
-        // Generate response packet
-        var response_buf: [2048]u8 = undefined;
-        const response_len = try conn.generateResponsePacket(.initial, &response_buf);
-
-        // Get buffer for sending
-        const send_buf = buffer_pool.acquire() orelse {
-            std.log.warn("Buffer pool exhausted, dropping response", .{});
-            return;
-        };
+        return conn.generateResponsePacket(.initial, response_buf);
+    }
+    return 0;
+}
 
-        // Copy response to buffer
-        if (response_len <= send_buf.data.len) {
-            @memcpy(send_buf.data[0..response_len], response_buf[0..response_len]);
+fn sendSingle(
+    fd: c_int,
+    response: []const u8,
+    client_addr: *const c.struct_sockaddr_in,
+    client_addr_len: c.socklen_t,
+    ring: *c.struct_io_uring,
+    buffer_pool: *UdpBufferPool,
+    stats: *IoStats,
+) void {
+    // Get buffer for sending
+    const send_buf = buffer_pool.acquire() orelse {
+        std.log.warn("Buffer pool exhausted, dropping response", .{});
+        stats.dropped += 1;
+        return;
+    };
 
-            // Submit sendto
-            const sqe_opt = getSqe(ring);
-            if (sqe_opt) |sqe| {
-                const buffer_idx = @intFromPtr(send_buf) - @intFromPtr(buffer_pool.buffers.ptr);
-                const idx = buffer_idx / @sizeOf(UdpBuffer);
+    // Copy response to buffer
+    if (response.len <= send_buf.data.len) {
+        @memcpy(send_buf.data[0..response.len], response);
 
-                udp.prepSendTo(sqe, quic_server.udp_fd, send_buf.data[0..response_len], client_addr, client_addr_len.*);
-                setSqeData(sqe, encodeUserData(quic_server.udp_fd, .sendto, idx));
-                _ = c.io_uring_submit(ring);
-            } else {
-                buffer_pool.release(send_buf);
-            }
+        // Submit sendto
+        const sqe_opt = getSqe(ring);
+        if (sqe_opt) |sqe| {
+            const buffer_idx = @intFromPtr(send_buf) - @intFromPtr(buffer_pool.buffers.ptr);
+            const idx = buffer_idx / @sizeOf(UdpBuffer);
+
+            udp.prepSendTo(sqe, fd, send_buf.data[0..response.len], client_addr, client_addr_len);
+            setSqeData(sqe, encodeUserData(fd, .sendto, idx));
+            _ = c.io_uring_submit(ring);
+            stats.datagrams_out += 1;
+            stats.sends += 1;
         } else {
             buffer_pool.release(send_buf);
         }
+    } else {
+        buffer_pool.release(send_buf);
     }
 }
@@ -0,0 +1,196 @@
+//! Thread pool for TLS handshake steps
+//!
+//! A full handshake spends most of its time in the certificate signature
+//! (RSA/ECDSA), and run inline that stalls every other connection on the
+//! worker's ring. With the pool enabled a worker hands the step to one of a
+//! few handshake threads and carries on with its ring. The finished job is
+//! pushed onto the worker's Completions list and its eventfd is bumped; the
+//! worker reads the eventfd through the ring, so waiting for results costs no
+//! extra syscalls and never blocks the event loop.
+//!
+//! Jobs are intrusive: callers embed a Job in their own struct and recover it
+//! with @fieldParentPtr in the run function. While a job is queued or running
+//! the pool owns whatever it points at; the worker must not touch the session
+//! until the job comes back.
+
+const std = @import("std");
+const posix = std.posix;
+const linux = std.os.linux;
+
+pub const Job = struct {
+    /// Runs on a pool thread
+    run: *const fn (job: *Job) void,
+    /// Where the finished job is posted
+    completions: *Completions,
+    next: ?*Job = null,
+};
+
+/// Finished jobs for one worker, plus the eventfd that wakes it
+pub const Completions = struct {
+    mutex: std.Thread.Mutex = .{},
+    head: ?*Job = null,
+    // Blocking: the worker only ever reads it through io_uring
+    event_fd: posix.fd_t,
+
+    pub fn init() !Completions {
+        return .{ .event_fd = try posix.eventfd(0, linux.EFD.CLOEXEC) };
+    }
+
+    pub fn deinit(self: *Completions) void {
+        posix.close(self.event_fd);
+    }
+
+    fn post(self: *Completions, job: *Job) void {
+        self.mutex.lock();
+        const was_empty = self.head == null;
+        job.next = self.head;
+        self.head = job;
+        self.mutex.unlock();
+
+        // One wakeup covers everything posted until the worker takes the list
+        if (was_empty) {
+            const one: u64 = 1;
+            _ = posix.write(self.event_fd, std.mem.asBytes(&one)) catch {};
+        }
+    }
+
+    /// Every finished job, most recent first
+    pub fn take(self: *Completions) ?*Job {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        const list = self.head;
+        self.head = null;
+        return list;
+    }
+};
+
+pub const HandshakePool = struct {
+    allocator: std.mem.Allocator,
+    threads: []std.Thread,
+    mutex: std.Thread.Mutex = .{},
+    cond: std.Thread.Condition = .{},
+    // FIFO, so a storm of new connections can't starve earlier handshakes
+    head: ?*Job = null,
+    tail: ?*Job = null,
+    stopping: bool = false,
+
+    /// Heap-allocated: the threads keep a pointer to it
+    pub fn init(allocator: std.mem.Allocator, thread_count: usize) !*HandshakePool {
+        const self = try allocator.create(HandshakePool);
+        errdefer allocator.destroy(self);
+        self.* = .{ .allocator = allocator, .threads = try allocator.alloc(std.Thread, thread_count) };
+        errdefer allocator.free(self.threads);
+
+        var spawned: usize = 0;
+        errdefer {
+            self.stop();
+            for (self.threads[0..spawned]) |thread| thread.join();
+        }
+        while (spawned < thread_count) : (spawned += 1) {
+            self.threads[spawned] = try std.Thread.spawn(.{}, worker, .{self});
+        }
+        return self;
+    }
+
+    /// Jobs still queued are dropped; their completions never arrive
+    pub fn deinit(self: *HandshakePool) void {
+        self.stop();
+        for (self.threads) |thread| thread.join();
+        self.allocator.free(self.threads);
+        self.allocator.destroy(self);
+    }
+
+    pub fn submit(self: *HandshakePool, job: *Job) void {
+        job.next = null;
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.tail) |tail| tail.next = job else self.head = job;
+        self.tail = job;
+        self.cond.signal();
+    }
+
+    fn stop(self: *HandshakePool) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.stopping = true;
+        self.cond.broadcast();
+    }
+
+    fn next(self: *HandshakePool) ?*Job {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        while (self.head == null and !self.stopping) self.cond.wait(&self.mutex);
+        if (self.stopping) return null;
+        const job = self.head.?;
+        self.head = job.next;
+        if (self.head == null) self.tail = null;
+        return job;
+    }
+
+    fn worker(self: *HandshakePool) void {
+        while (self.next()) |job| {
+            job.run(job);
+            job.completions.post(job);
+        }
+    }
+};
+
+const TestJob = struct {
+    job: Job,
+    value: u32,
+    thread_id: std.Thread.Id = 0,
+
+    fn run(job: *Job) void {
+        const self: *TestJob = @fieldParentPtr("job", job);
+        self.value *= 2;
+        self.thread_id = std.Thread.getCurrentId();
+    }
+};
+
+fn waitForEvent(completions: *Completions) !void {
+    var counter: u64 = 0;
+    _ = try posix.read(completions.event_fd, std.mem.asBytes(&counter));
+}
+
+test "jobs run off the calling thread and come back through the eventfd" {
+    var completions = try Completions.init();
+    defer completions.deinit();
+    const pool = try HandshakePool.init(std.testing.allocator, 2);
+    defer pool.deinit();
+
+    var jobs: [8]TestJob = undefined;
+    for (&jobs, 0..) |*job, i| {
+        job.* = .{ .job = .{ .run = TestJob.run, .completions = &completions }, .value = @intCast(i) };
+        pool.submit(&job.job);
+    }
+
+    var finished: usize = 0;
+    while (finished < jobs.len) {
+        try waitForEvent(&completions);
+        var done = completions.take();
+        while (done) |job| {
+            done = job.next;
+            finished += 1;
+        }
+    }
+    for (jobs, 0..) |job, i| {
+        try std.testing.expectEqual(@as(u32, @intCast(i * 2)), job.value);
+        try std.testing.expect(job.thread_id != std.Thread.getCurrentId());
+    }
+}
+
+test "take empties the completion list" {
+    var completions = try Completions.init();
+    defer completions.deinit();
+
+    var a = TestJob{ .job = .{ .run = TestJob.run, .completions = &completions }, .value = 1 };
+    var b = TestJob{ .job = .{ .run = TestJob.run, .completions = &completions }, .value = 2 };
+    completions.post(&a.job);
+    completions.post(&b.job);
+    try waitForEvent(&completions);
+
+    const list = completions.take().?;
+    try std.testing.expectEqual(&b.job, list);
+    try std.testing.expectEqual(&a.job, list.next.?);
+    try std.testing.expect(completions.take() == null);
+}
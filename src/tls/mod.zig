@@ -3,8 +3,14 @@
 
 pub const TlsConnection = @import("tls.zig").TlsConnection;
 pub const TlsState = @import("tls.zig").TlsState;
+pub const TlsContext = @import("tls.zig").TlsContext;
+pub const TlsOptions = @import("tls.zig").TlsOptions;
+pub const RecordMode = @import("tls.zig").RecordMode;
+pub const SessionTickets = @import("tls.zig").SessionTickets;
+pub const Resumption = @import("tls.zig").Resumption;
+pub const HandshakePool = @import("handshake_pool.zig").HandshakePool;
 
 // Re-export TLS session management if needed
 pub const SessionCache = @import("session.zig").SessionCache;
-pub const SessionTicket = @import("session.zig").SessionTicket;
+pub const TicketKeys = @import("session.zig").TicketKeys;
 pub const TokenCache = @import("session.zig").TokenCache;
@@ -1,12 +1,27 @@
 // C wrapper for OpenSSL TLS 1.3 functions
 // This avoids Zig 0.12.0 compatibility issues with OpenSSL's complex types
 #include <openssl/ssl.h>
+#include <openssl/crypto.h>
 #include <openssl/err.h>
 #include <openssl/conf.h>
 #include <openssl/bio.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+#include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
 #include <string.h>
 #include <unistd.h>
-#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
 #include <picotls.h>
 #include <picotls/minicrypto.h>
 
@@ -32,96 +47,150 @@ void blitz_ptls_ctx_init(
     ctx->cipher_suites = (ptls_cipher_suite_t **)cipher_suites;
 }
 
-// Storage for captured TLS secrets (for QUIC key derivation)
-static unsigned char g_client_handshake_secret[48];
-static unsigned char g_server_handshake_secret[48];
-static unsigned char g_client_traffic_secret[48];
-static unsigned char g_server_traffic_secret[48];
-static int g_handshake_secrets_available = 0;
-static int g_traffic_secrets_available = 0;
+// Per-SSL key material (ex_data). The keylog callback stores each connection's
+// secrets in its own block, so concurrent handshakes on different workers never
+// see each other's keys. The record counters are only used by the TCP
+// listener's kTLS install (see below).
+#define BLITZ_TLS_MAX_SECRET 48
+
+typedef struct {
+    unsigned char client_hs_secret[BLITZ_TLS_MAX_SECRET];
+    unsigned char server_hs_secret[BLITZ_TLS_MAX_SECRET];
+    unsigned char client_secret[BLITZ_TLS_MAX_SECRET];
+    unsigned char server_secret[BLITZ_TLS_MAX_SECRET];
+    int client_hs_secret_len;
+    int server_hs_secret_len;
+    int client_secret_len;
+    int server_secret_len;
+    // Set once the Finished message in that direction has gone through:
+    // every later record is protected with the application traffic key
+    int tx_app;
+    int rx_app;
+    uint64_t tx_seq;
+    uint64_t rx_seq;
+    int ulp_installed;
+} blitz_tls_state;
+
+// Written once, under g_tls_state_once, before any SSL can carry a state block
+static int g_tls_state_index = -1;
+static CRYPTO_ONCE g_tls_state_once = CRYPTO_ONCE_STATIC_INIT;
+
+static void blitz_tls_state_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx, long argl, void *argp) {
+    (void)parent; (void)ad; (void)idx; (void)argl; (void)argp;
+    if (ptr != NULL) {
+        OPENSSL_cleanse(ptr, sizeof(blitz_tls_state));
+        free(ptr);
+    }
+}
+
+static void blitz_tls_state_index_init(void) {
+    g_tls_state_index = SSL_get_ex_new_index(0, NULL, NULL, NULL, blitz_tls_state_free);
+}
+
+static int blitz_tls_state_ready(void) {
+    return CRYPTO_THREAD_run_once(&g_tls_state_once, blitz_tls_state_index_init) && g_tls_state_index >= 0;
+}
+
+static blitz_tls_state *blitz_tls_state_get(const SSL *ssl) {
+    if (g_tls_state_index < 0) return NULL;
+    return (blitz_tls_state *)SSL_get_ex_data(ssl, g_tls_state_index);
+}
+
+// Give a new SSL its zeroed state block; freed with the SSL
+static int blitz_tls_state_attach(SSL *ssl) {
+    if (!blitz_tls_state_ready()) return 0;
+    blitz_tls_state *st = calloc(1, sizeof(*st));
+    if (st == NULL) return 0;
+    if (!SSL_set_ex_data(ssl, g_tls_state_index, st)) {
+        free(st);
+        return 0;
+    }
+    return 1;
+}
+
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
 
 // Parse hex string to bytes
 static int hex_to_bytes(const char* hex, unsigned char* out, int max_len) {
     int len = 0;
-    while (*hex && *(hex+1) && len < max_len) {
-        unsigned int byte;
-        if (sscanf(hex, "%2x", &byte) != 1) break;
-        out[len++] = (unsigned char)byte;
+    while (len < max_len) {
+        int hi = hex_nibble(hex[0]);
+        if (hi < 0) break;
+        int lo = hex_nibble(hex[1]);
+        if (lo < 0) break;
+        out[len++] = (unsigned char)((hi << 4) | lo);
         hex += 2;
     }
     return len;
 }
 
-// Keylog callback to capture TLS secrets
+// "LABEL <client_random> <secret>": store the secret if line starts with label
+static int keylog_take(const char *line, const char *label, unsigned char *out, int *out_len) {
+    size_t label_len = strlen(label);
+    if (strncmp(line, label, label_len) != 0 || line[label_len] != ' ') return 0;
+    const char *secret = strchr(line + label_len + 1, ' ');
+    if (secret != NULL) *out_len = hex_to_bytes(secret + 1, out, BLITZ_TLS_MAX_SECRET);
+    return 1;
+}
+
+// Keylog callback: runs on the thread driving this SSL, touches only its state
 static void blitz_keylog_callback(const SSL* ssl, const char* line) {
-    // Parse NSS key log format: LABEL <client_random> <secret>
-    // We're interested in:
-    // - CLIENT_HANDSHAKE_TRAFFIC_SECRET
-    // - SERVER_HANDSHAKE_TRAFFIC_SECRET  
-    // - CLIENT_TRAFFIC_SECRET_0
-    // - SERVER_TRAFFIC_SECRET_0
-    
-    if (strncmp(line, "CLIENT_HANDSHAKE_TRAFFIC_SECRET ", 32) == 0) {
-        const char* secret = strchr(line + 32, ' ');
-        if (secret) {
-            hex_to_bytes(secret + 1, g_client_handshake_secret, 48);
-            g_handshake_secrets_available = 1;
-            fprintf(stderr, "[TLS-KEYLOG] Got CLIENT_HANDSHAKE_TRAFFIC_SECRET\n");
-        }
-    }
-    else if (strncmp(line, "SERVER_HANDSHAKE_TRAFFIC_SECRET ", 32) == 0) {
-        const char* secret = strchr(line + 32, ' ');
-        if (secret) {
-            hex_to_bytes(secret + 1, g_server_handshake_secret, 48);
-            fprintf(stderr, "[TLS-KEYLOG] Got SERVER_HANDSHAKE_TRAFFIC_SECRET\n");
-        }
-    }
-    else if (strncmp(line, "CLIENT_TRAFFIC_SECRET_0 ", 24) == 0) {
-        const char* secret = strchr(line + 24, ' ');
-        if (secret) {
-            hex_to_bytes(secret + 1, g_client_traffic_secret, 48);
-            g_traffic_secrets_available = 1;
-            fprintf(stderr, "[TLS-KEYLOG] Got CLIENT_TRAFFIC_SECRET_0 (1-RTT)\n");
-        }
-    }
-    else if (strncmp(line, "SERVER_TRAFFIC_SECRET_0 ", 24) == 0) {
-        const char* secret = strchr(line + 24, ' ');
-        if (secret) {
-            hex_to_bytes(secret + 1, g_server_traffic_secret, 48);
-            fprintf(stderr, "[TLS-KEYLOG] Got SERVER_TRAFFIC_SECRET_0 (1-RTT)\n");
-        }
-    }
+    blitz_tls_state *st = blitz_tls_state_get(ssl);
+    if (st == NULL) return;
+    (void)(keylog_take(line, "CLIENT_HANDSHAKE_TRAFFIC_SECRET", st->client_hs_secret, &st->client_hs_secret_len) ||
+        keylog_take(line, "SERVER_HANDSHAKE_TRAFFIC_SECRET", st->server_hs_secret, &st->server_hs_secret_len) ||
+        keylog_take(line, "CLIENT_TRAFFIC_SECRET_0", st->client_secret, &st->client_secret_len) ||
+        keylog_take(line, "SERVER_TRAFFIC_SECRET_0", st->server_secret, &st->server_secret_len));
 }
 
-// Get handshake secrets for QUIC key derivation
-int blitz_get_handshake_secrets(unsigned char* client_secret, unsigned char* server_secret) {
-    if (!g_handshake_secrets_available) return 0;
-    memcpy(client_secret, g_client_handshake_secret, 48);
-    memcpy(server_secret, g_server_handshake_secret, 48);
-    return 1;
+// Copy out both secrets of a pair; returns their length (32 or 48), 0 until both are captured
+static int copy_secret_pair(const unsigned char *client, int client_len, const unsigned char *server, int server_len,
+                            unsigned char *client_out, unsigned char *server_out) {
+    if (client_len == 0 || client_len != server_len) return 0;
+    memcpy(client_out, client, (size_t)client_len);
+    memcpy(server_out, server, (size_t)server_len);
+    return client_len;
 }
 
-// Get traffic secrets for 1-RTT
-int blitz_get_traffic_secrets(unsigned char* client_secret, unsigned char* server_secret) {
-    if (!g_traffic_secrets_available) return 0;
-    memcpy(client_secret, g_client_traffic_secret, 48);
-    memcpy(server_secret, g_server_traffic_secret, 48);
-    return 1;
+// Get handshake secrets of ssl for QUIC key derivation (buffers of 48 bytes)
+int blitz_get_handshake_secrets(const SSL* ssl, unsigned char* client_secret, unsigned char* server_secret) {
+    const blitz_tls_state *st = blitz_tls_state_get(ssl);
+    if (st == NULL) return 0;
+    return copy_secret_pair(st->client_hs_secret, st->client_hs_secret_len,
+                            st->server_hs_secret, st->server_hs_secret_len, client_secret, server_secret);
+}
+
+// Get traffic secrets of ssl for 1-RTT (buffers of 48 bytes)
+int blitz_get_traffic_secrets(const SSL* ssl, unsigned char* client_secret, unsigned char* server_secret) {
+    const blitz_tls_state *st = blitz_tls_state_get(ssl);
+    if (st == NULL) return 0;
+    return copy_secret_pair(st->client_secret, st->client_secret_len,
+                            st->server_secret, st->server_secret_len, client_secret, server_secret);
 }
 
-// Check if handshake secrets are available
-int blitz_handshake_secrets_available(void) {
-    return g_handshake_secrets_available;
+// Check if handshake secrets are available for ssl
+int blitz_handshake_secrets_available(const SSL* ssl) {
+    const blitz_tls_state *st = blitz_tls_state_get(ssl);
+    return st != NULL && st->client_hs_secret_len > 0 && st->server_hs_secret_len > 0;
 }
 
 // Initialize OpenSSL
 int blitz_openssl_init(void) {
-    OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, NULL);
-    return 1;
+    if (!OPENSSL_init_ssl(OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, NULL)) return 0;
+    return blitz_tls_state_ready();
 }
 
 // Create SSL context for TLS 1.3 server
 SSL_CTX* blitz_ssl_ctx_new(void) {
+    if (!blitz_tls_state_ready()) {
+        return NULL;
+    }
+
     const SSL_METHOD* method = TLS_server_method();
     if (method == NULL) {
         return NULL;
@@ -136,7 +205,7 @@ SSL_CTX* blitz_ssl_ctx_new(void) {
     SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
     SSL_CTX_set_max_proto_version(ctx, TLS1_3_VERSION);
     
-    // Set keylog callback to capture secrets for QUIC
+    // Capture secrets for QUIC into each SSL's own state
     SSL_CTX_set_keylog_callback(ctx, blitz_keylog_callback);
     
     return ctx;
@@ -191,9 +260,14 @@ int blitz_ssl_ctx_use_privatekey_file(SSL_CTX* ctx, const char* key_file) {
     return SSL_CTX_use_PrivateKey_file(ctx, key_file, SSL_FILETYPE_PEM);
 }
 
-// Create SSL object for a connection
+// Create SSL object for a connection, with its own secret storage
 SSL* blitz_ssl_new(SSL_CTX* ctx) {
-    return SSL_new(ctx);
+    SSL* ssl = SSL_new(ctx);
+    if (ssl != NULL && !blitz_tls_state_attach(ssl)) {
+        SSL_free(ssl);
+        return NULL;
+    }
+    return ssl;
 }
 
 // Set file descriptor for SSL (socket BIO - deprecated for io_uring)
@@ -281,8 +355,390 @@ void blitz_ssl_ctx_free(SSL_CTX* ctx) {
     SSL_CTX_free(ctx);
 }
 
-// Get error string
+// Get error string (OpenSSL's error queue is per thread; so is the buffer)
 const char* blitz_ssl_error_string(void) {
-    return ERR_error_string(ERR_get_error(), NULL);
+    static _Thread_local char buf[256];
+    ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+    return buf;
+}
+
+
+
+// ---------------------------------------------------------------------------
+// TCP TLS with kernel record offload (kTLS)
+//
+// The handshake runs in userspace over memory BIOs. Afterwards the application
+// traffic keys can be installed into the socket with TCP_ULP "tls", so the
+// kernel encrypts writes and decrypts reads and plain read/write/splice move
+// plaintext. OpenSSL never exposes the keys or record sequence numbers of a
+// memory-BIO connection, so the per-SSL state block above carries them: the
+// keylog callback stores the application traffic secrets, and the message
+// callback counts the records sent and received under them.
+// ---------------------------------------------------------------------------
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+// The record layer reports the inner content type of every protected TLS 1.3
+// record; handshake messages are reported after their record has been handled
+static void blitz_tcp_record_callback(int write_p, int version, int content_type, const void *buf,
+                                      size_t len, SSL *ssl, void *arg) {
+    (void)version; (void)arg;
+    blitz_tls_state *st = blitz_tls_state_get(ssl);
+    if (st == NULL) return;
+    if (content_type == SSL3_RT_INNER_CONTENT_TYPE) {
+        if (write_p && st->tx_app) st->tx_seq++;
+        if (!write_p && st->rx_app) st->rx_seq++;
+    } else if (content_type == SSL3_RT_HANDSHAKE && len > 0 &&
+               ((const unsigned char *)buf)[0] == SSL3_MT_FINISHED) {
+        if (write_p) st->tx_app = 1; else st->rx_app = 1;
+    }
 }
 
+// The TCP listener serves HTTP/1.1 only, so never let ALPN settle on h2
+static int blitz_alpn_http11_callback(SSL *ssl, const unsigned char **out, unsigned char *outlen,
+                                      const unsigned char *in, unsigned int inlen, void *arg) {
+    (void)ssl; (void)arg;
+    for (unsigned int i = 0; i < inlen;) {
+        unsigned char len = in[i++];
+        if (i + len > inlen) break;
+        if (len == 8 && memcmp(&in[i], "http/1.1", 8) == 0) {
+            *out = &in[i];
+            *outlen = len;
+            return SSL_TLSEXT_ERR_OK;
+        }
+        i += len;
+    }
+    return SSL_TLSEXT_ERR_NOACK;
+}
+
+// TLS 1.3 server context for the TCP listener
+SSL_CTX *blitz_tls_server_ctx_new(const char *cert_file, const char *key_file) {
+    if (!blitz_tls_state_ready()) return NULL;
+
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (ctx == NULL) return NULL;
+    SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+    SSL_CTX_set_max_proto_version(ctx, TLS1_3_VERSION);
+    SSL_CTX_set_keylog_callback(ctx, blitz_keylog_callback);
+    SSL_CTX_set_msg_callback(ctx, blitz_tcp_record_callback);
+    SSL_CTX_set_alpn_select_cb(ctx, blitz_alpn_http11_callback, NULL);
+
+    if (SSL_CTX_use_certificate_chain_file(ctx, cert_file) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, key_file, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx) != 1) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+// Server-side SSL over a pair of memory BIOs, with its kTLS state attached
+SSL *blitz_tls_new(SSL_CTX *ctx, BIO **rbio_out, BIO **wbio_out) {
+    SSL *ssl = blitz_ssl_new(ctx);
+    if (ssl == NULL) return NULL;
+    BIO *rbio = BIO_new(BIO_s_mem());
+    BIO *wbio = BIO_new(BIO_s_mem());
+    if (rbio == NULL || wbio == NULL) {
+        BIO_free(rbio);
+        BIO_free(wbio);
+        SSL_free(ssl);
+        return NULL;
+    }
+    // An empty memory BIO reports "retry" instead of EOF
+    BIO_set_mem_eof_return(rbio, -1);
+    SSL_set_bio(ssl, rbio, wbio);
+    SSL_set_accept_state(ssl);
+    *rbio_out = rbio;
+    *wbio_out = wbio;
+    return ssl;
+}
+
+// Nothing buffered on the read side: neither unread ciphertext in the BIO nor a
+// partly processed record inside OpenSSL. Only then can the kernel take over RX.
+int blitz_tls_read_drained(SSL *ssl) {
+    return BIO_ctrl_pending(SSL_get_rbio(ssl)) == 0 && !SSL_has_pending(ssl);
+}
+
+// HKDF-Expand-Label(secret, label, "", out_len) from RFC 8446 section 7.1
+static int blitz_hkdf_expand_label(const EVP_MD *md, const unsigned char *secret, int secret_len,
+                                   const char *label, unsigned char *out, size_t out_len) {
+    unsigned char info[2 + 1 + 255 + 1];
+    size_t label_len = strlen(label);
+    size_t info_len = 0;
+    info[info_len++] = (unsigned char)(out_len >> 8);
+    info[info_len++] = (unsigned char)out_len;
+    info[info_len++] = (unsigned char)(6 + label_len);
+    memcpy(info + info_len, "tls13 ", 6);
+    info_len += 6;
+    memcpy(info + info_len, label, label_len);
+    info_len += label_len;
+    info[info_len++] = 0; // empty context
+
+    int ok = 0;
+    EVP_PKEY_CTX *pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+    if (pctx != NULL &&
+        EVP_PKEY_derive_init(pctx) > 0 &&
+        EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0 &&
+        EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0 &&
+        EVP_PKEY_CTX_set1_hkdf_key(pctx, secret, secret_len) > 0 &&
+        EVP_PKEY_CTX_add1_hkdf_info(pctx, info, (int)info_len) > 0 &&
+        EVP_PKEY_derive(pctx, out, &out_len) > 0) {
+        ok = 1;
+    }
+    EVP_PKEY_CTX_free(pctx);
+    return ok;
+}
+
+static void blitz_put_seq(unsigned char out[8], uint64_t seq) {
+    for (int i = 7; i >= 0; i--) {
+        out[i] = (unsigned char)seq;
+        seq >>= 8;
+    }
+}
+
+// Install the application traffic keys of one direction into the socket.
+// tx = 1 for TLS_TX (server secret), 0 for TLS_RX (client secret).
+// Returns 1 when installed, 0 when kTLS is unavailable for this connection
+// (no tls ULP, unsupported cipher, secrets not captured) and -1 on failure
+// after the socket was already changed.
+int blitz_tls_install_ktls(SSL *ssl, int fd, int tx) {
+    blitz_tls_state *st = blitz_tls_state_get(ssl);
+    if (st == NULL || (tx ? !st->tx_app : !st->rx_app)) return 0;
+    const unsigned char *secret = tx ? st->server_secret : st->client_secret;
+    int secret_len = tx ? st->server_secret_len : st->client_secret_len;
+    uint64_t seq = tx ? st->tx_seq : st->rx_seq;
+    if (secret_len == 0) return 0;
+
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+    if (cipher == NULL) return 0;
+    const EVP_MD *md = SSL_CIPHER_get_handshake_digest(cipher);
+
+    union {
+        struct tls12_crypto_info_aes_gcm_128 aes128;
+        struct tls12_crypto_info_aes_gcm_256 aes256;
+        struct tls12_crypto_info_chacha20_poly1305 chacha;
+    } info;
+    memset(&info, 0, sizeof(info));
+    unsigned char key[32];
+    unsigned char iv[12];
+    size_t key_len;
+    size_t info_len;
+
+    switch (SSL_CIPHER_get_id(cipher) & 0xFFFF) {
+    case 0x1301: // TLS_AES_128_GCM_SHA256
+        key_len = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+        info.aes128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+        info_len = sizeof(info.aes128);
+        break;
+    case 0x1302: // TLS_AES_256_GCM_SHA384
+        key_len = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+        info.aes256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+        info_len = sizeof(info.aes256);
+        break;
+    case 0x1303: // TLS_CHACHA20_POLY1305_SHA256
+        key_len = TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE;
+        info.chacha.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        info_len = sizeof(info.chacha);
+        break;
+    default:
+        return 0;
+    }
+
+    if (!blitz_hkdf_expand_label(md, secret, secret_len, "key", key, key_len) ||
+        !blitz_hkdf_expand_label(md, secret, secret_len, "iv", iv, sizeof(iv))) {
+        return 0;
+    }
+
+    switch (info.aes128.info.cipher_type) {
+    case TLS_CIPHER_AES_GCM_128:
+        info.aes128.info.version = TLS_1_3_VERSION;
+        memcpy(info.aes128.key, key, key_len);
+        memcpy(info.aes128.salt, iv, 4);
+        memcpy(info.aes128.iv, iv + 4, 8);
+        blitz_put_seq(info.aes128.rec_seq, seq);
+        break;
+    case TLS_CIPHER_AES_GCM_256:
+        info.aes256.info.version = TLS_1_3_VERSION;
+        memcpy(info.aes256.key, key, key_len);
+        memcpy(info.aes256.salt, iv, 4);
+        memcpy(info.aes256.iv, iv + 4, 8);
+        blitz_put_seq(info.aes256.rec_seq, seq);
+        break;
+    default:
+        info.chacha.info.version = TLS_1_3_VERSION;
+        memcpy(info.chacha.key, key, key_len);
+        memcpy(info.chacha.iv, iv, 12); // ChaCha20 has no salt: the whole IV goes in
+        blitz_put_seq(info.chacha.rec_seq, seq);
+        break;
+    }
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(iv, sizeof(iv));
+
+    int result = 1;
+    if (!st->ulp_installed) {
+        // ENOENT: the tls module isn't available; the socket is unchanged
+        if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+            result = 0;
+            goto done;
+        }
+        st->ulp_installed = 1;
+    }
+    if (setsockopt(fd, SOL_TLS, tx ? TLS_TX : TLS_RX, &info, (socklen_t)info_len) < 0) {
+        // With the ULP attached but no keys the socket still passes plaintext:
+        // the other direction can stay in userspace
+        result = errno == ENOPROTOOPT || errno == EINVAL ? 0 : -1;
+    }
+done:
+    OPENSSL_cleanse(&info, sizeof(info));
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Session resumption for the TCP listener
+//
+// Sessions and ticket keys live in Zig (tls/session.zig), shared by every
+// worker and handshake thread; these callbacks only translate between OpenSSL
+// and that store. The hooks struct is owned by the caller and must outlive ctx.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    void *arg;
+    // Stateful: serialized sessions keyed by session ID
+    int (*store)(void *arg, const unsigned char *id, unsigned int id_len,
+                 const unsigned char *der, unsigned int der_len, long timeout);
+    int (*lookup)(void *arg, const unsigned char *id, unsigned int id_len,
+                  unsigned char *der, unsigned int der_cap);
+    void (*remove)(void *arg, const unsigned char *id, unsigned int id_len);
+    // Stateless: enc = 1 fills in the current key; enc = 0 looks up key_name.
+    // Returns 0 for an unknown key, 1 for the current one, 2 for an older one.
+    int (*ticket_key)(void *arg, unsigned char key_name[16], unsigned char aes_key[32],
+                      unsigned char hmac_key[32], int enc);
+} blitz_session_hooks;
+
+enum { BLITZ_RESUME_STATELESS = 0, BLITZ_RESUME_STATEFUL = 1, BLITZ_RESUME_OFF = 2 };
+
+#define BLITZ_MAX_SESSION_DER 512
+
+static const blitz_session_hooks *blitz_hooks_of(SSL *ssl) {
+    return (const blitz_session_hooks *)SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+}
+
+static int blitz_session_new_cb(SSL *ssl, SSL_SESSION *session) {
+    const blitz_session_hooks *hooks = blitz_hooks_of(ssl);
+    unsigned char der[BLITZ_MAX_SESSION_DER];
+    int der_len = i2d_SSL_SESSION(session, NULL);
+    if (hooks != NULL && der_len > 0 && der_len <= (int)sizeof(der)) {
+        unsigned char *p = der;
+        unsigned int id_len;
+        const unsigned char *id = SSL_SESSION_get_id(session, &id_len);
+        i2d_SSL_SESSION(session, &p);
+        hooks->store(hooks->arg, id, id_len, der, (unsigned int)der_len, SSL_SESSION_get_timeout(session));
+        OPENSSL_cleanse(der, (size_t)der_len);
+    }
+    return 0; // no reference kept: the store has its own copy
+}
+
+static SSL_SESSION *blitz_session_get_cb(SSL *ssl, const unsigned char *id, int id_len, int *copy) {
+    const blitz_session_hooks *hooks = blitz_hooks_of(ssl);
+    unsigned char der[BLITZ_MAX_SESSION_DER];
+    *copy = 0;
+    if (hooks == NULL) return NULL;
+    int der_len = hooks->lookup(hooks->arg, id, (unsigned int)id_len, der, sizeof(der));
+    if (der_len <= 0) return NULL;
+    const unsigned char *p = der;
+    SSL_SESSION *session = d2i_SSL_SESSION(NULL, &p, der_len);
+    OPENSSL_cleanse(der, (size_t)der_len);
+    return session;
+}
+
+static void blitz_session_remove_cb(SSL_CTX *ctx, SSL_SESSION *session) {
+    const blitz_session_hooks *hooks = (const blitz_session_hooks *)SSL_CTX_get_app_data(ctx);
+    if (hooks == NULL) return;
+    unsigned int id_len;
+    const unsigned char *id = SSL_SESSION_get_id(session, &id_len);
+    hooks->remove(hooks->arg, id, id_len);
+}
+
+// AES-256-CBC + HMAC-SHA256 ticket protection, as OpenSSL's own tickets use
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int blitz_ticket_key_cb(SSL *ssl, unsigned char key_name[16], unsigned char *iv,
+                               EVP_CIPHER_CTX *cctx, EVP_MAC_CTX *hctx, int enc) {
+#else
+static int blitz_ticket_key_cb(SSL *ssl, unsigned char key_name[16], unsigned char *iv,
+                               EVP_CIPHER_CTX *cctx, HMAC_CTX *hctx, int enc) {
+#endif
+    const blitz_session_hooks *hooks = blitz_hooks_of(ssl);
+    unsigned char aes_key[32];
+    unsigned char hmac_key[32];
+    int ret = -1;
+    if (hooks == NULL) return -1;
+
+    if (enc) {
+        if (RAND_bytes(iv, 16) != 1 || hooks->ticket_key(hooks->arg, key_name, aes_key, hmac_key, 1) != 1) goto done;
+        if (EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, aes_key, iv) != 1) goto done;
+        ret = 1;
+    } else {
+        ret = hooks->ticket_key(hooks->arg, key_name, aes_key, hmac_key, 0);
+        if (ret == 0) goto done; // unknown key: full handshake
+        if (EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, aes_key, iv) != 1) {
+            ret = -1;
+            goto done;
+        }
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    {
+        OSSL_PARAM params[3];
+        params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, hmac_key, sizeof(hmac_key));
+        params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+        params[2] = OSSL_PARAM_construct_end();
+        if (EVP_MAC_CTX_set_params(hctx, params) != 1) ret = -1;
+    }
+#else
+    if (HMAC_Init_ex(hctx, hmac_key, sizeof(hmac_key), EVP_sha256(), NULL) != 1) ret = -1;
+#endif
+
+done:
+    OPENSSL_cleanse(aes_key, sizeof(aes_key));
+    OPENSSL_cleanse(hmac_key, sizeof(hmac_key));
+    return ret;
+}
+
+// Wire resumption into ctx: mode is one of BLITZ_RESUME_*, timeout the session
+// and ticket lifetime in seconds
+int blitz_tls_ctx_set_session_hooks(SSL_CTX *ctx, const blitz_session_hooks *hooks, int mode, long timeout) {
+    if (mode == BLITZ_RESUME_OFF) {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        SSL_CTX_set_num_tickets(ctx, 0);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+        return 1;
+    }
+    if (!SSL_CTX_set_app_data(ctx, (void *)hooks)) return 0;
+    SSL_CTX_set_timeout(ctx, timeout);
+    // OpenSSL's internal cache would be per context and locked; the shared store replaces it
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    if (SSL_CTX_set_session_id_context(ctx, (const unsigned char *)"blitz", 5) != 1) return 0;
+
+    if (mode == BLITZ_RESUME_STATEFUL) {
+        // TLS 1.3 tickets then carry only the session ID
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        SSL_CTX_sess_set_new_cb(ctx, blitz_session_new_cb);
+        SSL_CTX_sess_set_get_cb(ctx, blitz_session_get_cb);
+        SSL_CTX_sess_set_remove_cb(ctx, blitz_session_remove_cb);
+        return 1;
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, blitz_ticket_key_cb) == 1;
+#else
+    return SSL_CTX_set_tlsext_ticket_key_cb(ctx, blitz_ticket_key_cb) == 1;
+#endif
+}
+
+int blitz_tls_session_reused(SSL *ssl) {
+    return SSL_session_reused(ssl);
+}
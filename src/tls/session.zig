@@ -1,182 +1,322 @@
 //! TLS session management for 0-RTT and session resumption
 //! Handles TLS session tickets and early data (0-RTT) support
+//!
+//! Resumption skips the certificate signature, so the resumption rate decides
+//! how much handshake CPU the gateway spends. Two server-side mechanisms:
+//!
+//! - SessionCache: stateful resumption. Serialized sessions keyed by session
+//!   ID, shared by every worker. Capacity is fixed at startup (no allocation
+//!   after init), the store is split into independently locked shards, and
+//!   eviction is CLOCK: a hit sets the entry's reference bit, and the hand
+//!   skips (and clears) referenced entries before evicting one.
+//! - TicketKeys: stateless tickets. The session travels encrypted inside the
+//!   ticket; the server only keeps the keys. New tickets use the first key,
+//!   older keys stay valid for decryption until they rotate out. Keys are
+//!   either random and rotated on an interval, or loaded from a file that is
+//!   re-read whenever it changes (share it across hosts, rotate it with cron).
 
 const std = @import("std");
 
-/// TLS session ticket for session resumption
-pub const SessionTicket = struct {
-    /// Session ticket data (opaque blob from TLS library)
-    ticket_data: []const u8,
+/// Largest serialized session kept; bigger ones (client certificate chains) are not cached
+pub const MAX_SESSION_SIZE: usize = 512;
+pub const MAX_SESSION_ID: usize = 32;
+const SHARD_COUNT = 16;
 
-    /// Associated server name (SNI)
-    server_name: ?[]const u8,
+/// Resumption attempts: a client offered a session ID or ticket and it could (hit) or
+/// could not (miss: evicted, expired, unknown key) be used
+pub const ResumptionStats = struct {
+    hits: std.atomic.Value(u64) = .init(0),
+    misses: std.atomic.Value(u64) = .init(0),
 
-    /// Ticket lifetime hint (seconds)
-    lifetime_hint: u32,
-
-    /// Creation timestamp
-    created_at: i64,
-
-    /// Maximum early data size (0-RTT)
-    max_early_data_size: u32,
-
-    /// PSK identity for this ticket
-    psk_identity: []const u8,
-
-    pub fn init(allocator: std.mem.Allocator, ticket_data: []const u8, psk_identity: []const u8) !SessionTicket {
-        const ticket_data_copy = try allocator.dupe(u8, ticket_data);
-        errdefer allocator.free(ticket_data_copy);
+    pub fn record(self: *ResumptionStats, hit: bool) void {
+        const counter = if (hit) &self.hits else &self.misses;
+        _ = counter.fetchAdd(1, .monotonic);
+    }
+};
 
-        const psk_identity_copy = try allocator.dupe(u8, psk_identity);
-        errdefer allocator.free(psk_identity_copy);
+// Zero-padded so it can be hashed and compared as a whole
+const SessionId = struct {
+    len: u8 = 0,
+    bytes: [MAX_SESSION_ID]u8 = [_]u8{0} ** MAX_SESSION_ID,
 
-        return SessionTicket{
-            .ticket_data = ticket_data_copy,
-            .server_name = null,
-            .lifetime_hint = 86400, // 24 hours default
-            .created_at = std.time.timestamp(),
-            .max_early_data_size = 16384, // 16KB default
-            .psk_identity = psk_identity_copy,
-        };
+    fn init(id: []const u8) SessionId {
+        var session_id = SessionId{ .len = @intCast(id.len) };
+        @memcpy(session_id.bytes[0..id.len], id);
+        return session_id;
     }
+};
 
-    pub fn deinit(self: *SessionTicket, allocator: std.mem.Allocator) void {
-        allocator.free(self.ticket_data);
-        allocator.free(self.psk_identity);
-        if (self.server_name) |sn| {
-            allocator.free(sn);
+const Slot = struct {
+    id: SessionId = .{},
+    expires_at: i64 = 0,
+    len: u16 = 0,
+    used: bool = false,
+    // CLOCK reference bit: set on every hit, cleared as the hand passes
+    referenced: bool = false,
+    data: [MAX_SESSION_SIZE]u8 = undefined,
+};
+
+const Shard = struct {
+    mutex: std.Thread.Mutex align(std.atomic.cache_line) = .{},
+    slots: []Slot,
+    // Session ID -> slot; sized for every slot up front, so puts never allocate
+    index: std.AutoHashMapUnmanaged(SessionId, u32) = .{},
+    hand: u32 = 0,
+
+    fn lookup(self: *Shard, id: SessionId, now: i64, out: []u8) ?usize {
+        const slot_index = self.index.get(id) orelse return null;
+        const slot = &self.slots[slot_index];
+        if (slot.expires_at <= now) {
+            self.evict(slot);
+            return null;
         }
+        if (out.len < slot.len) return null;
+        slot.referenced = true;
+        @memcpy(out[0..slot.len], slot.data[0..slot.len]);
+        return slot.len;
     }
 
-    /// Check if ticket is expired
-    pub fn isExpired(self: *const SessionTicket) bool {
-        const now = std.time.timestamp();
-        const age = now - self.created_at;
-        return age > self.lifetime_hint;
+    fn store(self: *Shard, id: SessionId, session: []const u8, expires_at: i64, now: i64) void {
+        const slot_index = self.index.get(id) orelse self.claim(now);
+        const slot = &self.slots[slot_index];
+        slot.* = .{ .id = id, .expires_at = expires_at, .len = @intCast(session.len), .used = true };
+        @memcpy(slot.data[0..session.len], session);
+        self.index.putAssumeCapacity(id, slot_index);
     }
 
-    /// Set server name (SNI)
-    pub fn setServerName(self: *SessionTicket, allocator: std.mem.Allocator, server_name: []const u8) !void {
-        if (self.server_name) |sn| {
-            allocator.free(sn);
+    // CLOCK: take the first free or expired slot, or the first one not hit since the hand last passed
+    fn claim(self: *Shard, now: i64) u32 {
+        while (true) {
+            const slot_index = self.hand;
+            self.hand = if (self.hand + 1 == self.slots.len) 0 else self.hand + 1;
+            const slot = &self.slots[slot_index];
+            if (slot.used and slot.referenced and slot.expires_at > now) {
+                slot.referenced = false;
+                continue;
+            }
+            if (slot.used) self.evict(slot);
+            return slot_index;
         }
-        self.server_name = try allocator.dupe(u8, server_name);
+    }
+
+    fn evict(self: *Shard, slot: *Slot) void {
+        _ = self.index.remove(slot.id);
+        slot.used = false;
+        slot.referenced = false;
     }
 };
 
-/// TLS session cache for storing and retrieving session tickets
+/// Stateful server session store shared by every worker
 pub const SessionCache = struct {
     allocator: std.mem.Allocator,
+    shards: [SHARD_COUNT]Shard,
+    slots: []Slot,
+    stats: ResumptionStats = .{},
+
+    /// capacity is rounded up to a multiple of the shard count
+    pub fn init(allocator: std.mem.Allocator, capacity: usize) !SessionCache {
+        const per_shard = @max(std.math.divCeil(usize, capacity, SHARD_COUNT) catch unreachable, 1);
+        const slots = try allocator.alloc(Slot, per_shard * SHARD_COUNT);
+        errdefer allocator.free(slots);
+        @memset(slots, .{});
+
+        var cache = SessionCache{ .allocator = allocator, .shards = undefined, .slots = slots };
+        var ready: usize = 0;
+        errdefer for (cache.shards[0..ready]) |*shard| shard.index.deinit(allocator);
+        while (ready < SHARD_COUNT) : (ready += 1) {
+            cache.shards[ready] = .{ .slots = slots[ready * per_shard ..][0..per_shard] };
+            try cache.shards[ready].index.ensureTotalCapacity(allocator, @intCast(per_shard));
+        }
+        return cache;
+    }
 
-    /// Map of PSK identity -> Session ticket
-    sessions: std.StringHashMap(*SessionTicket),
+    pub fn deinit(self: *SessionCache) void {
+        for (&self.shards) |*shard| shard.index.deinit(self.allocator);
+        self.allocator.free(self.slots);
+    }
 
-    /// Maximum cache size
-    max_size: usize = 10000,
+    fn shardFor(self: *SessionCache, id: SessionId) *Shard {
+        const hash = std.hash.Wyhash.hash(0, id.bytes[0..id.len]);
+        return &self.shards[hash % SHARD_COUNT];
+    }
 
-    /// Current cache size
-    size: usize = 0,
+    /// Keep a serialized session until expires_at; false if it's too large to cache
+    pub fn store(self: *SessionCache, id: []const u8, session: []const u8, expires_at: i64) bool {
+        if (id.len == 0 or id.len > MAX_SESSION_ID or session.len > MAX_SESSION_SIZE) return false;
+        const session_id = SessionId.init(id);
+        const shard = self.shardFor(session_id);
+        shard.mutex.lock();
+        defer shard.mutex.unlock();
+        shard.store(session_id, session, expires_at, std.time.timestamp());
+        return true;
+    }
 
-    pub fn init(allocator: std.mem.Allocator) SessionCache {
-        return SessionCache{
-            .allocator = allocator,
-            .sessions = std.StringHashMap(*SessionTicket).init(allocator),
+    /// Copy the session for id into out; its length, or null on a miss
+    pub fn lookup(self: *SessionCache, id: []const u8, out: []u8) ?usize {
+        const len = blk: {
+            if (id.len == 0 or id.len > MAX_SESSION_ID) break :blk null;
+            const session_id = SessionId.init(id);
+            const shard = self.shardFor(session_id);
+            shard.mutex.lock();
+            defer shard.mutex.unlock();
+            break :blk shard.lookup(session_id, std.time.timestamp(), out);
         };
+        self.stats.record(len != null);
+        return len;
     }
 
-    pub fn deinit(self: *SessionCache) void {
-        var iterator = self.sessions.iterator();
-        while (iterator.next()) |entry| {
-            entry.value_ptr.*.deinit(self.allocator);
-            self.allocator.destroy(entry.value_ptr.*);
-        }
-        self.sessions.deinit();
+    pub fn remove(self: *SessionCache, id: []const u8) void {
+        if (id.len == 0 or id.len > MAX_SESSION_ID) return;
+        const session_id = SessionId.init(id);
+        const shard = self.shardFor(session_id);
+        shard.mutex.lock();
+        defer shard.mutex.unlock();
+        if (shard.index.get(session_id)) |slot_index| shard.evict(&shard.slots[slot_index]);
     }
 
-    /// Store a session ticket
-    pub fn storeTicket(self: *SessionCache, ticket: *SessionTicket) !void {
-        // Check if we need to evict old entries
-        if (self.sessions.count() >= self.max_size) {
-            try self.evictExpired();
+    /// Get cache statistics
+    pub fn getStats(self: *SessionCache) struct {
+        total_sessions: usize,
+        max_sessions: usize,
+        hits: u64,
+        misses: u64,
+    } {
+        var total: usize = 0;
+        for (&self.shards) |*shard| {
+            shard.mutex.lock();
+            defer shard.mutex.unlock();
+            total += shard.index.count();
         }
+        return .{
+            .total_sessions = total,
+            .max_sessions = self.slots.len,
+            .hits = self.stats.hits.load(.monotonic),
+            .misses = self.stats.misses.load(.monotonic),
+        };
+    }
+};
 
-        // If still at limit, remove oldest entry
-        if (self.sessions.count() >= self.max_size) {
-            const oldest_key = self.findOldestEntry();
-            if (oldest_key) |key| {
-                if (self.sessions.fetchRemove(key)) |kv| {
-                    kv.value.deinit(self.allocator);
-                    self.allocator.destroy(kv.value);
-                    self.size -= 1;
-                }
-            }
-        }
+/// Key name (16), HMAC-SHA256 key (32), AES-256 key (32): the 80-byte layout
+/// nginx and haproxy use for ticket key files
+pub const TicketKey = struct {
+    name: [16]u8,
+    hmac_key: [32]u8,
+    aes_key: [32]u8,
 
-        // Store the ticket
-        const ticket_copy = try self.allocator.create(SessionTicket);
-        ticket_copy.* = ticket.*;
-        // Note: We take ownership of the ticket data
+    pub const SIZE: usize = 80;
 
-        try self.sessions.put(ticket.psk_identity, ticket_copy);
-        self.size += 1;
+    fn parse(bytes: *const [SIZE]u8) TicketKey {
+        return .{ .name = bytes[0..16].*, .hmac_key = bytes[16..48].*, .aes_key = bytes[48..80].* };
     }
 
-    /// Retrieve a session ticket by PSK identity
-    pub fn getTicket(self: *SessionCache, psk_identity: []const u8) ?*SessionTicket {
-        return self.sessions.get(psk_identity);
+    fn random() TicketKey {
+        var bytes: [SIZE]u8 = undefined;
+        std.crypto.random.bytes(&bytes);
+        return parse(&bytes);
     }
+};
 
-    /// Remove a session ticket
-    pub fn removeTicket(self: *SessionCache, psk_identity: []const u8) void {
-        if (self.sessions.fetchRemove(psk_identity)) |kv| {
-            kv.value.deinit(self.allocator);
-            self.allocator.destroy(kv.value);
-            self.size -= 1;
-        }
+/// Stateless ticket keys, shared by every handshake thread
+pub const TicketKeys = struct {
+    lock: std.Thread.RwLock = .{},
+    keys: [MAX_KEYS]TicketKey = undefined,
+    count: usize = 0,
+    // Random keys: a new one every rotation_s; ticket lifetime covers the keys kept
+    rotation_s: i64,
+    rotated_at: i64 = 0,
+    // Or keys from a file (the first one encrypts), re-read when its mtime changes
+    file: ?[]const u8 = null,
+    file_mtime: i128 = 0,
+    // Key maintenance runs at most once a second, from whichever handshake gets there first
+    next_check: std.atomic.Value(i64) = .init(0),
+    stats: ResumptionStats = .{},
+
+    pub const MAX_KEYS = 4;
+
+    pub const Decrypt = struct {
+        key: TicketKey,
+        /// Issued under an older key: the client should get a fresh ticket
+        renew: bool,
+    };
+
+    pub fn initRandom(rotation_s: u32) TicketKeys {
+        var keys = TicketKeys{ .rotation_s = @max(rotation_s, 1) };
+        keys.rotate(std.time.timestamp());
+        return keys;
     }
 
-    /// Clean up expired tickets
-    pub fn evictExpired(self: *SessionCache) !void {
-        var to_remove = std.ArrayList([]const u8).init(self.allocator);
-        defer to_remove.deinit();
-
-        var iterator = self.sessions.iterator();
-        while (iterator.next()) |entry| {
-            if (entry.value_ptr.isExpired()) {
-                try to_remove.append(entry.key_ptr.*);
-            }
-        }
+    pub fn initFile(path: []const u8, rotation_s: u32) !TicketKeys {
+        var keys = TicketKeys{ .rotation_s = @max(rotation_s, 1), .file = path };
+        try keys.loadFile();
+        return keys;
+    }
 
-        for (to_remove.items) |key| {
-            self.removeTicket(key);
-        }
+    /// How long a ticket stays decryptable
+    pub fn lifetime(self: *const TicketKeys) i64 {
+        return self.rotation_s * (MAX_KEYS - 1);
     }
 
-    /// Find the oldest entry (for LRU eviction)
-    fn findOldestEntry(self: *SessionCache) ?[]const u8 {
-        var oldest_key: ?[]const u8 = null;
-        var oldest_time: i64 = std.math.maxInt(i64);
+    /// Key for a new ticket
+    pub fn encryptKey(self: *TicketKeys) TicketKey {
+        self.maintain(std.time.timestamp());
+        self.lock.lockShared();
+        defer self.lock.unlockShared();
+        return self.keys[0];
+    }
 
-        var iterator = self.sessions.iterator();
-        while (iterator.next()) |entry| {
-            if (entry.value_ptr.created_at < oldest_time) {
-                oldest_time = entry.value_ptr.created_at;
-                oldest_key = entry.key_ptr.*;
+    /// Key that issued a ticket, or null if it has rotated out
+    pub fn decryptKey(self: *TicketKeys, name: *const [16]u8) ?Decrypt {
+        self.maintain(std.time.timestamp());
+        const found = blk: {
+            self.lock.lockShared();
+            defer self.lock.unlockShared();
+            for (self.keys[0..self.count], 0..) |key, i| {
+                if (std.mem.eql(u8, &key.name, name)) break :blk Decrypt{ .key = key, .renew = i != 0 };
             }
+            break :blk null;
+        };
+        self.stats.record(found != null);
+        return found;
+    }
+
+    fn maintain(self: *TicketKeys, now: i64) void {
+        if (now < self.next_check.load(.monotonic)) return;
+        // Whoever loses the race just uses the current keys
+        if (!self.lock.tryLock()) return;
+        defer self.lock.unlock();
+        self.next_check.store(now + 1, .monotonic);
+
+        if (self.file != null) {
+            self.loadFile() catch |err| std.log.warn("Keeping previous TLS ticket keys: {}", .{err});
+        } else if (now - self.rotated_at >= self.rotation_s) {
+            self.rotate(now);
         }
+    }
 
-        return oldest_key;
+    fn rotate(self: *TicketKeys, now: i64) void {
+        self.count = @min(self.count + 1, MAX_KEYS);
+        std.mem.copyBackwards(TicketKey, self.keys[1..self.count], self.keys[0 .. self.count - 1]);
+        self.keys[0] = TicketKey.random();
+        self.rotated_at = now;
     }
 
-    /// Get cache statistics
-    pub fn getStats(self: *const SessionCache) struct {
-        total_sessions: usize,
-        max_sessions: usize,
-    } {
-        return .{
-            .total_sessions = self.size,
-            .max_sessions = self.max_size,
-        };
+    fn loadFile(self: *TicketKeys) !void {
+        const path = self.file.?;
+        const stat = try std.fs.cwd().statFile(path);
+        if (stat.mtime == self.file_mtime and self.count > 0) return;
+
+        if (stat.size > MAX_KEYS * TicketKey.SIZE) return error.TooManyTicketKeys;
+        var buf: [MAX_KEYS * TicketKey.SIZE]u8 = undefined;
+        defer std.crypto.secureZero(u8, &buf);
+        const bytes = try std.fs.cwd().readFile(path, &buf);
+        if (bytes.len == 0 or bytes.len % TicketKey.SIZE != 0) return error.InvalidTicketKeyFile;
+
+        self.count = bytes.len / TicketKey.SIZE;
+        for (self.keys[0..self.count], 0..) |*key, i| {
+            key.* = TicketKey.parse(bytes[i * TicketKey.SIZE ..][0..TicketKey.SIZE]);
+        }
+        self.file_mtime = stat.mtime;
+        std.log.info("Loaded {} TLS ticket key(s) from {s}", .{ self.count, path });
     }
 };
 
@@ -382,3 +522,49 @@ pub const TokenCache = struct {
         };
     }
 };
+
+test "session cache evicts with CLOCK and counts hits" {
+    var cache = try SessionCache.init(std.testing.allocator, SHARD_COUNT);
+    defer cache.deinit();
+    const far = std.time.timestamp() + 3600;
+
+    // One slot per shard: find two IDs that land in the same shard
+    const first = "session-a";
+    var second_buf: [16]u8 = undefined;
+    var second: []const u8 = undefined;
+    var n: usize = 0;
+    while (true) : (n += 1) {
+        second = try std.fmt.bufPrint(&second_buf, "session-{d}", .{n});
+        if (cache.shardFor(SessionId.init(second)) == cache.shardFor(SessionId.init(first))) break;
+    }
+
+    var out: [MAX_SESSION_SIZE]u8 = undefined;
+    try std.testing.expect(cache.store(first, "state-a", far));
+    try std.testing.expectEqualStrings("state-a", out[0..cache.lookup(first, &out).?]);
+    try std.testing.expect(cache.store(second, "state-b", far));
+    try std.testing.expect(cache.lookup(first, &out) == null);
+    try std.testing.expectEqualStrings("state-b", out[0..cache.lookup(second, &out).?]);
+
+    const expired = std.time.timestamp() - 1;
+    try std.testing.expect(cache.store(first, "state-a", expired));
+    try std.testing.expect(cache.lookup(first, &out) == null);
+
+    const stats = cache.getStats();
+    try std.testing.expectEqual(@as(u64, 2), stats.hits);
+    try std.testing.expectEqual(@as(u64, 2), stats.misses);
+    try std.testing.expect(!cache.store(first, &([_]u8{0} ** (MAX_SESSION_SIZE + 1)), far));
+}
+
+test "ticket keys rotate and keep older keys for decryption" {
+    var keys = TicketKeys.initRandom(60);
+    const first = keys.encryptKey();
+    keys.rotate(std.time.timestamp());
+    const second = keys.encryptKey();
+    try std.testing.expect(!std.mem.eql(u8, &first.name, &second.name));
+
+    try std.testing.expect(!keys.decryptKey(&second.name).?.renew);
+    try std.testing.expect(keys.decryptKey(&first.name).?.renew);
+    for (0..TicketKeys.MAX_KEYS) |_| keys.rotate(std.time.timestamp());
+    try std.testing.expect(keys.decryptKey(&first.name) == null);
+    try std.testing.expectEqual(@as(u64, 1), keys.stats.misses.load(.monotonic));
+}
@@ -1,33 +1,341 @@
-// TLS 1.3 support - temporarily disabled for PicoTLS migration
-// All TLS operations now handled by PicoTLS directly
+//! TLS 1.3 over TCP for the io_uring workers
+//!
+//! OpenSSL runs the handshake over memory BIOs: the worker feeds it ciphertext
+//! from recv completions and writes out whatever it produces, so no socket I/O
+//! happens outside the ring. Once the handshake is done the application traffic
+//! keys can be handed to the kernel (kTLS). After that the socket carries
+//! plaintext as far as the worker is concerned: writes and splices are
+//! encrypted by the kernel and recvs return decrypted data. Whatever kTLS
+//! can't take (no tls module, unsupported cipher, registered-file sockets)
+//! stays on userspace records through SSL_read/SSL_write.
+//!
+//! QUIC keeps using picotls; this module is only the TCP listener's.
 
 const std = @import("std");
+const session = @import("session.zig");
 
-// Empty module to avoid import errors during transition
+const SslCtx = opaque {};
+const Ssl = opaque {};
+const Bio = opaque {};
+
+extern fn blitz_openssl_init() c_int;
+extern fn blitz_tls_server_ctx_new(cert_file: [*:0]const u8, key_file: [*:0]const u8) ?*SslCtx;
+extern fn blitz_tls_new(ctx: *SslCtx, rbio_out: **Bio, wbio_out: **Bio) ?*Ssl;
+extern fn blitz_tls_read_drained(ssl: *Ssl) c_int;
+extern fn blitz_tls_install_ktls(ssl: *Ssl, fd: c_int, tx: c_int) c_int;
+extern fn blitz_ssl_accept(ssl: *Ssl) c_int;
+extern fn blitz_ssl_get_error(ssl: *Ssl, ret: c_int) c_int;
+extern fn blitz_ssl_read(ssl: *Ssl, buf: ?*anyopaque, num: c_int) c_int;
+extern fn blitz_ssl_write(ssl: *Ssl, buf: ?*const anyopaque, num: c_int) c_int;
+extern fn blitz_bio_write(bio: *Bio, buf: ?*const anyopaque, len: c_int) c_int;
+extern fn blitz_bio_read(bio: *Bio, buf: ?*anyopaque, len: c_int) c_int;
+extern fn blitz_bio_ctrl_pending(bio: *Bio) c_int;
+extern fn blitz_ssl_free(ssl: *Ssl) void;
+extern fn blitz_ssl_ctx_free(ctx: *SslCtx) void;
+extern fn blitz_ssl_error_string() [*:0]const u8;
+extern fn blitz_tls_ctx_set_session_hooks(ctx: *SslCtx, hooks: *const SessionHooks, mode: c_int, timeout: c_long) c_int;
+extern fn blitz_tls_session_reused(ssl: *Ssl) c_int;
+
+// blitz_session_hooks in openssl_wrapper.c
+const SessionHooks = extern struct {
+    arg: *anyopaque,
+    store: *const fn (arg: *anyopaque, id: [*]const u8, id_len: c_uint, der: [*]const u8, der_len: c_uint, timeout: c_long) callconv(.c) c_int,
+    lookup: *const fn (arg: *anyopaque, id: [*]const u8, id_len: c_uint, der: [*]u8, der_cap: c_uint) callconv(.c) c_int,
+    remove: *const fn (arg: *anyopaque, id: [*]const u8, id_len: c_uint) callconv(.c) void,
+    ticket_key: *const fn (arg: *anyopaque, name: *[16]u8, aes_key: *[32]u8, hmac_key: *[32]u8, enc: c_int) callconv(.c) c_int,
+};
+
+// SSL_get_error() values
+const SSL_ERROR_WANT_READ: c_int = 2;
+const SSL_ERROR_WANT_WRITE: c_int = 3;
+const SSL_ERROR_ZERO_RETURN: c_int = 6;
+
+/// Bytes a TLS 1.3 record adds around its plaintext (header, content type, AEAD tag)
+pub const RECORD_OVERHEAD: usize = 5 + 1 + 16;
+
+pub const TlsError = error{
+    ContextInitFailed,
+    ConnectionInitFailed,
+    HandshakeFailed,
+    ProtocolError,
+    ConnectionClosed,
+};
+
+pub const TlsState = enum { handshake, established, closed };
+
+/// Who frames and encrypts records on a connection
+pub const RecordMode = enum {
+    /// SSL_read/SSL_write in the worker
+    userspace,
+    /// Kernel encrypts writes; reads are still decrypted in userspace
+    ktls_tx,
+    /// Kernel handles both directions
+    ktls,
+
+    pub fn label(self: RecordMode) []const u8 {
+        return switch (self) {
+            .userspace => "userspace",
+            .ktls_tx => "kTLS tx",
+            .ktls => "kTLS tx+rx",
+        };
+    }
+};
+
+/// How returning clients skip the full handshake
+pub const SessionTickets = enum(c_int) {
+    /// Session encrypted into the ticket under rotating keys; nothing stored server-side
+    stateless = 0,
+    /// Ticket carries a session ID into the shared SessionCache
+    stateful = 1,
+    /// Every handshake is a full one
+    off = 2,
+};
+
+pub const TlsOptions = struct {
+    cert_file: [:0]const u8,
+    key_file: [:0]const u8,
+    /// Try to move record encryption into the kernel after each handshake
+    ktls: bool = true,
+    /// Threads running handshake steps off the io_uring workers (0 = inline)
+    handshake_threads: u32 = 0,
+    session_tickets: SessionTickets = .stateless,
+    /// Sessions kept for stateful resumption
+    session_cache_size: usize = 16384,
+    /// Stateless ticket keys: 80-byte records, the first one encrypts. Re-read when
+    /// it changes. Without a file, random keys rotate every ticket_key_rotation_s.
+    ticket_key_file: ?[:0]const u8 = null,
+    ticket_key_rotation_s: u32 = 3600,
+};
+
+/// Session store and ticket keys behind a context, reached from OpenSSL through SessionHooks
+pub const Resumption = struct {
+    mode: SessionTickets,
+    cache: ?session.SessionCache = null,
+    keys: ?session.TicketKeys = null,
+    hooks: SessionHooks = undefined,
+
+    fn init(allocator: std.mem.Allocator, options: TlsOptions) !*Resumption {
+        const self = try allocator.create(Resumption);
+        errdefer allocator.destroy(self);
+        self.* = .{ .mode = options.session_tickets };
+        switch (options.session_tickets) {
+            .stateless => self.keys = if (options.ticket_key_file) |path|
+                try session.TicketKeys.initFile(path, options.ticket_key_rotation_s)
+            else
+                session.TicketKeys.initRandom(options.ticket_key_rotation_s),
+            .stateful => self.cache = try session.SessionCache.init(allocator, options.session_cache_size),
+            .off => {},
+        }
+        self.hooks = .{ .arg = self, .store = store, .lookup = lookup, .remove = remove, .ticket_key = ticketKey };
+        return self;
+    }
+
+    fn deinit(self: *Resumption, allocator: std.mem.Allocator) void {
+        if (self.cache) |*cache| cache.deinit();
+        allocator.destroy(self);
+    }
+
+    /// Session lifetime; with stateless tickets, as long as the keys that can decrypt them last
+    fn timeout(self: *const Resumption) c_long {
+        if (self.keys) |*keys| return @intCast(keys.lifetime());
+        return 2 * 3600;
+    }
+
+    pub fn stats(self: *const Resumption) *const session.ResumptionStats {
+        if (self.keys) |*keys| return &keys.stats;
+        if (self.cache) |*cache| return &cache.stats;
+        return &no_stats;
+    }
+
+    const no_stats = session.ResumptionStats{};
+
+    fn store(arg: *anyopaque, id: [*]const u8, id_len: c_uint, der: [*]const u8, der_len: c_uint, ttl: c_long) callconv(.c) c_int {
+        const self: *Resumption = @ptrCast(@alignCast(arg));
+        const cache = if (self.cache) |*cache| cache else return 0;
+        return @intFromBool(cache.store(id[0..id_len], der[0..der_len], std.time.timestamp() + ttl));
+    }
+
+    fn lookup(arg: *anyopaque, id: [*]const u8, id_len: c_uint, der: [*]u8, der_cap: c_uint) callconv(.c) c_int {
+        const self: *Resumption = @ptrCast(@alignCast(arg));
+        const cache = if (self.cache) |*cache| cache else return 0;
+        const len = cache.lookup(id[0..id_len], der[0..der_cap]) orelse return 0;
+        return @intCast(len);
+    }
+
+    fn remove(arg: *anyopaque, id: [*]const u8, id_len: c_uint) callconv(.c) void {
+        const self: *Resumption = @ptrCast(@alignCast(arg));
+        if (self.cache) |*cache| cache.remove(id[0..id_len]);
+    }
+
+    fn ticketKey(arg: *anyopaque, name: *[16]u8, aes_key: *[32]u8, hmac_key: *[32]u8, enc: c_int) callconv(.c) c_int {
+        const self: *Resumption = @ptrCast(@alignCast(arg));
+        const keys = if (self.keys) |*keys| keys else return 0;
+        if (enc != 0) {
+            const key = keys.encryptKey();
+            name.* = key.name;
+            aes_key.* = key.aes_key;
+            hmac_key.* = key.hmac_key;
+            return 1;
+        }
+        const found = keys.decryptKey(name) orelse return 0;
+        aes_key.* = found.key.aes_key;
+        hmac_key.* = found.key.hmac_key;
+        return if (found.renew) 2 else 1;
+    }
+};
+
+/// Shared by every worker; OpenSSL contexts are safe to use from several threads
 pub const TlsContext = struct {
-    pub fn init() !TlsContext {
-        return TlsContext{};
+    ctx: *SslCtx,
+    ktls: bool,
+    resumption: *Resumption,
+    allocator: std.mem.Allocator,
+
+    pub fn init(allocator: std.mem.Allocator, options: TlsOptions) TlsError!TlsContext {
+        if (blitz_openssl_init() != 1) return error.ContextInitFailed;
+        const resumption = Resumption.init(allocator, options) catch |err| {
+            std.log.err("TLS session resumption setup failed: {}", .{err});
+            return error.ContextInitFailed;
+        };
+        errdefer resumption.deinit(allocator);
+        const ctx = blitz_tls_server_ctx_new(options.cert_file, options.key_file) orelse {
+            std.log.err("TLS context setup failed for {s}: {s}", .{ options.cert_file, blitz_ssl_error_string() });
+            return error.ContextInitFailed;
+        };
+        errdefer blitz_ssl_ctx_free(ctx);
+        if (blitz_tls_ctx_set_session_hooks(ctx, &resumption.hooks, @intFromEnum(options.session_tickets), resumption.timeout()) != 1) {
+            std.log.err("TLS session resumption setup failed: {s}", .{blitz_ssl_error_string()});
+            return error.ContextInitFailed;
+        }
+        return .{ .ctx = ctx, .ktls = options.ktls, .resumption = resumption, .allocator = allocator };
     }
+
     pub fn deinit(self: *TlsContext) void {
-        _ = self;
+        blitz_ssl_ctx_free(self.ctx);
+        self.resumption.deinit(self.allocator);
+    }
+
+    pub fn newConnection(self: *const TlsContext) TlsError!TlsConnection {
+        var rbio: *Bio = undefined;
+        var wbio: *Bio = undefined;
+        const ssl = blitz_tls_new(self.ctx, &rbio, &wbio) orelse return error.ConnectionInitFailed;
+        return .{ .ssl = ssl, .rbio = rbio, .wbio = wbio, .ktls_wanted = self.ktls };
     }
 };
 
-// Stub extern functions to avoid compilation errors during transition
-extern fn blitz_openssl_init() c_int;
-extern fn blitz_ssl_ctx_new() ?*c_int;
-extern fn blitz_ssl_ctx_set_alpn(ctx: ?*c_int) void;
-extern fn blitz_ssl_ctx_use_certificate_file(ctx: ?*c_int, cert_file: [*c]const u8) c_int;
-extern fn blitz_ssl_ctx_use_privatekey_file(ctx: ?*c_int, key_file: [*c]const u8) c_int;
-extern fn blitz_ssl_new(ctx: ?*c_int) ?*c_int;
-extern fn blitz_ssl_set_fd(ssl: ?*c_int, fd: c_int) c_int;
-extern fn blitz_ssl_accept(ssl: ?*c_int) c_int;
-extern fn blitz_ssl_get_error(ssl: ?*c_int, ret: c_int) c_int;
-extern fn blitz_ssl_want_read(err: c_int) c_int;
-extern fn blitz_ssl_want_write(err: c_int) c_int;
-extern fn blitz_ssl_read(ssl: ?*c_int, buf: ?*anyopaque, num: c_int) c_int;
-extern fn blitz_ssl_write(ssl: ?*c_int, buf: ?*const anyopaque, num: c_int) c_int;
-extern fn blitz_ssl_pending(ssl: ?*c_int) c_int;
-extern fn blitz_ssl_shutdown(ssl: ?*c_int) c_int;
-extern fn blitz_ssl_free(ssl: ?*c_int) void;
-extern fn blitz_ssl_ctx_free(ctx: ?*c_int) void;
+pub const TlsConnection = struct {
+    ssl: *Ssl,
+    // Owned by ssl
+    rbio: *Bio,
+    wbio: *Bio,
+    state: TlsState = .handshake,
+    mode: RecordMode = .userspace,
+    ktls_wanted: bool,
+    // kTLS RX waits until the worker has stopped its recv and drained what was already received
+    rx_install_pending: bool = false,
+
+    pub fn deinit(self: *TlsConnection) void {
+        // No close_notify: with kTLS TX the record sequence now lives in the kernel
+        blitz_ssl_free(self.ssl);
+        self.state = .closed;
+    }
+
+    /// Hand ciphertext received from the peer to OpenSSL
+    pub fn feed(self: *TlsConnection, ciphertext: []const u8) TlsError!void {
+        if (ciphertext.len == 0) return;
+        const written = blitz_bio_write(self.rbio, ciphertext.ptr, @intCast(ciphertext.len));
+        if (written != @as(c_int, @intCast(ciphertext.len))) return error.ProtocolError;
+    }
+
+    /// Advance the handshake with what has been fed so far
+    pub fn handshake(self: *TlsConnection) TlsError!TlsState {
+        if (self.state != .handshake) return self.state;
+        const ret = blitz_ssl_accept(self.ssl);
+        if (ret == 1) {
+            self.state = .established;
+            return self.state;
+        }
+        return switch (blitz_ssl_get_error(self.ssl, ret)) {
+            SSL_ERROR_WANT_READ, SSL_ERROR_WANT_WRITE => .handshake,
+            else => error.HandshakeFailed,
+        };
+    }
+
+    /// Decrypt buffered records into buf; 0 means more ciphertext is needed
+    pub fn read(self: *TlsConnection, buf: []u8) TlsError!usize {
+        const ret = blitz_ssl_read(self.ssl, buf.ptr, @intCast(@min(buf.len, std.math.maxInt(c_int))));
+        if (ret > 0) return @intCast(ret);
+        return switch (blitz_ssl_get_error(self.ssl, ret)) {
+            SSL_ERROR_WANT_READ, SSL_ERROR_WANT_WRITE => 0,
+            SSL_ERROR_ZERO_RETURN => error.ConnectionClosed,
+            else => error.ProtocolError,
+        };
+    }
+
+    /// Encrypt plaintext into records; collect them with takeOutput()
+    pub fn write(self: *TlsConnection, plaintext: []const u8) TlsError!void {
+        if (plaintext.len == 0) return;
+        const ret = blitz_ssl_write(self.ssl, plaintext.ptr, @intCast(plaintext.len));
+        if (ret != @as(c_int, @intCast(plaintext.len))) return error.ProtocolError;
+    }
+
+    pub fn pendingOutput(self: *TlsConnection) usize {
+        return @intCast(@max(blitz_bio_ctrl_pending(self.wbio), 0));
+    }
+
+    /// Move records waiting to be sent into buf
+    pub fn takeOutput(self: *TlsConnection, buf: []u8) usize {
+        const ret = blitz_bio_read(self.wbio, buf.ptr, @intCast(@min(buf.len, std.math.maxInt(c_int))));
+        return if (ret > 0) @intCast(ret) else 0;
+    }
+
+    /// Install the transmit key into fd. Only valid once every record OpenSSL
+    /// produced has been written to the socket: anything sent later is
+    /// encrypted by the kernel.
+    pub fn installTx(self: *TlsConnection, fd: c_int) TlsError!bool {
+        if (self.mode != .userspace or self.pendingOutput() > 0) return false;
+        switch (blitz_tls_install_ktls(self.ssl, fd, 1)) {
+            1 => {
+                self.mode = .ktls_tx;
+                return true;
+            },
+            0 => return false,
+            else => return error.ProtocolError,
+        }
+    }
+
+    /// Whether the receive key could move to the kernel right now: no ciphertext
+    /// may be buffered on the userspace side, or the kernel's sequence would be off
+    pub fn rxDrained(self: *TlsConnection) bool {
+        return blitz_tls_read_drained(self.ssl) != 0;
+    }
+
+    /// Install the receive key into fd; the caller must have stopped reading the socket
+    pub fn installRx(self: *TlsConnection, fd: c_int) TlsError!bool {
+        self.rx_install_pending = false;
+        if (self.mode != .ktls_tx or !self.rxDrained()) return false;
+        switch (blitz_tls_install_ktls(self.ssl, fd, 0)) {
+            1 => {
+                self.mode = .ktls;
+                return true;
+            },
+            0 => return false,
+            else => return error.ProtocolError,
+        }
+    }
+
+    /// The handshake resumed an earlier session instead of signing
+    pub fn resumed(self: *TlsConnection) bool {
+        return blitz_tls_session_reused(self.ssl) != 0;
+    }
+
+    /// Plaintext written straight to the socket gets encrypted by the kernel
+    pub fn kernelTx(self: *const TlsConnection) bool {
+        return self.mode != .userspace;
+    }
+
+    /// recv returns plaintext
+    pub fn kernelRx(self: *const TlsConnection) bool {
+        return self.mode == .ktls;
+    }
+};